@@ -0,0 +1,298 @@
+/*
+ *  aot.c
+ *  Contains ahead-of-time translation of APEX programs to C, every instruction
+ *  becomes straight-line code and branches become gotos on pc labels.
+ *  Generated file is compiled against libapex for a program specialized
+ *  simulator with the same results as functional execution.
+ *
+ *  Author :
+ *  Sagar Vishwakarma (svishwa2@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpu.h"
+
+/*
+ * Helpers at top of every generated file, same semantics as APEX_cpu_execute_functional.
+ * Called with constant register numbers so the compiler folds them into each instruction,
+ * is_valid_mem and is_valid_branch come from cpu.h like everywhere else.
+ */
+static const char* aot_prologue =
+  "#include <stdio.h>\n"
+  "#include <stdlib.h>\n"
+  "#include <limits.h>\n"
+  "#include <time.h>\n"
+  "\n"
+  "#include \"cpu.h\"\n"
+  "\n"
+  "static inline void apex_store(int* data_memory, int mem_address, int value) {\n"
+  "  if (is_valid_mem(mem_address)) {\n"
+  "    data_memory[mem_address] = value;\n"
+  "  }\n"
+  "  else {\n"
+  "    fprintf(stderr, \"Segmentation fault for writing memory location :: %d\\n\", mem_address);\n"
+  "  }\n"
+  "}\n"
+  "\n"
+  "static inline int apex_load(const int* data_memory, int mem_address) {\n"
+  "  if (is_valid_mem(mem_address)) {\n"
+  "    return data_memory[mem_address];\n"
+  "  }\n"
+  "  fprintf(stderr, \"Segmentation fault for accessing memory location :: %d\\n\", mem_address);\n"
+  "  return 0;\n"
+  "}\n"
+  "\n"
+  "static inline int apex_add(int* flags, int rs1_value, int rs2_value) {\n"
+  "  int result = 0;\n"
+  "  if ((rs2_value > 0 && rs1_value > INT_MAX - rs2_value) ||\n"
+  "    (rs2_value < 0 && rs1_value < INT_MIN - rs2_value)) {\n"
+  "    flags[OF] = 1;\n"
+  "  }\n"
+  "  else {\n"
+  "    flags[OF] = 0;\n"
+  "    result = rs1_value + rs2_value;\n"
+  "  }\n"
+  "  flags[ZF] = (result == 0);\n"
+  "  return result;\n"
+  "}\n"
+  "\n"
+  "static inline int apex_sub(int* flags, int rs1_value, int rs2_value) {\n"
+  "  flags[CF] = (rs2_value > rs1_value);\n"
+  "  int result = rs1_value - rs2_value;\n"
+  "  flags[ZF] = (result == 0);\n"
+  "  return result;\n"
+  "}\n"
+  "\n"
+  "static inline int apex_mul(int* flags, int rs1_value, int rs2_value) {\n"
+  "  int result = rs1_value * rs2_value;\n"
+  "  flags[ZF] = (result == 0);\n"
+  "  return result;\n"
+  "}\n"
+  "\n"
+  "static inline int apex_div(int* flags, int rs1_value, int rs2_value) {\n"
+  "  if (rs2_value != 0) {\n"
+  "    flags[ZF] = (rs1_value % rs2_value != 0);\n"
+  "    return rs1_value / rs2_value;\n"
+  "  }\n"
+  "  fprintf(stderr, \"Division By Zero Returning Value Zero\\n\");\n"
+  "  flags[ZF] = 0;\n"
+  "  return 0;\n"
+  "}\n"
+  "\n"
+  "static inline void apex_bad_branch(const char* name, int address) {\n"
+  "  fprintf(stderr, \"Invalid Branch Loction for %s\\n\", name);\n"
+  "  fprintf(stderr, \"Instruction %s Relative Address %d\\n\", name, address);\n"
+  "}\n"
+  "\n";
+
+/* main of every generated file, runs the program and prints the same report as func functional */
+static const char* aot_epilogue =
+  "int main(int argc, char const* argv[])\n"
+  "{\n"
+  "  APEX_CPU* cpu = calloc(1, sizeof(APEX_CPU));\n"
+  "  if (!cpu) {\n"
+  "    fprintf(stderr, \"APEX_Error : Unable to initialize CPU\\n\");\n"
+  "    exit(1);\n"
+  "  }\n"
+  "  cpu->out = stdout;\n"
+  "  cpu->pc = 4000;\n"
+  "  struct timespec start, stop;\n"
+  "  long long executed = 0;\n"
+  "  clock_gettime(CLOCK_MONOTONIC, &start);\n"
+  "  int ret = APEX_program_run(cpu, &executed);\n"
+  "  clock_gettime(CLOCK_MONOTONIC, &stop);\n"
+  "  double seconds = (stop.tv_sec - start.tv_sec) + (stop.tv_nsec - start.tv_nsec) / 1e9;\n"
+  "  if (ret == HALT) {\n"
+  "    fprintf(stderr, \"Simulation Stoped ....\\n\");\n"
+  "    printf(\"Instruction HALT Encountered\\n\");\n"
+  "  }\n"
+  "  else if (ret == EMPTY) {\n"
+  "    fprintf(stderr, \"Simulation Stoped ....\\n\");\n"
+  "    printf(\"No More Instructions Encountered\\n\");\n"
+  "  }\n"
+  "  printf(\"Executed %lld instructions in %.3f ms (%.2f MIPS)\\n\",\n"
+  "         executed, seconds * 1e3, (seconds > 0) ? executed / seconds / 1e6 : 0.0);\n"
+  "  printf(\"Simulation Return Code %d\\n\", ret);\n"
+  "  print_cpu_content(cpu);\n"
+  "  free(cpu);\n"
+  "  return 0;\n"
+  "}\n";
+
+static void write_stop(FILE* fp, int index, const char* ret) {
+  // leave the program with pc at index
+  fprintf(fp, "  index = %d; ret = %s; goto done;\n", index, ret);
+}
+
+static void write_goto(FILE* fp, int target, int code_memory_size) {
+  if ((target >= 0) && (target < code_memory_size)) {
+    fprintf(fp, "goto L_%d;", target);
+  }
+  else {
+    fprintf(fp, "{ index = %d; ret = EMPTY; goto done; }", target);
+  }
+}
+
+static void write_instruction(FILE* fp, const APEX_Instruction* ins, int index, int code_memory_size) {
+  int pc = 4000 + 4 * index;
+  const char* name = get_opcode_name(ins->opcode);
+  if (!has_valid_regs(ins)) {
+    // stops before counting, same as functional execution
+    fprintf(fp, "  fprintf(stderr, \"Segmentation fault for Register location in %s at pc(%d)\\n\");\n", name, pc);
+    write_stop(fp, index, "ERROR");
+    return;
+  }
+  fprintf(fp, "  count++;\n");
+  switch (ins->opcode) {
+    case OP_STORE:
+      fprintf(fp, "  apex_store(data_memory, regs[%d] + %d, regs[%d]);\n", ins->rs1, ins->imm, ins->rd);
+      break;
+    case OP_STR:
+      fprintf(fp, "  apex_store(data_memory, regs[%d] + regs[%d], regs[%d]);\n", ins->rs1, ins->rs2, ins->rd);
+      break;
+    case OP_LOAD:
+      fprintf(fp, "  regs[%d] = apex_load(data_memory, regs[%d] + %d);\n", ins->rd, ins->rs1, ins->imm);
+      break;
+    case OP_LDR:
+      fprintf(fp, "  regs[%d] = apex_load(data_memory, regs[%d] + regs[%d]);\n", ins->rd, ins->rs1, ins->rs2);
+      break;
+    case OP_MOVC:
+      fprintf(fp, "  regs[%d] = %d;\n", ins->rd, ins->imm);
+      break;
+    case OP_MOV:
+      fprintf(fp, "  regs[%d] = regs[%d];\n", ins->rd, ins->rs1);
+      break;
+    case OP_ADD:
+      fprintf(fp, "  regs[%d] = apex_add(flags, regs[%d], regs[%d]);\n", ins->rd, ins->rs1, ins->rs2);
+      break;
+    case OP_ADDL:
+      fprintf(fp, "  regs[%d] = apex_add(flags, regs[%d], %d);\n", ins->rd, ins->rs1, ins->imm);
+      break;
+    case OP_SUB:
+      fprintf(fp, "  regs[%d] = apex_sub(flags, regs[%d], regs[%d]);\n", ins->rd, ins->rs1, ins->rs2);
+      break;
+    case OP_SUBL:
+      fprintf(fp, "  regs[%d] = apex_sub(flags, regs[%d], %d);\n", ins->rd, ins->rs1, ins->imm);
+      break;
+    case OP_MUL:
+      fprintf(fp, "  regs[%d] = apex_mul(flags, regs[%d], regs[%d]);\n", ins->rd, ins->rs1, ins->rs2);
+      break;
+    case OP_DIV:
+      fprintf(fp, "  regs[%d] = apex_div(flags, regs[%d], regs[%d]);\n", ins->rd, ins->rs1, ins->rs2);
+      break;
+    case OP_AND:
+      fprintf(fp, "  regs[%d] = regs[%d] & regs[%d];\n", ins->rd, ins->rs1, ins->rs2);
+      break;
+    case OP_OR:
+      fprintf(fp, "  regs[%d] = regs[%d] | regs[%d];\n", ins->rd, ins->rs1, ins->rs2);
+      break;
+    case OP_EXOR:
+      fprintf(fp, "  regs[%d] = regs[%d] ^ regs[%d];\n", ins->rd, ins->rs1, ins->rs2);
+      break;
+    case OP_BZ:
+    case OP_BNZ:
+      fprintf(fp, "  if (flags[ZF] == %d) ", ins->opcode == OP_BZ);
+      if (is_valid_branch(pc, ins->imm)) {
+        write_goto(fp, get_code_index(pc + ins->imm), code_memory_size);
+        fprintf(fp, "\n");
+      }
+      else {
+        fprintf(fp, "apex_bad_branch(\"%s\", %d);\n", name, pc + ins->imm);
+      }
+      break;
+    case OP_JUMP:
+      // target is only known at run time, dispatch switches on its code index
+      fprintf(fp, "  mem_address = regs[%d] + %d;\n", ins->rs1, ins->imm);
+      fprintf(fp, "  if (is_valid_branch(%d, mem_address)) { index = get_code_index(mem_address); goto dispatch; }\n", pc);
+      fprintf(fp, "  apex_bad_branch(\"%s\", %d + mem_address);\n", name, pc);
+      break;
+    case OP_HALT:
+      fprintf(fp, "  flags[IF] = 1;\n");
+      write_stop(fp, index + 1, "HALT");
+      break;
+    case OP_EMPTY:
+      write_stop(fp, index + 1, "EMPTY");
+      break;
+    default:
+      ; // NOP
+  }
+}
+
+int write_program_c(const char* filename, const char* source_name,
+                    const APEX_Instruction* code_memory, int code_memory_size) {
+  // Writes APEX_program_run() specialized for code memory and a main printing the final state
+  if (!filename || !code_memory || (code_memory_size <= 0)) {
+    return ERROR;
+  }
+  FILE* fp = fopen(filename, "w");
+  if (!fp) {
+    return ERROR;
+  }
+
+  // labels only where something jumps to, unused labels are warnings
+  int has_jump = 0;
+  char* needs_label = calloc(code_memory_size, 1);
+  if (!needs_label) {
+    fclose(fp);
+    return ERROR;
+  }
+  for (int i = 0; i < code_memory_size; ++i) {
+    const APEX_Instruction* ins = &code_memory[i];
+    int pc = 4000 + 4 * i;
+    if (((ins->opcode == OP_BZ) || (ins->opcode == OP_BNZ)) && has_valid_regs(ins) && is_valid_branch(pc, ins->imm)) {
+      int target = get_code_index(pc + ins->imm);
+      if ((target >= 0) && (target < code_memory_size)) {
+        needs_label[target] = 1;
+      }
+    }
+    if ((ins->opcode == OP_JUMP) && has_valid_regs(ins)) {
+      has_jump = 1;
+    }
+  }
+
+  fprintf(fp, "/*\n *  Generated from %s by apex_sim translate, do not edit\n */\n", source_name ? source_name : "-");
+  fprintf(fp, "%s", aot_prologue);
+  fprintf(fp, "int APEX_program_run(APEX_CPU* cpu, long long* executed) {\n");
+  fprintf(fp, "  int* regs = cpu->regs;\n");
+  fprintf(fp, "  int* flags = cpu->flags;\n");
+  fprintf(fp, "  int* data_memory = cpu->data_memory;\n");
+  fprintf(fp, "  long long count = 0;\n");
+  fprintf(fp, "  int index = 0;\n");
+  fprintf(fp, "  int ret = SUCCESS;\n");
+  if (has_jump) {
+    fprintf(fp, "  int mem_address = 0;\n");
+  }
+  fprintf(fp, "  (void)regs; (void)flags; (void)data_memory;\n\n");
+
+  for (int i = 0; i < code_memory_size; ++i) {
+    const APEX_Instruction* ins = &code_memory[i];
+    if (needs_label[i] || has_jump) {
+      fprintf(fp, "L_%d:\n", i);
+    }
+    fprintf(fp, "  // pc(%d) %s,%d,%d,%d,#%d\n", 4000 + 4 * i, get_opcode_name(ins->opcode),
+            ins->rd, ins->rs1, ins->rs2, ins->imm);
+    write_instruction(fp, ins, i, code_memory_size);
+  }
+  // running past the last instruction
+  write_stop(fp, code_memory_size, "EMPTY");
+
+  if (has_jump) {
+    fprintf(fp, "\ndispatch:\n  switch (index) {\n");
+    for (int i = 0; i < code_memory_size; ++i) {
+      fprintf(fp, "    case %d: goto L_%d;\n", i, i);
+    }
+    fprintf(fp, "    default: ret = EMPTY; goto done;\n  }\n");
+  }
+  fprintf(fp, "\ndone:\n");
+  fprintf(fp, "  cpu->pc = 4000 + 4 * index;\n");
+  fprintf(fp, "  cpu->counters.ins_completed += count;\n");
+  fprintf(fp, "  cpu->counters.ins_retired += count;\n");
+  fprintf(fp, "  *executed = count;\n");
+  fprintf(fp, "  return ret;\n}\n\n");
+  fprintf(fp, "%s", aot_epilogue);
+  free(needs_label);
+
+  return (fclose(fp) == 0) ? SUCCESS : ERROR;
+}
@@ -0,0 +1,28 @@
+/*
+ *  apex_trace.c
+ *  Decoder of binary pipeline traces written with -trace, prints the per
+ *  cycle stage view of func simulate without running the program again
+ *
+ *  Author :
+ *  Sagar Vishwakarma (svishwa2@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpu.h"
+
+int main(int argc, char const* argv[])
+{
+  // -events also prints register writes, Decode/RF stalls and flushes in the cycle they happen
+  int show_events = (argc == 3) && (strcmp(argv[2], "-events") == 0);
+  if ((argc < 2) || (argc > 3) || ((argc == 3) && !show_events)) {
+    fprintf(stderr, "APEX_Help : Usage %s <trace_file> [-events]\n", argv[0]);
+    exit(1);
+  }
+  if (APEX_trace_decode(argv[1], stdout, show_events) != SUCCESS) {
+    exit(1);
+  }
+  return 0;
+}
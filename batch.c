@@ -0,0 +1,293 @@
+/*
+ *  batch.c
+ *  Contains batch runs of many APEX programs in one process, every program
+ *  gets its own APEX_CPU and runs on a work stealing pool of host threads,
+ *  output of each program is captured and all results go to one file
+ *
+ *  Author :
+ *  Sagar Vishwakarma (svishwa2@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "cpu.h"
+
+#define MAX_BATCH_THREADS 256
+#define MAX_MANIFEST_LINE 4096
+
+/* One line of the manifest, input_file func num_cycle, and its results */
+typedef struct Batch_Job {
+  char* program;
+  char func[16];
+  int num_cycle;
+  int ret;
+  int cycles;
+  int instructions;
+  double seconds;
+  char* output;        // captured output of the program
+  size_t output_size;
+} Batch_Job;
+
+/* Jobs of one worker, owner takes from head, other workers steal from tail */
+typedef struct Batch_Queue {
+  pthread_mutex_t lock;
+  int head;
+  int tail;
+} Batch_Queue;
+
+typedef struct Batch_Pool {
+  void (*run_job)(void* arg, int job);
+  void* arg;
+  Batch_Queue* queues;
+  int num_workers;
+} Batch_Pool;
+
+typedef struct Batch_Worker {
+  Batch_Pool* pool;
+  int id;
+} Batch_Worker;
+
+static int is_batch_func(const char* func) {
+  return (strcmp(func, "run") == 0) || (strcmp(func, "simulate") == 0) || (strcmp(func, "display") == 0) ||
+         (strcmp(func, "functional") == 0) || (strcmp(func, "jit") == 0);
+}
+
+static const char* get_return_name(int ret) {
+  switch (ret) {
+    case SUCCESS:
+      return "CYCLES";  // stopped at requested cycles or instructions
+    case HALT:
+      return "HALT";
+    case EMPTY:
+      return "EMPTY";
+    default:
+      return "ERROR";
+  }
+}
+
+static int read_manifest(const char* filename, Batch_Job** jobs) {
+  // Returns number of jobs, or -1 if manifest can not be read or has an invalid line
+  FILE* fp = fopen(filename, "r");
+  if (!fp) {
+    return -1;
+  }
+  int size = 0;
+  int capacity = 0;
+  int line_number = 0;
+  int failed = 0;
+  char line[MAX_MANIFEST_LINE];
+  char program[MAX_MANIFEST_LINE];
+  char func[16];
+  *jobs = NULL;
+  while (fgets(line, sizeof(line), fp)) {
+    line_number++;
+    char* p = line + strspn(line, " \t\r\n");
+    if ((*p == '\0') || (*p == '#')) {
+      continue;  // blank lines and comments
+    }
+    int num_cycle = 0;
+    if ((sscanf(p, "%4095s %15s %d", program, func, &num_cycle) != 3) || !is_batch_func(func)) {
+      fprintf(stderr, "APEX_Error : %s line %d, expected <input_file> <func(eg: run Or simulate Or display Or functional Or jit)> <num_cycle>\n",
+              filename, line_number);
+      failed = 1;
+      break;
+    }
+    if (size == capacity) {
+      capacity = capacity ? capacity * 2 : 256;
+      Batch_Job* grown = realloc(*jobs, sizeof(*grown) * capacity);
+      if (!grown) {
+        failed = 1;
+        break;
+      }
+      *jobs = grown;
+    }
+    Batch_Job* job = &(*jobs)[size];
+    memset(job, 0, sizeof(*job));
+    job->program = strdup(program);
+    strcpy(job->func, func);
+    job->num_cycle = num_cycle;
+    size++;
+  }
+  fclose(fp);
+  if (failed) {
+    for (int i = 0; i < size; ++i) {
+      free((*jobs)[i].program);
+    }
+    free(*jobs);
+    *jobs = NULL;
+    return -1;
+  }
+  return size;
+}
+
+static void run_job(void* arg, int index) {
+  // Same runs as apex_sim funcs, printing into a buffer in place of stdout
+  Batch_Job* job = &((Batch_Job*)arg)[index];
+  struct timespec start, stop;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  job->ret = ERROR;
+  FILE* out = open_memstream(&job->output, &job->output_size);
+  if (!out) {
+    return;
+  }
+  APEX_CPU* cpu = job->program ? APEX_cpu_create(job->program, out) : NULL;
+  if (!cpu) {
+    fprintf(out, "APEX_Error : Unable to initialize CPU\n");
+  }
+  else {
+    if (strcmp(job->func, "functional") == 0) {
+      job->ret = APEX_cpu_run_functional(cpu, job->num_cycle);
+    }
+    else if (strcmp(job->func, "jit") == 0) {
+      job->ret = APEX_cpu_run_jit(cpu, job->num_cycle);
+    }
+    else {
+      cpu->quiet = (strcmp(job->func, "run") == 0);
+      job->ret = APEX_cpu_run(cpu, job->num_cycle);
+    }
+    if (strcmp(job->func, "simulate") != 0) {
+      print_cpu_content(cpu);
+    }
+    job->cycles = cpu->clock;
+    job->instructions = cpu->counters.ins_retired; // bubbles not counted, same as the counters of the run
+    APEX_cpu_stop(cpu);
+  }
+  fclose(out);
+  clock_gettime(CLOCK_MONOTONIC, &stop);
+  job->seconds = (stop.tv_sec - start.tv_sec) + (stop.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+static int get_num_threads(int num_threads, int num_jobs) {
+  if (num_threads <= 0) {
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    num_threads = (cores > 0) ? (int)cores : 1;
+  }
+  if (num_threads > MAX_BATCH_THREADS) {
+    num_threads = MAX_BATCH_THREADS;
+  }
+  if (num_threads > num_jobs) {
+    num_threads = (num_jobs > 0) ? num_jobs : 1;
+  }
+  return num_threads;
+}
+
+static int pop_job(Batch_Queue* queue, int steal) {
+  int job = -1;
+  pthread_mutex_lock(&queue->lock);
+  if (queue->head < queue->tail) {
+    job = steal ? --queue->tail : queue->head++;
+  }
+  pthread_mutex_unlock(&queue->lock);
+  return job;
+}
+
+static int take_job(Batch_Pool* pool, int id) {
+  // Own jobs first, then steal from the next workers, -1 once every queue is empty
+  int job = pop_job(&pool->queues[id], 0);
+  for (int i = 1; (job < 0) && (i < pool->num_workers); ++i) {
+    job = pop_job(&pool->queues[(id + i) % pool->num_workers], 1);
+  }
+  return job;
+}
+
+static void* batch_worker(void* arg) {
+  Batch_Worker* worker = arg;
+  int job;
+  while ((job = take_job(worker->pool, worker->id)) >= 0) {
+    worker->pool->run_job(worker->pool->arg, job);
+  }
+  return NULL;
+}
+
+void APEX_run_parallel(int num_jobs, int num_threads, void (*run_job)(void* arg, int job), void* arg) {
+  // Calls run_job(arg, job) for every job on num_threads host threads, 0 uses one thread per core.
+  // Worker 0 is the calling thread, jobs are dealt out in contiguous ranges
+  Batch_Queue queues[MAX_BATCH_THREADS];
+  Batch_Worker workers[MAX_BATCH_THREADS];
+  pthread_t threads[MAX_BATCH_THREADS];
+  int num_workers = get_num_threads(num_threads, num_jobs);
+  Batch_Pool pool = {run_job, arg, queues, num_workers};
+  for (int i = 0; i < num_workers; ++i) {
+    pthread_mutex_init(&queues[i].lock, NULL);
+    queues[i].head = (int)((long long)num_jobs * i / num_workers);
+    queues[i].tail = (int)((long long)num_jobs * (i + 1) / num_workers);
+    workers[i].pool = &pool;
+    workers[i].id = i;
+  }
+  int started = 1;
+  for (int i = 1; i < num_workers; ++i) {
+    if (pthread_create(&threads[i], NULL, batch_worker, &workers[i]) != 0) {
+      break;  // remaining queues are stolen by running workers
+    }
+    started++;
+  }
+  batch_worker(&workers[0]);
+  for (int i = 1; i < started; ++i) {
+    pthread_join(threads[i], NULL);
+  }
+  for (int i = 0; i < num_workers; ++i) {
+    pthread_mutex_destroy(&queues[i].lock);
+  }
+}
+
+static int write_results(const char* filename, const Batch_Job* jobs, int num_jobs) {
+  // Summary table of all jobs in manifest order, followed by output of each job
+  FILE* fp = fopen(filename, "w");
+  if (!fp) {
+    return ERROR;
+  }
+  fprintf(fp, "program, func, num_cycle, return, cycles, instructions, ms\n");
+  for (int i = 0; i < num_jobs; ++i) {
+    fprintf(fp, "%s, %s, %d, %s, %d, %d, %.3f\n", jobs[i].program, jobs[i].func, jobs[i].num_cycle,
+            get_return_name(jobs[i].ret), jobs[i].cycles, jobs[i].instructions, jobs[i].seconds * 1e3);
+  }
+  for (int i = 0; i < num_jobs; ++i) {
+    fprintf(fp, "\n============ OUTPUT OF %s %s %d ============\n", jobs[i].program, jobs[i].func, jobs[i].num_cycle);
+    if (jobs[i].output) {
+      fwrite(jobs[i].output, 1, jobs[i].output_size, fp);
+    }
+  }
+  return (fclose(fp) == 0) ? SUCCESS : ERROR;
+}
+
+int APEX_cpu_run_batch(const char* manifest, const char* results_file, int num_threads) {
+  // Runs every program of the manifest, num_threads 0 uses one thread per core
+  Batch_Job* jobs = NULL;
+  int num_jobs = read_manifest(manifest, &jobs);
+  if (num_jobs < 0) {
+    fprintf(stderr, "APEX_Error : Unable to read manifest %s\n", manifest);
+    return ERROR;
+  }
+  num_threads = get_num_threads(num_threads, num_jobs);
+
+  struct timespec start, stop;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  APEX_run_parallel(num_jobs, num_threads, run_job, jobs);
+  clock_gettime(CLOCK_MONOTONIC, &stop);
+  double seconds = (stop.tv_sec - start.tv_sec) + (stop.tv_nsec - start.tv_nsec) / 1e9;
+
+  int count[NUM_EXIT] = {0};
+  for (int i = 0; i < num_jobs; ++i) {
+    count[(jobs[i].ret >= 0) && (jobs[i].ret < NUM_EXIT) ? jobs[i].ret : ERROR]++;
+  }
+  int ret = write_results(results_file, jobs, num_jobs);
+  printf("Batch :: %d programs on %d threads in %.3f s, %d HALT, %d EMPTY, %d stopped at num_cycle, %d ERROR\n",
+         num_jobs, num_threads, seconds, count[HALT], count[EMPTY], count[SUCCESS], count[ERROR]);
+  if (ret == SUCCESS) {
+    printf("Results written to %s\n", results_file);
+  }
+  else {
+    fprintf(stderr, "APEX_Error : Unable to write results %s\n", results_file);
+  }
+  for (int i = 0; i < num_jobs; ++i) {
+    free(jobs[i].program);
+    free(jobs[i].output);
+  }
+  free(jobs);
+  return ret;
+}
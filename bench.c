@@ -0,0 +1,197 @@
+/*
+ *  bench.c
+ *  Contains the simulator throughput harness, every workload runs under
+ *  each execution mode (in-order pipeline, out-of-order engine, sampled,
+ *  functional and jit) one after another on the calling thread, host time
+ *  of the fastest of a few runs, simulated KIPS/MIPS, cycles and CPI go to
+ *  a CSV file so simulator speed can be compared across releases. Final
+ *  registers, flags and data memory of every mode are checked against the
+ *  functional run so a fast mode giving wrong answers shows up
+ *
+ *  Author :
+ *  Sagar Vishwakarma (svishwa2@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+#include <time.h>
+
+#include "cpu.h"
+
+/* Execution modes every workload runs under */
+enum {
+  BENCH_PIPELINE,     // in-order 7 stage pipeline, same as func run
+  BENCH_OOO,          // out-of-order engine, same as func run with engine=1
+  BENCH_SAMPLED,      // functional fast-forward with pipeline windows, same as func sample
+  BENCH_FUNCTIONAL,
+  BENCH_JIT,
+  NUM_BENCH_MODES
+};
+
+static const char* mode_names[NUM_BENCH_MODES] = {"pipeline", "ooo", "sampled", "functional", "jit"};
+
+/* Schedule of sampled mode, a window every 20000 instructions */
+static const APEX_Sample_Schedule bench_schedule = {18000, 1000, 1000};
+
+/* Fastest run of one workload under one mode */
+typedef struct Bench_Run {
+  int ret;
+  long long instructions;
+  long long cycles;       // 0 for functional and jit, estimated for sampled
+  double seconds;
+  unsigned int state;     // checksum of final registers, flags and data memory
+} Bench_Run;
+
+static unsigned int state_checksum(const APEX_CPU* cpu) {
+  // FNV-1a over architectural state a run leaves behind, same for every mode running the program right
+  const int* parts[] = {cpu->regs, cpu->flags, cpu->data_memory};
+  const size_t sizes[] = {sizeof(cpu->regs), sizeof(cpu->flags), sizeof(cpu->data_memory)};
+  unsigned int hash = 2166136261u;
+  for (int p = 0; p < 3; ++p) {
+    const unsigned char* bytes = (const unsigned char*)parts[p];
+    for (size_t i = 0; i < sizes[p]; ++i) {
+      hash = (hash ^ bytes[i]) * 16777619u;
+    }
+  }
+  return hash;
+}
+
+static int run_mode(const APEX_CPU* workload, const APEX_Config* config, int mode, Bench_Run* run) {
+  // One run of workload from the start, only the run is timed, not copying the workload
+  APEX_CPU* cpu = APEX_cpu_clone(workload);
+  if (!cpu) {
+    return ERROR;
+  }
+  cpu->config = *config;
+  cpu->config.engine = (mode == BENCH_OOO);
+  long long executed = 0;
+  APEX_JIT_Stats stats;
+  APEX_Sample_Result result;
+  struct timespec start, stop;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  switch (mode) {
+    case BENCH_PIPELINE:
+    case BENCH_OOO:
+      run->ret = APEX_cpu_run_until(cpu, INT_MAX);
+      break;
+    case BENCH_SAMPLED:
+      run->ret = APEX_cpu_execute_sampled(cpu, &bench_schedule, &result);
+      break;
+    case BENCH_FUNCTIONAL:
+      run->ret = APEX_cpu_execute_functional(cpu, 0, &executed);
+      break;
+    default:
+      run->ret = APEX_cpu_execute_jit(cpu, 0, &executed, &stats);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &stop);
+  double seconds = (stop.tv_sec - start.tv_sec) + (stop.tv_nsec - start.tv_nsec) / 1e9;
+  if ((mode == BENCH_PIPELINE) || (mode == BENCH_OOO)) {
+    run->instructions = cpu->counters.ins_retired;
+    run->cycles = cpu->clock;
+  }
+  else if (mode == BENCH_SAMPLED) {
+    run->instructions = result.instructions;
+    run->cycles = llround(result.cycles);
+  }
+  else {
+    run->instructions = executed;
+    run->cycles = 0;
+  }
+  if ((run->seconds == 0.0) || (seconds < run->seconds)) {
+    run->seconds = seconds;
+  }
+  run->state = state_checksum(cpu);
+  APEX_cpu_stop(cpu);
+  return SUCCESS;
+}
+
+static const char* get_state_name(const Bench_Run* runs, int workload, int mode) {
+  // Final state of a mode compared with the functional run of the same workload
+  const Bench_Run* functional = &runs[workload * NUM_BENCH_MODES + BENCH_FUNCTIONAL];
+  if (mode == BENCH_FUNCTIONAL) {
+    return "reference";
+  }
+  return (runs[workload * NUM_BENCH_MODES + mode].state == functional->state) ? "match" : "differ";
+}
+
+static int write_csv(const char* filename, const Bench_Run* runs, const char* const* names, int num_workloads) {
+  FILE* fp = fopen(filename, "w");
+  if (!fp) {
+    return ERROR;
+  }
+  fprintf(fp, "workload,mode,return,state,instructions,cycles,cpi,host_ms,kips,mips\n");
+  for (int i = 0; i < num_workloads; ++i) {
+    for (int mode = 0; mode < NUM_BENCH_MODES; ++mode) {
+      const Bench_Run* run = &runs[i * NUM_BENCH_MODES + mode];
+      double kips = (run->seconds > 0) ? run->instructions / run->seconds / 1e3 : 0.0;
+      fprintf(fp, "%s,%s,%s,%s,%lld,%lld,%.4f,%.3f,%.1f,%.3f\n", names[i], mode_names[mode],
+              (run->ret == HALT) ? "HALT" : (run->ret == EMPTY) ? "EMPTY" : "ERROR",
+              get_state_name(runs, i, mode), run->instructions, run->cycles, run->instructions ? (double)run->cycles / run->instructions : 0.0,
+              run->seconds * 1e3, kips, kips / 1e3);
+    }
+  }
+  return (fclose(fp) == 0) ? SUCCESS : ERROR;
+}
+
+int APEX_cpu_run_bench(const char* const* workloads, int num_workloads, const char* config, int repeat,
+                       const char* csv_file) {
+  // Runs all workloads under every mode repeat times, config applies to the pipeline of every mode
+  APEX_Config base;
+  APEX_config_default(&base);
+  if (config && (APEX_config_parse(&base, config) != SUCCESS)) {
+    return ERROR;
+  }
+  if (repeat < 1) {
+    repeat = 1;
+  }
+
+  // every workload is parsed once, listing of code memory is not wanted here
+  FILE* null_out = fopen("/dev/null", "w");
+  Bench_Run* runs = calloc((size_t)num_workloads * NUM_BENCH_MODES, sizeof(Bench_Run));
+  int ret = (null_out && runs) ? SUCCESS : ERROR;
+  for (int i = 0; (ret == SUCCESS) && (i < num_workloads); ++i) {
+    APEX_CPU* workload = APEX_cpu_create(workloads[i], null_out);
+    if (!workload) {
+      fprintf(stderr, "APEX_Error : Unable to initialize CPU with %s\n", workloads[i]);
+      ret = ERROR;
+      break;
+    }
+    workload->quiet = 1;
+    for (int mode = 0; (ret == SUCCESS) && (mode < NUM_BENCH_MODES); ++mode) {
+      Bench_Run* run = &runs[i * NUM_BENCH_MODES + mode];
+      for (int r = 0; (ret == SUCCESS) && (r < repeat); ++r) {
+        ret = run_mode(workload, &base, mode, run);
+      }
+      printf("Bench :: %s %-10s %lld instructions, %lld cycles in %.3f ms (%.2f MIPS)\n", workloads[i],
+             mode_names[mode], run->instructions, run->cycles, run->seconds * 1e3,
+             (run->seconds > 0) ? run->instructions / run->seconds / 1e6 : 0.0);
+    }
+    if (ret == SUCCESS) {
+      // functional runs before jit, every mode is compared with it once all are done
+      printf("Bench :: %s final state", workloads[i]);
+      for (int mode = 0; mode < NUM_BENCH_MODES; ++mode) {
+        printf(" %s %s%s", mode_names[mode], get_state_name(runs, i, mode),
+               (mode < NUM_BENCH_MODES - 1) ? "," : "\n");
+      }
+    }
+    APEX_cpu_stop(workload);
+  }
+
+  if (ret == SUCCESS) {
+    ret = write_csv(csv_file, runs, workloads, num_workloads);
+    if (ret == SUCCESS) {
+      printf("Results written to %s\n", csv_file);
+    }
+    else {
+      fprintf(stderr, "APEX_Error : Unable to write results %s\n", csv_file);
+    }
+  }
+  if (null_out) {
+    fclose(null_out);
+  }
+  free(runs);
+  return ret;
+}
@@ -0,0 +1,26 @@
+MOVC,R1,#1
+MOVC,R2,#4005
+MOVC,R3,#65535
+MOVC,R5,#4096
+MOVC,R11,#16384
+MOVC,R6,#0
+MOVC,R7,#0
+MOVC,R10,#30000
+MUL,R1,R1,R2
+ADDL,R1,R1,#12345
+AND,R1,R1,R3
+AND,R4,R1,R5
+ADDL,R4,R4,#0
+BZ,#12
+ADDL,R6,R6,#3
+JUMP,R0,#4068
+SUBL,R6,R6,#1
+AND,R4,R1,R11
+ADDL,R4,R4,#0
+BNZ,#8
+ADDL,R7,R7,#1
+SUBL,R10,R10,#1
+BNZ,#-56
+STORE,R6,R0,#3600
+STORE,R7,R0,#3601
+HALT
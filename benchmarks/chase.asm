@@ -0,0 +1,22 @@
+MOVC,R1,#0
+MOVC,R2,#2048
+MOVC,R8,#2047
+MOVC,R9,#1024
+ADDL,R3,R1,#1237
+AND,R3,R3,R8
+STR,R3,R1,R9
+ADDL,R1,R1,#1
+SUBL,R2,R2,#1
+BNZ,#-20
+MOVC,R1,#0
+MOVC,R2,#0
+MOVC,R10,#32768
+LDR,R1,R1,R9
+LDR,R1,R1,R9
+LDR,R1,R1,R9
+LDR,R1,R1,R9
+ADD,R2,R2,R1
+SUBL,R10,R10,#1
+BNZ,#-24
+STORE,R2,R0,#3500
+HALT
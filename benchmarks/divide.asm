@@ -0,0 +1,17 @@
+MOVC,R1,#1
+MOVC,R2,#10
+MOVC,R3,#0
+MOVC,R10,#20000
+MOV,R4,R1
+DIV,R5,R4,R2
+MUL,R6,R5,R2
+SUB,R7,R4,R6
+ADD,R3,R3,R7
+MOV,R4,R5
+ADDL,R5,R5,#0
+BNZ,#-24
+ADDL,R1,R1,#1
+SUBL,R10,R10,#1
+BNZ,#-40
+STORE,R3,R0,#3700
+HALT
@@ -0,0 +1,38 @@
+MOVC,R10,#20000
+MOVC,R1,#0
+MOVC,R2,#3
+MOVC,R6,#0
+MOVC,R7,#0
+MOVC,R8,#0
+MOVC,R9,#0
+MOVC,R11,#65535
+AND,R3,R1,R2
+ADD,R3,R3,R3
+ADD,R3,R3,R3
+ADD,R3,R3,R3
+ADD,R3,R3,R3
+JUMP,R3,#4056
+ADD,R6,R6,R1
+ADDL,R6,R6,#3
+AND,R6,R6,R11
+JUMP,R0,#4120
+ADDL,R7,R7,#1
+ADD,R7,R7,R1
+AND,R7,R7,R11
+JUMP,R0,#4120
+EX-OR,R8,R8,R1
+ADDL,R8,R8,#7
+AND,R8,R8,R11
+JUMP,R0,#4120
+SUB,R9,R9,R1
+ADDL,R9,R9,#5
+AND,R9,R9,R11
+JUMP,R0,#4120
+ADDL,R1,R1,#1
+SUBL,R10,R10,#1
+BNZ,#-96
+STORE,R6,R0,#3600
+STORE,R7,R0,#3601
+STORE,R8,R0,#3602
+STORE,R9,R0,#3603
+HALT
@@ -0,0 +1,36 @@
+MOVC,R1,#0
+MOVC,R2,#256
+STORE,R1,R1,#0
+ADDL,R3,R1,#1
+STORE,R3,R1,#256
+ADDL,R1,R1,#1
+SUBL,R2,R2,#1
+BNZ,#-20
+MOVC,R20,#8
+MOVC,R1,#0
+MOVC,R10,#16
+MOVC,R2,#0
+MOVC,R11,#16
+MOVC,R6,#0
+MOV,R4,R1
+ADDL,R5,R2,#256
+MOVC,R12,#16
+LOAD,R7,R4,#0
+LOAD,R8,R5,#0
+MUL,R9,R7,R8
+ADD,R6,R6,R9
+ADDL,R4,R4,#1
+ADDL,R5,R5,#16
+SUBL,R12,R12,#1
+BNZ,#-28
+ADD,R13,R1,R2
+STORE,R6,R13,#512
+ADDL,R2,R2,#1
+SUBL,R11,R11,#1
+BNZ,#-64
+ADDL,R1,R1,#16
+SUBL,R10,R10,#1
+BNZ,#-84
+SUBL,R20,R20,#1
+BNZ,#-100
+HALT
@@ -0,0 +1,25 @@
+MOVC,R1,#0
+MOVC,R2,#1024
+MOVC,R3,#7
+STORE,R3,R1,#0
+ADDL,R3,R3,#3
+ADDL,R1,R1,#1
+SUBL,R2,R2,#1
+BNZ,#-16
+MOVC,R10,#50
+MOVC,R1,#0
+MOVC,R2,#256
+LOAD,R5,R1,#0
+LOAD,R6,R1,#1
+LOAD,R7,R1,#2
+LOAD,R8,R1,#3
+STORE,R5,R1,#2048
+STORE,R6,R1,#2049
+STORE,R7,R1,#2050
+STORE,R8,R1,#2051
+ADDL,R1,R1,#4
+SUBL,R2,R2,#1
+BNZ,#-40
+SUBL,R10,R10,#1
+BNZ,#-56
+HALT
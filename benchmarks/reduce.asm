@@ -0,0 +1,25 @@
+MOVC,R1,#0
+MOVC,R2,#2048
+STORE,R1,R1,#0
+ADDL,R1,R1,#1
+SUBL,R2,R2,#1
+BNZ,#-12
+MOVC,R10,#40
+MOVC,R1,#0
+MOVC,R2,#1024
+MOVC,R3,#0
+MOVC,R4,#0
+LOAD,R5,R1,#0
+LOAD,R6,R1,#1
+ADD,R3,R3,R5
+EX-OR,R4,R4,R6
+ADD,R3,R3,R6
+OR,R4,R4,R5
+ADDL,R1,R1,#2
+SUBL,R2,R2,#1
+BNZ,#-32
+SUBL,R10,R10,#1
+BNZ,#-56
+STORE,R3,R0,#3000
+STORE,R4,R0,#3001
+HALT
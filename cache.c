@@ -0,0 +1,175 @@
+/*
+ *  cache.c
+ *  Contains timing model of the caches, an L1 data cache accessed in Memory
+ *  One, an L1 instruction cache accessed in Fetch and an optional L2 shared
+ *  by both keep tags only, values always come from data_memory and
+ *  code_memory, a miss makes the stage wait for the next level
+ *
+ *  Author :
+ *  Sagar Vishwakarma (svishwa2@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpu.h"
+
+/* Code and data memory are separate address spaces, code lines are tagged above every data line in L2 */
+#define CODE_LINE_BASE (1 << 24)
+
+static void get_geometry(const APEX_CPU* cpu, int size, int assoc, int* sets, int* ways) {
+  // a cache smaller than one set becomes fully associative
+  int lines = size / cpu->config.line_size;
+  if (lines < 1) {
+    lines = 1;
+  }
+  *ways = (assoc < lines) ? assoc : lines;
+  *sets = lines / *ways;
+}
+
+static APEX_Cache_Line* find_victim(const APEX_CPU* cpu, APEX_Cache* cache, APEX_Cache_Line* set, int ways) {
+  // An invalid line first, then the line chosen by replacement policy
+  APEX_Cache_Line* victim = &set[0];
+  for (int i = 0; i < ways; ++i) {
+    if (!set[i].valid) {
+      return &set[i];
+    }
+    if (set[i].stamp < victim->stamp) {
+      victim = &set[i]; // oldest use for LRU, oldest fill for FIFO
+    }
+  }
+  if (cpu->config.replacement == 2) {
+    // xorshift, fixed seed keeps runs repeatable
+    unsigned int x = cache->random ? cache->random : 2463534242u;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    cache->random = x;
+    victim = &set[x % ways];
+  }
+  return victim;
+}
+
+static int access_cache(const APEX_CPU* cpu, APEX_Cache* cache, int size, int assoc, int line,
+                        int dirty, int allocate, int* evicted) {
+  // Looks up line, returns 1 on a hit. A miss fills the line if allocate,
+  // evicted gets the line number of a dirty victim or -1
+  int sets = 0;
+  int ways = 0;
+  get_geometry(cpu, size, assoc, &sets, &ways);
+  APEX_Cache_Line* set = &cache->lines[(line % sets) * ways];
+  cache->accesses++;
+  cache->time++;
+  *evicted = -1;
+  for (int i = 0; i < ways; ++i) {
+    if (set[i].valid && (set[i].tag == line)) {
+      cache->hits++;
+      if (cpu->config.replacement == 0) {
+        set[i].stamp = cache->time;
+      }
+      set[i].dirty |= dirty;
+      return 1;
+    }
+  }
+  cache->misses++;
+  if (allocate) {
+    APEX_Cache_Line* victim = find_victim(cpu, cache, set, ways);
+    if (victim->valid && victim->dirty) {
+      cache->writebacks++;
+      *evicted = victim->tag;
+    }
+    victim->tag = line;
+    victim->stamp = cache->time;
+    victim->valid = 1;
+    victim->dirty = dirty;
+  }
+  return 0;
+}
+
+static void write_next_level(APEX_CPU* cpu, int line) {
+  // Dirty victim or write-through store leaves L1 through a write buffer, Memory One does not wait for it
+  const APEX_Config* config = &cpu->config;
+  int write_back = (config->write_policy == 0);
+  int evicted = -1;
+  if (config->l2_size) {
+    access_cache(cpu, &cpu->l2, config->l2_size, config->l2_assoc, line, write_back, write_back, &evicted);
+  }
+}
+
+int access_data_cache(APEX_CPU* cpu, int address, int write) {
+  // Returns cycles a LOAD, LDR (write 0) or STORE, STR (write 1) of data memory address spends in Memory One
+  const APEX_Config* config = &cpu->config;
+  int line = address * 4 / config->line_size;
+  int write_back = (config->write_policy == 0);
+  int latency = config->l1d_latency;
+  int evicted = -1;
+  int hit = access_cache(cpu, &cpu->l1d, config->l1d_size, config->l1d_assoc, line,
+                         write && write_back, !write || write_back, &evicted);
+  if (evicted >= 0) {
+    write_next_level(cpu, evicted);
+  }
+  if (write && !write_back) {
+    write_next_level(cpu, line); // write-through store never waits for a miss
+  }
+  else if (!hit) {
+    if (config->l2_size) {
+      latency += config->l2_latency;
+      if (!access_cache(cpu, &cpu->l2, config->l2_size, config->l2_assoc, line, 0, 1, &evicted)) {
+        latency += config->mem_latency;
+      }
+    }
+    else {
+      latency += config->mem_latency;
+    }
+  }
+  cpu->counters.stall_memory += latency - config->l1d_latency;
+  return latency;
+}
+
+int access_instruction_cache(APEX_CPU* cpu, int pc) {
+  // Returns cycles Fetch waits for the line of pc, 0 on a hit. pc is a byte address,
+  // instruction i at pc 4000 + 4 * i shares a line with its neighbours
+  const APEX_Config* config = &cpu->config;
+  int line = pc / config->line_size;
+  int evicted = -1;
+  int latency = 0;
+  if (!access_cache(cpu, &cpu->l1i, config->l1i_size, config->l1i_assoc, line, 0, 1, &evicted)) {
+    if (config->l2_size) {
+      latency += config->l2_latency;
+      if (!access_cache(cpu, &cpu->l2, config->l2_size, config->l2_assoc, CODE_LINE_BASE + line, 0, 1, &evicted)) {
+        latency += config->mem_latency;
+      }
+    }
+    else {
+      latency += config->mem_latency;
+    }
+  }
+  return latency;
+}
+
+static void print_cache(APEX_CPU* cpu, const char* name, const APEX_Cache* cache) {
+  fprintf(cpu->out, "%s :: Accesses %d, Hits %d, Misses %d, Hit Rate %.2f%%, MPKI %.2f, Writebacks %d\n",
+          name, cache->accesses, cache->hits, cache->misses,
+          cache->accesses ? 100.0 * cache->hits / cache->accesses : 0.0,
+          cpu->counters.ins_retired ? 1000.0 * cache->misses / cpu->counters.ins_retired : 0.0, cache->writebacks);
+}
+
+void print_cache_stats(APEX_CPU* cpu) {
+  // Hit rates and misses per thousand instructions of every cache level, nothing without caches
+  if (cpu->config.l1i_size) {
+    print_cache(cpu, "L1I", &cpu->l1i);
+  }
+  if (cpu->config.l1d_size) {
+    print_cache(cpu, "L1D", &cpu->l1d);
+  }
+  if (cpu->config.l2_size && (cpu->config.l1i_size || cpu->config.l1d_size)) {
+    print_cache(cpu, "L2", &cpu->l2);
+  }
+  if (cpu->config.l1i_size) {
+    fprintf(cpu->out, "Cycles Fetch waited on instruction cache misses %d\n", cpu->counters.stall_icache);
+  }
+  if (cpu->config.l1d_size) {
+    fprintf(cpu->out, "Cycles Memory One waited on cache misses %d\n", cpu->counters.stall_memory);
+  }
+}
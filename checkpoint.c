@@ -0,0 +1,311 @@
+/*
+ *  checkpoint.c
+ *  Contains functions to write and restore checkpoints of APEX cpu state,
+ *  a checkpoint holds the pipeline latches and architectural state so a run
+ *  can be resumed or many experiments can start from one point
+ *
+ *  Author :
+ *  Sagar Vishwakarma (svishwa2@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpu.h"
+
+/* Bump this whenever APEX_Checkpoint_State or CPU_Stage changes */
+#define APEX_CHECKPOINT_VERSION 14
+
+static const char apex_checkpoint_magic[8] = {'A', 'P', 'E', 'X', 'C', 'K', 'P', '\0'};
+
+/*
+ * Layout of a checkpoint file
+ *   APEX_Checkpoint_Header
+ *   APEX_Checkpoint_State
+ *   APEX_Predictor                      (only with predictor enabled)
+ *   l1d, l1i, l2 lines in use and stats (only caches of non zero size)
+ *   int data_memory[data_memory_size]   (rest of data memory is zero)
+ */
+typedef struct APEX_Checkpoint_Header {
+  char magic[8];          // Identifies a checkpoint file
+  int version;            // APEX_CHECKPOINT_VERSION of the writer
+  int code_memory_size;   // Number of instructions of the program
+  unsigned int checksum;  // Checksum of code memory, restored only onto the same program
+  int data_memory_size;   // Data memory locations stored, trailing zeros are left out
+  char program[256];      // Input file of the program, only for messages
+} APEX_Checkpoint_Header;
+
+/* Parameters the saved latches, caches and predictor depend on, a restore must run with the same */
+static const char* const apex_checkpoint_params[] = {
+  "engine", "width", "forwarding",
+  "predictor", "btb_entries", "history_bits",
+  "l1d_size", "l1d_assoc", "l2_size", "l2_assoc", "line_size", "replacement", "write_policy",
+  "l1i_size", "l1i_assoc",
+  "alu_units", "mul_units", "mul_pipelined", "div_units", "div_pipelined",
+};
+
+/* State of APEX_CPU saved in a checkpoint, everything but code memory and run options */
+typedef struct APEX_Checkpoint_State {
+  APEX_Config config;
+  int clock;
+  int pc;
+  CPU_Stage stage[MAX_ISSUE_WIDTH][NUM_STAGES];
+  int group_size[NUM_STAGES];
+  int group_split;
+  int unit_wait;
+  APEX_Units units;
+  APEX_Counters counters;
+  unsigned int busy;
+  unsigned int stalled;
+  unsigned int executed;
+  unsigned int empty;
+  unsigned int bubble;
+  unsigned int predicted;
+  unsigned int waiting;
+  int wait_cycles[NUM_STAGES];
+  int regs[REGISTER_FILE_SIZE];
+  unsigned int dest_masks[NUM_STAGES];
+  unsigned int regs_pending;
+  int flags[NUM_FLAG];
+  int ins_fetched;
+  unsigned int history;   // predictor state kept even with predictor disabled
+  int branches;
+  int mispredictions;
+  int icache_pending;
+} APEX_Checkpoint_State;
+
+static size_t get_cache_lines(const APEX_CPU* cpu, int size) {
+  // lines a cache of size can use, see get_geometry in cache.c
+  if (!size) {
+    return 0;
+  }
+  int lines = size / cpu->config.line_size;
+  if (lines < 1) {
+    lines = 1;
+  }
+  return (lines < CACHE_MAX_LINES) ? (size_t)lines : CACHE_MAX_LINES;
+}
+
+static int write_cache(FILE* fp, const APEX_Cache* cache, size_t lines) {
+  // lines in use, then everything after the lines
+  size_t rest = sizeof(APEX_Cache) - offsetof(APEX_Cache, time);
+  if (!lines) {
+    return SUCCESS;
+  }
+  if ((fwrite(cache->lines, sizeof(APEX_Cache_Line), lines, fp) != lines) ||
+      (fwrite(&cache->time, rest, 1, fp) != 1)) {
+    return ERROR;
+  }
+  return SUCCESS;
+}
+
+static int read_cache(FILE* fp, APEX_Cache* cache, size_t lines) {
+  size_t rest = sizeof(APEX_Cache) - offsetof(APEX_Cache, time);
+  if (!lines) {
+    return SUCCESS;
+  }
+  if ((fread(cache->lines, sizeof(APEX_Cache_Line), lines, fp) != lines) ||
+      (fread(&cache->time, rest, 1, fp) != 1)) {
+    return ERROR;
+  }
+  return SUCCESS;
+}
+
+static unsigned int code_memory_checksum(const APEX_CPU* cpu) {
+  // FNV-1a over decoded code memory
+  const unsigned char* bytes = (const unsigned char*)cpu->code_memory;
+  size_t size = sizeof(APEX_Instruction) * cpu->code_memory_size;
+  unsigned int hash = 2166136261u;
+  for (size_t i = 0; i < size; ++i) {
+    hash = (hash ^ bytes[i]) * 16777619u;
+  }
+  return hash;
+}
+
+int write_checkpoint(const APEX_CPU* cpu, const char* filename) {
+  // Writes to a temporary file first, an interrupted write never replaces a good checkpoint
+  if (!cpu || !filename) {
+    return ERROR;
+  }
+  if (cpu->config.engine) {
+    fprintf(stderr, "APEX_Error : Checkpoints hold the in-order pipeline, not the out-of-order engine\n");
+    return ERROR;
+  }
+  APEX_Checkpoint_Header header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, apex_checkpoint_magic, sizeof(header.magic));
+  header.version = APEX_CHECKPOINT_VERSION;
+  header.code_memory_size = cpu->code_memory_size;
+  header.checksum = code_memory_checksum(cpu);
+  header.data_memory_size = DATA_MEMORY_SIZE;
+  while ((header.data_memory_size > 0) && !cpu->data_memory[header.data_memory_size - 1]) {
+    header.data_memory_size--;
+  }
+  if (cpu->program_file) {
+    strncpy(header.program, cpu->program_file, sizeof(header.program) - 1);
+  }
+
+  APEX_Checkpoint_State state;
+  memset(&state, 0, sizeof(state));
+  state.config = cpu->config;
+  state.clock = cpu->clock;
+  state.pc = cpu->pc;
+  memcpy(state.stage, cpu->stage, sizeof(state.stage));
+  memcpy(state.group_size, cpu->group_size, sizeof(state.group_size));
+  state.group_split = cpu->group_split;
+  state.unit_wait = cpu->unit_wait;
+  state.units = cpu->units;
+  state.counters = cpu->counters;
+  state.busy = cpu->busy;
+  state.stalled = cpu->stalled;
+  state.executed = cpu->executed;
+  state.empty = cpu->empty;
+  state.bubble = cpu->bubble;
+  state.predicted = cpu->predicted;
+  state.waiting = cpu->waiting;
+  memcpy(state.wait_cycles, cpu->wait_cycles, sizeof(state.wait_cycles));
+  memcpy(state.regs, cpu->regs, sizeof(state.regs));
+  memcpy(state.dest_masks, cpu->dest_masks, sizeof(state.dest_masks));
+  state.regs_pending = cpu->regs_pending;
+  memcpy(state.flags, cpu->flags, sizeof(state.flags));
+  state.ins_fetched = cpu->ins_fetched;
+  state.history = cpu->predictor.history;
+  state.branches = cpu->predictor.branches;
+  state.mispredictions = cpu->predictor.mispredictions;
+  state.icache_pending = cpu->icache_pending;
+
+  size_t length = strlen(filename);
+  char* temp_filename = malloc(length + 5);
+  if (!temp_filename) {
+    return ERROR;
+  }
+  memcpy(temp_filename, filename, length);
+  memcpy(temp_filename + length, ".tmp", 5);
+  FILE* fp = fopen(temp_filename, "wb");
+  if (!fp) {
+    free(temp_filename);
+    return ERROR;
+  }
+  int ret = SUCCESS;
+  if ((fwrite(&header, sizeof(header), 1, fp) != 1) ||
+      (fwrite(&state, sizeof(state), 1, fp) != 1) ||
+      (cpu->config.predictor && (fwrite(&cpu->predictor, sizeof(cpu->predictor), 1, fp) != 1)) ||
+      (write_cache(fp, &cpu->l1d, get_cache_lines(cpu, cpu->config.l1d_size)) != SUCCESS) ||
+      (write_cache(fp, &cpu->l1i, get_cache_lines(cpu, cpu->config.l1i_size)) != SUCCESS) ||
+      (write_cache(fp, &cpu->l2, get_cache_lines(cpu, cpu->config.l2_size)) != SUCCESS) ||
+      (fwrite(cpu->data_memory, sizeof(int), header.data_memory_size, fp) != (size_t)header.data_memory_size)) {
+    ret = ERROR;
+  }
+  if (fclose(fp) != 0) {
+    ret = ERROR;
+  }
+  if ((ret == SUCCESS) && (rename(temp_filename, filename) != 0)) {
+    ret = ERROR;
+  }
+  if (ret != SUCCESS) {
+    remove(temp_filename);
+  }
+  free(temp_filename);
+  return ret;
+}
+
+static int check_config(const APEX_Config* saved, const APEX_Config* config, const char* filename) {
+  // Latencies may differ for what-if runs, the shape of the saved state may not
+  int count = sizeof(apex_checkpoint_params) / sizeof(apex_checkpoint_params[0]);
+  for (int i = 0; i < count; ++i) {
+    int saved_value = 0;
+    int value = 0;
+    APEX_config_get(saved, apex_checkpoint_params[i], &saved_value);
+    APEX_config_get(config, apex_checkpoint_params[i], &value);
+    if (saved_value != value) {
+      fprintf(stderr, "APEX_Error : checkpoint %s was taken with %s=%d, this run has %s=%d\n",
+              filename, apex_checkpoint_params[i], saved_value, apex_checkpoint_params[i], value);
+      return ERROR;
+    }
+  }
+  return SUCCESS;
+}
+
+int load_checkpoint(APEX_CPU* cpu, const char* filename) {
+  // Restores state onto a cpu created for the same program, code memory and run options are kept
+  if (cpu->config.engine) {
+    fprintf(stderr, "APEX_Error : Checkpoints hold the in-order pipeline, not the out-of-order engine\n");
+    return ERROR;
+  }
+  FILE* fp = fopen(filename, "rb");
+  if (!fp) {
+    return ERROR;
+  }
+  APEX_Checkpoint_Header header;
+  APEX_Checkpoint_State state;
+  if ((fread(&header, sizeof(header), 1, fp) != 1) ||
+      (memcmp(header.magic, apex_checkpoint_magic, sizeof(header.magic)) != 0) ||
+      (header.version != APEX_CHECKPOINT_VERSION) ||
+      (header.data_memory_size < 0) || (header.data_memory_size > DATA_MEMORY_SIZE) ||
+      (fread(&state, sizeof(state), 1, fp) != 1)) {
+    fprintf(stderr, "APEX_Error : %s is not a valid version %d checkpoint\n", filename, APEX_CHECKPOINT_VERSION);
+    fclose(fp);
+    return ERROR;
+  }
+  header.program[sizeof(header.program) - 1] = '\0';
+  if ((header.code_memory_size != cpu->code_memory_size) || (header.checksum != code_memory_checksum(cpu))) {
+    fprintf(stderr, "APEX_Error : checkpoint %s was taken from a different program (%s)\n", filename, header.program);
+    fclose(fp);
+    return ERROR;
+  }
+  if (check_config(&state.config, &cpu->config, filename) != SUCCESS) {
+    fclose(fp);
+    return ERROR;
+  }
+  // sections of disabled structures are not stored, those keep the state of the new cpu
+  APEX_Predictor predictor = cpu->predictor;
+  APEX_Cache l1d = cpu->l1d;
+  APEX_Cache l1i = cpu->l1i;
+  APEX_Cache l2 = cpu->l2;
+  int data_memory[DATA_MEMORY_SIZE] = {0};
+  if ((cpu->config.predictor && (fread(&predictor, sizeof(predictor), 1, fp) != 1)) ||
+      (read_cache(fp, &l1d, get_cache_lines(cpu, cpu->config.l1d_size)) != SUCCESS) ||
+      (read_cache(fp, &l1i, get_cache_lines(cpu, cpu->config.l1i_size)) != SUCCESS) ||
+      (read_cache(fp, &l2, get_cache_lines(cpu, cpu->config.l2_size)) != SUCCESS) ||
+      (fread(data_memory, sizeof(int), header.data_memory_size, fp) != (size_t)header.data_memory_size)) {
+    fprintf(stderr, "APEX_Error : checkpoint %s is truncated\n", filename);
+    fclose(fp);
+    return ERROR;
+  }
+  fclose(fp);
+
+  cpu->clock = state.clock;
+  cpu->pc = state.pc;
+  memcpy(cpu->stage, state.stage, sizeof(state.stage));
+  memcpy(cpu->group_size, state.group_size, sizeof(cpu->group_size));
+  cpu->group_split = state.group_split;
+  cpu->unit_wait = state.unit_wait;
+  cpu->units = state.units;
+  cpu->counters = state.counters;
+  cpu->busy = state.busy;
+  cpu->stalled = state.stalled;
+  cpu->executed = state.executed;
+  cpu->empty = state.empty;
+  cpu->bubble = state.bubble;
+  cpu->predicted = state.predicted;
+  cpu->waiting = state.waiting;
+  memcpy(cpu->wait_cycles, state.wait_cycles, sizeof(state.wait_cycles));
+  memcpy(cpu->regs, state.regs, sizeof(state.regs));
+  memcpy(cpu->dest_masks, state.dest_masks, sizeof(state.dest_masks));
+  cpu->regs_pending = state.regs_pending;
+  memcpy(cpu->flags, state.flags, sizeof(state.flags));
+  cpu->ins_fetched = state.ins_fetched;
+  cpu->predictor = predictor;
+  cpu->predictor.history = state.history;
+  cpu->predictor.branches = state.branches;
+  cpu->predictor.mispredictions = state.mispredictions;
+  cpu->icache_pending = state.icache_pending;
+  cpu->l1d = l1d;
+  cpu->l1i = l1i;
+  cpu->l2 = l2;
+  memcpy(cpu->data_memory, data_memory, sizeof(data_memory));
+  fprintf(stderr, "APEX_CPU : Restored checkpoint %s of %s at cycle %d\n", filename, header.program, cpu->clock);
+  return SUCCESS;
+}
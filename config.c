@@ -0,0 +1,123 @@
+/*
+ *  config.c
+ *  Contains pipeline parameters that are chosen at run time, each parameter
+ *  has a name so command line options and sweeps can set it
+ *
+ *  Author :
+ *  Sagar Vishwakarma (svishwa2@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+
+#include "cpu.h"
+
+/* Name, place in APEX_Config and allowed values of every parameter */
+static const struct {
+  const char* name;
+  size_t offset;
+  int default_value;
+  int min;
+  int max;
+} config_params[] = {
+  {"branch_penalty", offsetof(APEX_Config, branch_penalty), 0, 0, 64},
+  {"mul_latency",    offsetof(APEX_Config, mul_latency),    1, 1, 64},
+  {"div_latency",    offsetof(APEX_Config, div_latency),    1, 1, 64},
+  {"mem_latency",    offsetof(APEX_Config, mem_latency),    1, 1, 1024},
+  {"forwarding",     offsetof(APEX_Config, forwarding),     0, 0, 1},
+  {"predictor",      offsetof(APEX_Config, predictor),      0, 0, 2},
+  {"btb_entries",    offsetof(APEX_Config, btb_entries),    256, 1, PREDICTOR_TABLE_SIZE},
+  {"history_bits",   offsetof(APEX_Config, history_bits),   8, 1, 12},
+  {"l1d_size",       offsetof(APEX_Config, l1d_size),       0, 0, DATA_MEMORY_SIZE * 4},
+  {"l1d_assoc",      offsetof(APEX_Config, l1d_assoc),      2, 1, 64},
+  {"l1d_latency",    offsetof(APEX_Config, l1d_latency),    1, 1, 64},
+  {"l2_size",        offsetof(APEX_Config, l2_size),        0, 0, DATA_MEMORY_SIZE * 4},
+  {"l2_assoc",       offsetof(APEX_Config, l2_assoc),       8, 1, 64},
+  {"l2_latency",     offsetof(APEX_Config, l2_latency),     8, 1, 256},
+  {"line_size",      offsetof(APEX_Config, line_size),      32, 4, 256},
+  {"replacement",    offsetof(APEX_Config, replacement),    0, 0, 2},
+  {"write_policy",   offsetof(APEX_Config, write_policy),   0, 0, 1},
+  {"l1i_size",       offsetof(APEX_Config, l1i_size),       0, 0, CACHE_MAX_LINES * 4},
+  {"l1i_assoc",      offsetof(APEX_Config, l1i_assoc),      2, 1, 64},
+  {"engine",         offsetof(APEX_Config, engine),         0, 0, 1},
+  {"width",          offsetof(APEX_Config, width),          1, 1, MAX_ISSUE_WIDTH},
+  {"rob_size",       offsetof(APEX_Config, rob_size),       32, 1, OOO_MAX_ENTRIES},
+  {"iq_size",        offsetof(APEX_Config, iq_size),        16, 1, OOO_MAX_ENTRIES},
+  {"lsq_size",       offsetof(APEX_Config, lsq_size),       16, 1, OOO_MAX_ENTRIES},
+  {"prf_size",       offsetof(APEX_Config, prf_size),       96, REGISTER_FILE_SIZE + 3, OOO_MAX_PHYS_REGS},
+  {"alu_units",      offsetof(APEX_Config, alu_units),      MAX_FUNCTIONAL_UNITS, 1, MAX_FUNCTIONAL_UNITS},
+  {"alu_latency",    offsetof(APEX_Config, alu_latency),    1, 1, 64},
+  {"mul_units",      offsetof(APEX_Config, mul_units),      1, 1, MAX_FUNCTIONAL_UNITS},
+  {"mul_pipelined",  offsetof(APEX_Config, mul_pipelined),  1, 0, 1},
+  {"div_units",      offsetof(APEX_Config, div_units),      1, 1, MAX_FUNCTIONAL_UNITS},
+  {"div_pipelined",  offsetof(APEX_Config, div_pipelined),  0, 0, 1},
+};
+
+#define NUM_CONFIG_PARAMS (int)(sizeof(config_params) / sizeof(config_params[0]))
+
+static int find_param(const char* name, size_t length) {
+  for (int i = 0; i < NUM_CONFIG_PARAMS; ++i) {
+    if ((strlen(config_params[i].name) == length) && !strncmp(config_params[i].name, name, length)) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+void APEX_config_default(APEX_Config* config) {
+  // Defaults give the 7 stage pipeline with one cycle per stage
+  for (int i = 0; i < NUM_CONFIG_PARAMS; ++i) {
+    *(int*)((char*)config + config_params[i].offset) = config_params[i].default_value;
+  }
+}
+
+int APEX_config_set(APEX_Config* config, const char* name, int value) {
+  int index = find_param(name, strlen(name));
+  if ((index < 0) || (value < config_params[index].min) || (value > config_params[index].max)) {
+    return ERROR;
+  }
+  *(int*)((char*)config + config_params[index].offset) = value;
+  return SUCCESS;
+}
+
+int APEX_config_get(const APEX_Config* config, const char* name, int* value) {
+  int index = find_param(name, strlen(name));
+  if (index < 0) {
+    return ERROR;
+  }
+  *value = *(const int*)((const char*)config + config_params[index].offset);
+  return SUCCESS;
+}
+
+int APEX_config_parse(APEX_Config* config, const char* assignments) {
+  // Sets parameters from "name=value,name=value", prints parameters and ranges on a bad one
+  const char* p = assignments;
+  while (*p) {
+    const char* end = p + strcspn(p, ",");
+    const char* equal = memchr(p, '=', end - p);
+    int index = equal ? find_param(p, equal - p) : -1;
+    char* value_end = NULL;
+    long value = (index >= 0) ? strtol(equal + 1, &value_end, 10) : 0;
+    if ((index < 0) || (value_end != end) || (value < config_params[index].min) || (value > config_params[index].max)) {
+      fprintf(stderr, "APEX_Error : Invalid parameter %.*s, parameters are\n", (int)(end - p), p);
+      for (int i = 0; i < NUM_CONFIG_PARAMS; ++i) {
+        fprintf(stderr, "  %s=%d..%d (default %d)\n", config_params[i].name,
+                config_params[i].min, config_params[i].max, config_params[i].default_value);
+      }
+      return ERROR;
+    }
+    *(int*)((char*)config + config_params[index].offset) = (int)value;
+    p = *end ? end + 1 : end;
+  }
+  return SUCCESS;
+}
+
+int APEX_config_num_params(void) {
+  return NUM_CONFIG_PARAMS;
+}
+
+const char* APEX_config_param_name(int index) {
+  return ((index >= 0) && (index < NUM_CONFIG_PARAMS)) ? config_params[index].name : NULL;
+}
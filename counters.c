@@ -0,0 +1,135 @@
+/*
+ *  counters.c
+ *  Contains performance counters of a run, cycles, instructions of the
+ *  program (bubbles not counted), CPI and stall cycles by cause, every
+ *  counter has a name so it can be read by programs driving the simulator
+ *
+ *  Author :
+ *  Sagar Vishwakarma (svishwa2@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+
+#include "cpu.h"
+
+/* Name and place in APEX_Counters of every counter, an array counter reads as the sum of its entries */
+static const struct {
+  const char* name;
+  size_t offset;
+  int count;
+} counters[] = {
+  {"instructions",     offsetof(APEX_Counters, ins_retired),       1},
+  {"loads",            offsetof(APEX_Counters, loads),             1},
+  {"stores",           offsetof(APEX_Counters, stores),            1},
+  {"stall_raw",        offsetof(APEX_Counters, stall_raw),         REGISTER_FILE_SIZE},
+  {"stall_flags",      offsetof(APEX_Counters, stall_flags),       1},
+  {"stall_halt",       offsetof(APEX_Counters, stall_halt),        1},
+  {"stall_structural", offsetof(APEX_Counters, stall_structural),  1},
+  {"stall_branch",     offsetof(APEX_Counters, stall_branch),      1},
+  {"stall_memory",     offsetof(APEX_Counters, stall_memory),      1},
+  {"stall_icache",     offsetof(APEX_Counters, stall_icache),      1},
+  {"flushes",          offsetof(APEX_Counters, flushes),           1},
+  {"squashed",         offsetof(APEX_Counters, squashed),          1},
+  {"cycles_skipped",   offsetof(APEX_Counters, cycles_skipped),    1},
+};
+
+#define NUM_COUNTERS (int)(sizeof(counters) / sizeof(counters[0]))
+
+/* Counters not kept in APEX_Counters, worked out when read, named before the ones of the table */
+static const char* derived_counters[] = {"cycles", "stall_data"};
+
+#define NUM_DERIVED_COUNTERS (int)(sizeof(derived_counters) / sizeof(derived_counters[0]))
+
+static int get_raw_register(const char* name) {
+  // Register of a stall_raw_r<N> name, -1 for any other name
+  const char* prefix = "stall_raw_r";
+  size_t length = strlen(prefix);
+  if (strncmp(name, prefix, length) || (name[length] == '\0')) {
+    return -1;
+  }
+  char* end = NULL;
+  long reg_number = strtol(name + length, &end, 10);
+  if (*end || (reg_number < 0) || (reg_number >= REGISTER_FILE_SIZE)) {
+    return -1;
+  }
+  return (int)reg_number;
+}
+
+int APEX_counter_get(const APEX_CPU* cpu, const char* name, int* value) {
+  // Value of the counter called name, stall_raw_r<N> gives RAW stall cycles of register N alone
+  int reg_number = get_raw_register(name);
+  if (reg_number >= 0) {
+    *value = cpu->counters.stall_raw[reg_number];
+    return SUCCESS;
+  }
+  if (!strcmp(name, "cycles")) {
+    *value = cpu->clock;
+    return SUCCESS;
+  }
+  if (!strcmp(name, "stall_data")) {
+    // cycles Decode/RF waited on a register or flags, every one of them has its cause counted
+    APEX_counter_get(cpu, "stall_raw", value);
+    *value += cpu->counters.stall_flags;
+    return SUCCESS;
+  }
+  for (int i = 0; i < NUM_COUNTERS; ++i) {
+    if (!strcmp(counters[i].name, name)) {
+      const int* counter = (const int*)((const char*)&cpu->counters + counters[i].offset);
+      *value = 0;
+      for (int j = 0; j < counters[i].count; ++j) {
+        *value += counter[j];
+      }
+      return SUCCESS;
+    }
+  }
+  return ERROR;
+}
+
+int APEX_counter_num(void) {
+  return NUM_DERIVED_COUNTERS + NUM_COUNTERS;
+}
+
+const char* APEX_counter_name(int index) {
+  if ((index >= 0) && (index < NUM_DERIVED_COUNTERS)) {
+    return derived_counters[index];
+  }
+  index -= NUM_DERIVED_COUNTERS;
+  return ((index >= 0) && (index < NUM_COUNTERS)) ? counters[index].name : NULL;
+}
+
+void count_data_stall(APEX_CPU* cpu, int cycles) {
+  // Decode/RF waited cycles on the register or flags it last found pending
+  int cause = cpu->counters.stall_cause;
+  if (cause == STALL_FLAGS) {
+    cpu->counters.stall_flags += cycles;
+  }
+  else if ((cause >= 0) && (cause < REGISTER_FILE_SIZE)) {
+    cpu->counters.stall_raw[cause] += cycles;
+  }
+}
+
+void print_perf_counters(APEX_CPU* cpu) {
+  // Counter block printed once a run ends, RAW stalls are listed only for registers that had any
+  int value = 0;
+  fprintf(cpu->out, "============ PERFORMANCE COUNTERS ============\n");
+  fprintf(cpu->out, "Cycles %d, Instructions %d, CPI %.2f\n", cpu->clock, cpu->counters.ins_retired,
+          cpu->counters.ins_retired ? (double)cpu->clock / cpu->counters.ins_retired : 0.0);
+  APEX_counter_get(cpu, "stall_raw", &value);
+  fprintf(cpu->out, "Stall Cycles :: RAW %d, Flags %d, HALT Drain %d, Structural %d, Memory %d, Instruction Cache %d\n",
+          value, cpu->counters.stall_flags, cpu->counters.stall_halt, cpu->counters.stall_structural,
+          cpu->counters.stall_memory, cpu->counters.stall_icache);
+  if (value) {
+    fprintf(cpu->out, "RAW Stall Cycles ::");
+    for (int i = 0; i < REGISTER_FILE_SIZE; ++i) {
+      if (cpu->counters.stall_raw[i]) {
+        fprintf(cpu->out, " R%02d %d", i, cpu->counters.stall_raw[i]);
+      }
+    }
+    fprintf(cpu->out, "\n");
+  }
+  fprintf(cpu->out, "Flushes %d, Squashed Instructions %d\n", cpu->counters.flushes, cpu->counters.squashed);
+  fprintf(cpu->out, "Loads %d, Stores %d\n", cpu->counters.loads, cpu->counters.stores);
+}
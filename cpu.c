@@ -10,6 +10,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <limits.h>
+#include <time.h>
 
 #include "cpu.h"
 
@@ -20,66 +21,142 @@
 #define ENABLE_REG_MEM_STATUS_PRINT 1
 #define ENABLE_PUSH_STAGE_PRINT 0
 
+/* Set this flag to 1 to print performance counters once a run ends */
+#define ENABLE_PERF_COUNTER_PRINT 1
+
+/* Set this flag to 0 to simulate every cycle of quiet runs one by one */
+#define ENABLE_CYCLE_SKIPPING 1
+
 /*
  * ########################################## Initialize CPU ##########################################
  */
 
 APEX_CPU* APEX_cpu_init(const char* filename) {
-  // This function creates and initializes APEX cpu.
-  if (!filename) {
+  // This function creates and initializes APEX cpu printing to stdout.
+  return APEX_cpu_create(filename, stdout);
+}
+
+APEX_CPU* APEX_cpu_create(const char* filename, FILE* out) {
+  // This function creates and initializes APEX cpu, simulation output goes to out.
+  if (!filename || !out) {
     return NULL;
   }
-  // memory allocation of struct APEX_CPU to struct pointer cpu
-  APEX_CPU* cpu = malloc(sizeof(*cpu));
+  // memory allocation of struct APEX_CPU to struct pointer cpu, clock and stats start at 0
+  APEX_CPU* cpu = calloc(1, sizeof(*cpu));
   if (!cpu) {
     return NULL;
   }
 
   /* Initialize PC, Registers and all pipeline stages */
+  cpu->out = out;
   cpu->pc = 4000;
+  APEX_config_default(&cpu->config);
   memset(cpu->regs, 0, sizeof(int) * REGISTER_FILE_SIZE);  // fill a block of memory with a particular value here value is 0 for 32 regs with size 4 Bytes
-  memset(cpu->regs_invalid, 0, sizeof(int) * REGISTER_FILE_SIZE);  // all registers are valid at start, set to value 1
-  memset(cpu->stage, 0, sizeof(CPU_Stage) * NUM_STAGES); // all values in stage struct of type CPU_Stage like pc, rs1, etc are set to 0
+  memset(cpu->stage, 0, sizeof(cpu->stage)); // all values in stage struct of type CPU_Stage like pc, rs1, etc are set to 0
+  cpu->busy = cpu->stalled = cpu->executed = cpu->empty = cpu->bubble = 0; // all stage status bits are cleared
   memset(cpu->data_memory, 0, sizeof(int) * 4000); // from 4000 to 4095 there will be garbage values in data_memory array
   memset(cpu->flags, 0, sizeof(int) * NUM_FLAG); // all flag values in cpu are set to 0
+  memset(cpu->predictor.counters, 1, sizeof(cpu->predictor.counters)); // branches start weakly not taken
 
-  /* Parse input file and create code memory */
-  cpu->code_memory = create_code_memory(filename, &cpu->code_memory_size);
+  /* Map pre-assembled program image, or parse input file and create code memory */
+  if (is_program_image(filename)) {
+    load_program_image(cpu, filename);
+  }
+  else {
+    struct timespec start, stop;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    cpu->code_memory = create_code_memory(filename, &cpu->code_memory_size);
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+    double seconds = (stop.tv_sec - start.tv_sec) + (stop.tv_nsec - start.tv_nsec) / 1e9;
+    if (cpu->code_memory) {
+      fprintf(stderr, "APEX_CPU : Parsed %d lines in %.3f ms (%.0f lines/sec)\n",
+              cpu->code_memory_size, seconds * 1e3, (seconds > 0) ? cpu->code_memory_size / seconds : 0.0);
+    }
+  }
 
   if (!cpu->code_memory) {
     free(cpu); // If code_memory is not created free the memory for cpu struct
     return NULL;
   }
+  cpu->program_file = filename;
   // Below code just prints the instructions and operands before execution
   if (ENABLE_DEBUG_MESSAGES) {
     fprintf(stderr,
             "APEX_CPU : Initialized APEX CPU, loaded %d instructions\n",
             cpu->code_memory_size);
     fprintf(stderr, "APEX_CPU : Printing Code Memory\n");
-    printf("%-9s %-9s %-9s %-9s %-9s\n", "opcode", "rd", "rs1", "rs2", "imm");
+    fprintf(cpu->out, "%-9s %-9s %-9s %-9s %-9s\n", "opcode", "rd", "rs1", "rs2", "imm");
 
     for (int i = 0; i < cpu->code_memory_size; ++i) {
-      printf("%-9s %-9d %-9d %-9d %-9d\n",
-             cpu->code_memory[i].opcode,
-             cpu->code_memory[i].rd,
-             cpu->code_memory[i].rs1,
-             cpu->code_memory[i].rs2,
-             cpu->code_memory[i].imm);
+      fprintf(cpu->out, "%-9s %-9d %-9d %-9d %-9d\n",
+                        get_opcode_name(cpu->code_memory[i].opcode),
+                        cpu->code_memory[i].rd,
+                        cpu->code_memory[i].rs1,
+                        cpu->code_memory[i].rs2,
+                        cpu->code_memory[i].imm);
     }
   }
 
+  APEX_cpu_reset_pipeline(cpu);
+
+  return cpu;
+}
+
+void APEX_cpu_reset_pipeline(APEX_CPU* cpu) {
+  // Empties all stages so the pipeline starts fetching from cpu->pc, architectural state is kept
+  memset(cpu->stage, 0, sizeof(cpu->stage));
+  memset(cpu->dest_masks, 0, sizeof(cpu->dest_masks)); // no writes in flight, all registers are valid
+  cpu->regs_pending = 0;
+  cpu->busy = cpu->stalled = cpu->executed = cpu->empty = cpu->bubble = cpu->predicted = cpu->waiting = 0;
+  cpu->icache_pending = 0;
+  cpu->group_split = 0;
+  cpu->unit_wait = 0;
+  memset(cpu->units.free_cycle, 0, sizeof(cpu->units.free_cycle));
+  cpu->ooo.started = 0; // out-of-order engine renames from architectural state again
+  memset(cpu->wait_cycles, 0, sizeof(cpu->wait_cycles));
+
   /* Make all stages busy except Fetch stage, initally to start the pipeline */
+  /* pc 0 is outside code memory, so all stages start without any instruction */
   for (int i = 1; i < NUM_STAGES; ++i) {
-    cpu->stage[i].busy = 1;
-    cpu->stage[i].empty = 1;
+    cpu->busy |= STAGE_BIT(i);
+    cpu->empty |= STAGE_BIT(i);
+  }
+  for (int i = 0; i < NUM_STAGES; ++i) {
+    cpu->group_size[i] = 1;
   }
+}
 
-  return cpu;
+APEX_CPU* APEX_cpu_clone(const APEX_CPU* cpu) {
+  // Copy of cpu with its own code memory, a clone of a new cpu runs the program from the start
+  APEX_CPU* clone = malloc(sizeof(*clone));
+  if (!clone) {
+    return NULL;
+  }
+  *clone = *cpu;
+  clone->program_image = NULL;
+  clone->program_image_size = 0;
+  clone->memory_access = NULL;
+  clone->trace = NULL;
+  clone->timeline = NULL;
+  clone->code_memory = malloc(sizeof(APEX_Instruction) * cpu->code_memory_size);
+  if (!clone->code_memory) {
+    free(clone);
+    return NULL;
+  }
+  memcpy(clone->code_memory, cpu->code_memory, sizeof(APEX_Instruction) * cpu->code_memory_size);
+  return clone;
 }
 
 void APEX_cpu_stop(APEX_CPU* cpu) {
   // This function de-allocates APEX cpu.
-  free(cpu->code_memory);
+  APEX_trace_close(cpu);
+  APEX_timeline_close(cpu);
+  if (cpu->program_image) {
+    unload_program_image(cpu);
+  }
+  else {
+    free(cpu->code_memory);
+  }
   free(cpu);
 }
 
@@ -93,121 +170,197 @@ int get_code_index(int pc) {
   return (pc - 4000) / 4;
 }
 
-static void print_instruction(CPU_Stage* stage) {
+static int print_cycle(const APEX_CPU* cpu) {
+  // stage contents are printed every cycle unless the run is quiet
+  return ENABLE_DEBUG_MESSAGES && !cpu->quiet;
+}
+
+/* Bubble added in place of a flushed or stalled instruction */
+static const APEX_Instruction bubble_instruction = {
+  .opcode = OP_NOP,
+  .format = FMT_NONE,
+  // this is because while checking for forwarding we dont look if EX_TWO or MEM_TWO has NOP
+  // we simply compare rd value to know if this register is wat we are looking for
+  // assuming no source register will be negative
+  .rd = -99,
+  .rs1 = -99,
+  .rs2 = -99,
+};
+
+/* Seen by stages once pc runs past the end of code memory */
+static const APEX_Instruction empty_instruction = {
+  .opcode = OP_EMPTY,
+  .format = FMT_NONE,
+};
+
+const APEX_Instruction* get_lane_instruction(APEX_CPU* cpu, int stage_index, int lane) {
+  // Returns instruction held in a lane of latch of stage, latch only keeps its pc
+  if (cpu->bubble & STAGE_BIT(stage_index)) {
+    return &bubble_instruction;
+  }
+  int index = get_code_index(cpu->stage[lane][stage_index].pc);
+  if ((index < 0) || (index >= cpu->code_memory_size)) {
+    // past the end of code memory there are no more instructions
+    return &empty_instruction;
+  }
+  return &cpu->code_memory[index];
+}
+
+const APEX_Instruction* get_stage_instruction(APEX_CPU* cpu, int stage_index) {
+  // Returns oldest instruction of the group held in latch of stage
+  return get_lane_instruction(cpu, stage_index, 0);
+}
+
+int get_group_size(const APEX_CPU* cpu, int stage_index) {
+  // a bubble stands in for the whole group
+  return (cpu->bubble & STAGE_BIT(stage_index)) ? 1 : cpu->group_size[stage_index];
+}
+
+void print_instruction(FILE* out, const APEX_Instruction* ins) {
   // This function prints operands of instructions in stages.
-  if (strcmp(stage->opcode, "STORE") == 0) {
-    printf("%s,R%d,R%d,#%d ", stage->opcode, stage->rd, stage->rs1, stage->imm);
-  }
-  else if (strcmp(stage->opcode, "STR") == 0) {
-    printf("%s,R%d,R%d,R%d ", stage->opcode, stage->rd, stage->rs1, stage->rs2);
-  }
-  else if (strcmp(stage->opcode, "LOAD") == 0) {
-    printf("%s,R%d,R%d,#%d ", stage->opcode, stage->rd, stage->rs1, stage->imm);
-  }
-  else if (strcmp(stage->opcode, "LDR") == 0) {
-    printf("%s,R%d,R%d,R%d ", stage->opcode, stage->rd, stage->rs1, stage->rs2);
-  }
-  else if (strcmp(stage->opcode, "MOVC") == 0) {
-    printf("%s,R%d,#%d ", stage->opcode, stage->rd, stage->imm);
-  }
-  else if (strcmp(stage->opcode, "MOV") == 0) {
-    printf("%s,R%d,R%d ", stage->opcode, stage->rd, stage->rs1);
-  }
-  else if (strcmp(stage->opcode, "ADD") == 0) {
-    printf("%s,R%d,R%d,R%d ", stage->opcode, stage->rd, stage->rs1, stage->rs2);
-  }
-  else if (strcmp(stage->opcode, "ADDL") == 0) {
-    printf("%s,R%d,R%d,#%d ", stage->opcode, stage->rd, stage->rs1, stage->imm);
-  }
-  else if (strcmp(stage->opcode, "SUB") == 0) {
-    printf("%s,R%d,R%d,R%d ", stage->opcode, stage->rd, stage->rs1, stage->rs2);
-  }
-  else if (strcmp(stage->opcode, "SUBL") == 0) {
-    printf("%s,R%d,R%d,#%d ", stage->opcode, stage->rd, stage->rs1, stage->imm);
-  }
-  else if (strcmp(stage->opcode, "MUL") == 0) {
-    printf("%s,R%d,R%d,R%d ", stage->opcode, stage->rd, stage->rs1, stage->rs2);
-  }
-  else if (strcmp(stage->opcode, "DIV") == 0) {
-    printf("%s,R%d,R%d,R%d ", stage->opcode, stage->rd, stage->rs1, stage->rs2);
-  }
-  else if (strcmp(stage->opcode, "AND") == 0) {
-    printf("%s,R%d,R%d,R%d ", stage->opcode, stage->rd, stage->rs1, stage->rs2);
-  }
-  else if (strcmp(stage->opcode, "OR") == 0) {
-    printf("%s,R%d,R%d,R%d ", stage->opcode, stage->rd, stage->rs1, stage->rs2);
-  }
-  else if (strcmp(stage->opcode, "EX-OR") == 0) {
-    printf("%s,R%d,R%d,R%d ", stage->opcode, stage->rd, stage->rs1, stage->rs2);
-  }
-  else if (strcmp(stage->opcode, "BZ") == 0) {
-    printf("%s,#%d ", stage->opcode, stage->imm);
-  }
-  else if (strcmp(stage->opcode, "BNZ") == 0) {
-    printf("%s,#%d ", stage->opcode, stage->imm);
-  }
-  else if (strcmp(stage->opcode, "JUMP") == 0) {
-    printf("%s,R%d,#%d ", stage->opcode, stage->rs1, stage->imm);
-  }
-  else if (strcmp(stage->opcode, "HALT") == 0) {
-    printf("%s ", stage->opcode);
-  }
-  else if (strcmp(stage->opcode, "NOP") == 0) {
-    printf("%s ", stage->opcode);
+  const char* name = get_opcode_name(ins->opcode);
+  switch (ins->format) {
+    case FMT_RD_RS1_IMM:
+      fprintf(out, "%s,R%d,R%d,#%d ", name, ins->rd, ins->rs1, ins->imm);
+      break;
+    case FMT_RD_RS1_RS2:
+      fprintf(out, "%s,R%d,R%d,R%d ", name, ins->rd, ins->rs1, ins->rs2);
+      break;
+    case FMT_RD_IMM:
+      fprintf(out, "%s,R%d,#%d ", name, ins->rd, ins->imm);
+      break;
+    case FMT_RD_RS1:
+      fprintf(out, "%s,R%d,R%d ", name, ins->rd, ins->rs1);
+      break;
+    case FMT_IMM:
+      fprintf(out, "%s,#%d ", name, ins->imm);
+      break;
+    case FMT_RS1_IMM:
+      fprintf(out, "%s,R%d,#%d ", name, ins->rs1, ins->imm);
+      break;
+    default:
+      if (ins->opcode != OP_EMPTY) {
+        fprintf(out, "%s ", name);
+      }
   }
 }
 
-static void print_stage_status(CPU_Stage* stage) {
+static void print_stage_status(APEX_CPU* cpu, int stage_index) {
   // This function prints status of stages.
-  if (stage->empty) {
-    printf(" ---> EMPTY ");
+  if (cpu->empty & STAGE_BIT(stage_index)) {
+    fprintf(cpu->out, " ---> EMPTY ");
+  }
+  else if (cpu->stalled & STAGE_BIT(stage_index)) {
+    fprintf(cpu->out, " ---> STALLED ");
   }
-  else if (stage->stalled) {
-    printf(" ---> STALLED ");
+  else if ((cpu->busy | cpu->waiting) & STAGE_BIT(stage_index)){
+    fprintf(cpu->out, " ---> BUSY ");
   }
-  else if (stage->busy){
-    printf(" ---> BUSY ");
+}
+
+static void print_stage_content(APEX_CPU* cpu, char* name, int stage_index) {
+  // Print function which prints contents of stage, one line per instruction of its group
+  for (int lane = 0; lane < get_group_size(cpu, stage_index); ++lane) {
+    fprintf(cpu->out, "%-15s: %d: pc(%d) ", lane ? "" : name, (cpu->executed >> stage_index) & 1, cpu->stage[lane][stage_index].pc);
+    print_instruction(cpu->out, get_lane_instruction(cpu, stage_index, lane));
+    print_stage_status(cpu, stage_index);
+    fprintf(cpu->out, "\n");
   }
 }
 
-static void print_stage_content(char* name, CPU_Stage* stage) {
-  // Print function which prints contents of stage
-  printf("%-15s: %d: pc(%d) ", name, stage->executed, stage->pc);
-  print_instruction(stage);
-  print_stage_status(stage);
-  printf("\n");
+static void show_stage(APEX_CPU* cpu, char* name, int stage_index) {
+  // Stage as it ran this cycle, printed unless the run is quiet and recorded when tracing
+  if (print_cycle(cpu)) {
+    print_stage_content(cpu, name, stage_index);
+  }
+  if (cpu->trace) {
+    trace_stage(cpu, stage_index);
+  }
 }
 
 void print_cpu_content(APEX_CPU* cpu) {
   // Print function which prints contents of cpu memory
   if (ENABLE_REG_MEM_STATUS_PRINT) {
-    printf("============ STATE OF CPU FLAGS ============\n");
+    fprintf(cpu->out, "============ STATE OF CPU FLAGS ============\n");
     // print all Flags
-    printf("Falgs::  ZeroFlag, CarryFlag, OverflowFlag, InterruptFlag\n");
-    printf("Values:: %d,\t|\t%d,\t|\t%d,\t|\t%d\n", cpu->flags[ZF],cpu->flags[CF],cpu->flags[OF],cpu->flags[IF]);
+    fprintf(cpu->out, "Falgs::  ZeroFlag, CarryFlag, OverflowFlag, InterruptFlag\n");
+    fprintf(cpu->out, "Values:: %d,\t|\t%d,\t|\t%d,\t|\t%d\n", cpu->flags[ZF],cpu->flags[CF],cpu->flags[OF],cpu->flags[IF]);
 
     // print all regs along with valid bits
-    printf("============ STATE OF ARCHITECTURAL REGISTER FILE ============\n");
-    printf("NOTE :: 0 Means Valid & 1 Means Invalid\n");
-    printf("Registers, Values, Invalid\n");
+    fprintf(cpu->out, "============ STATE OF ARCHITECTURAL REGISTER FILE ============\n");
+    fprintf(cpu->out, "NOTE :: 0 Means Valid & 1 Means Invalid\n");
+    fprintf(cpu->out, "Registers, Values, Invalid\n");
     for (int i=0;i<REGISTER_FILE_SIZE;i++) {
-      printf("R%02d,\t|\t%02d,\t|\t%d\n", i, cpu->regs[i], cpu->regs_invalid[i]);
+      fprintf(cpu->out, "R%02d,\t|\t%02d,\t|\t%d\n", i, cpu->regs[i], (cpu->regs_pending >> i) & 1);
     }
 
     // print 100 memory location
-    printf("============ STATE OF DATA MEMORY ============\n");
-    printf("Mem Location, Values\n");
+    fprintf(cpu->out, "============ STATE OF DATA MEMORY ============\n");
+    fprintf(cpu->out, "Mem Location, Values\n");
     for (int i=0;i<100;i++) {
-      printf("M%02d,\t|\t%02d\n", i, cpu->data_memory[i]);
+      fprintf(cpu->out, "M%02d,\t|\t%02d\n", i, cpu->data_memory[i]);
+    }
+    fprintf(cpu->out, "\n");
+  }
+}
+
+static void update_pending(APEX_CPU* cpu) {
+  // Registers with a write in flight, written by a group from Execute One till its Writeback
+  unsigned int pending = 0;
+  for (int i = EX_ONE; i <= WB; ++i) {
+    pending |= cpu->dest_masks[i];
+  }
+  cpu->regs_pending = pending;
+}
+
+static int get_producer_stage(APEX_CPU* cpu, int reg_number, int* lane) {
+  // Youngest stage after Decode/RF whose instruction writes reg_number, -1 if none is in flight,
+  // lane gets the youngest such instruction of its group.
+  // Writeback runs first in a cycle, so a result in WB is already in the register file
+  unsigned int bit = 1u << reg_number;
+  if (!(cpu->regs_pending & bit)) {
+    return -1;
+  }
+  for (int i = EX_ONE; i < WB; ++i) {
+    if (cpu->dest_masks[i] & bit) {
+      // the scoreboard names the stage, only its group is looked through for the lane
+      for (int j = get_group_size(cpu, i) - 1; j >= 0; --j) {
+        if (get_lane_instruction(cpu, i, j)->dest_mask & bit) {
+          *lane = j;
+          return i;
+        }
+      }
     }
-    printf("\n");
   }
+  return -1;
+}
+
+static int is_forwarded(APEX_CPU* cpu, int stage_index, int lane) {
+  // Result of stage is on a bypass path once computed, EX_TWO and MEM_ONE have already run this cycle.
+  // Nothing is computed in EX_ONE, a LOAD, LDR only gets its value in MEM_ONE and a multi-cycle
+  // unit only at ready_cycle
+  int opcode = get_lane_instruction(cpu, stage_index, lane)->opcode;
+  if ((stage_index == EX_ONE) || (cpu->waiting & STAGE_BIT(stage_index)) ||
+      (cpu->stage[lane][stage_index].ready_cycle > cpu->clock)) {
+    return 0;
+  }
+  return (stage_index != EX_TWO) || ((opcode != OP_LOAD) && (opcode != OP_LDR));
 }
 
 static int get_reg_values(APEX_CPU* cpu, CPU_Stage* stage, int src_reg_pos, int src_reg) {
-  // Get Reg values function
+  // Get Reg values function, with forwarding value of youngest producer in flight wins
   int value = 0;
-  if (src_reg_pos == 0) {
+  int lane = 0;
+  if (!is_valid_reg(src_reg)) {
+    // Segmentation fault, reads as 0
+    fprintf(stderr, "Segmentation fault for Register location :: %d\n", src_reg);
+    return value;
+  }
+  int producer = cpu->config.forwarding ? get_producer_stage(cpu, src_reg, &lane) : -1;
+  if (producer >= 0) {
+    value = cpu->stage[lane][producer].rd_value;
+  }
+  else if (src_reg_pos == 0) {
     value = cpu->regs[src_reg];
   }
   else if (src_reg_pos == 1) {
@@ -222,51 +375,32 @@ static int get_reg_values(APEX_CPU* cpu, CPU_Stage* stage, int src_reg_pos, int
   return value;
 }
 
-static int get_reg_status(APEX_CPU* cpu, int reg_number) {
-  // Get Reg Status function
-  int status = 1; // 1 is invalid
-  if (reg_number > REGISTER_FILE_SIZE) {
-    // Segmentation fault
-    fprintf(stderr, "Segmentation fault for Register location :: %d\n", reg_number);
-  }
-  else {
-    status = cpu->regs_invalid[reg_number];
-  }
-  return status;
-}
-
-static void set_reg_status(APEX_CPU* cpu, int reg_number, int status) {
-  // Set Reg Status function
-  // NOTE: insted of set inc or dec regs_invalid
-  if (reg_number > REGISTER_FILE_SIZE) {
-    // Segmentation fault
-    fprintf(stderr, "Segmentation fault for Register location :: %d\n", reg_number);
-  }
-  else {
-    cpu->regs_invalid[reg_number] = cpu->regs_invalid[reg_number] + status;
+static int sources_ready(APEX_CPU* cpu, const APEX_Instruction* ins) {
+  // Scoreboard check, registers read by ins against the writes in flight.
+  // With forwarding a pending register is ready once its youngest producer is on a bypass path
+  // The first register found waiting is recorded as the cause of the stall
+  unsigned int waiting = ins->src_mask & cpu->regs_pending;
+  for (int reg_number = 0; waiting; ++reg_number, waiting >>= 1) {
+    int lane = 0;
+    int producer = ((waiting & 1) && cpu->config.forwarding) ? get_producer_stage(cpu, reg_number, &lane) : -1;
+    if ((waiting & 1) && (!cpu->config.forwarding || !is_forwarded(cpu, producer, lane))) {
+      cpu->counters.stall_cause = reg_number;
+      return 0;
+    }
   }
+  return 1;
 }
 
 static void add_bubble_to_stage(APEX_CPU* cpu, int stage_index, int flushed) {
-  // Add bubble to cpu stage
+  // Add bubble to cpu stage, latch keeps its pc but holds a NOP
    if (flushed){
-       strcpy(cpu->stage[stage_index].opcode, "NOP"); // add a Bubble
-       cpu->code_memory_size = cpu->code_memory_size + 1;
-       cpu->stage[stage_index].empty = 1;
-       // this is because while checking for forwarding we dont look if EX_TWO or MEM_TWO has NOP
-       // we simply compare rd value to know if this register is wat we are looking for
-       // assuming no source register will be negative
-       cpu->stage[stage_index].rd = -99;
+       cpu->bubble |= STAGE_BIT(stage_index); // add a Bubble
+       cpu->empty |= STAGE_BIT(stage_index);
    }
   if ((stage_index > F) && (stage_index < NUM_STAGES) && !(flushed)) {
     // No adding Bubble in Fetch and WB stage
-    if (cpu->stage[stage_index].executed) {
-      strcpy(cpu->stage[stage_index].opcode, "NOP"); // add a Bubble
-      cpu->code_memory_size = cpu->code_memory_size + 1;
-      // this is because while checking for forwarding we dont look if EX_TWO or MEM_TWO has NOP
-      // we simply compare rd value to know if this register is wat we are looking for
-      // assuming no source register will be negative
-      cpu->stage[stage_index].rd = -99;
+    if (cpu->executed & STAGE_BIT(stage_index)) {
+      cpu->bubble |= STAGE_BIT(stage_index); // add a Bubble
     }
     else {
       ; // Nothing let it execute its current instruction
@@ -277,87 +411,229 @@ static void add_bubble_to_stage(APEX_CPU* cpu, int stage_index, int flushed) {
   }
 }
 
+/* Opcodes whose result in EX / MEM stages decides the flags a following BZ, BNZ reads */
+static const char sets_branch_flags[NUM_OPCODES] = {
+  [OP_ADD] = 1,
+  [OP_ADDL] = 1,
+  [OP_SUB] = 1,
+  [OP_SUBL] = 1,
+  [OP_MUL] = 1,
+};
+
+static int get_flags_producer_stage(APEX_CPU* cpu, int first_stage, int* lane) {
+  // Youngest stage from first_stage up to MEM_TWO whose instruction sets zero flag in writeback, -1 if none,
+  // lane gets the youngest such instruction of its group
+  for (int i = first_stage; i < WB; ++i) {
+    for (int j = get_group_size(cpu, i) - 1; (j >= 0) && !(cpu->busy & STAGE_BIT(i)); --j) {
+      int opcode = get_lane_instruction(cpu, i, j)->opcode;
+      if (sets_branch_flags[opcode] || (opcode == OP_DIV)) {
+        *lane = j;
+        return i;
+      }
+    }
+  }
+  return -1;
+}
+
+static int get_zero_flag(APEX_CPU* cpu) {
+  // Zero flag seen by BZ, BNZ in EX_TWO, with forwarding the youngest arithmetic result in the
+  // memory stages decides it the same way its writeback will
+  int lane = 0;
+  int producer = cpu->config.forwarding ? get_flags_producer_stage(cpu, MEM_ONE, &lane) : -1;
+  if (producer >= 0) {
+    const CPU_Stage* stage = &cpu->stage[lane][producer];
+    if (get_lane_instruction(cpu, producer, lane)->opcode == OP_DIV) {
+      return (stage->rs2_value != 0) && (stage->rs1_value % stage->rs2_value != 0);
+    }
+    return (stage->rd_value == 0);
+  }
+  return cpu->flags[ZF];
+}
+
 int previous_arithmetic_check(APEX_CPU* cpu) {
 
   int status = 0;
   int a = 0;
   for (int i=EX_ONE;i<WB; i++) {
-    if (strcmp(cpu->stage[i].opcode, "NOP") != 0) {
+    if (get_stage_instruction(cpu, i)->opcode != OP_NOP) {
       a = i;
       break;
     }
   }
 
   if (a!=0){
-    if ((strcmp(cpu->stage[a].opcode, "ADD") == 0) ||
-      (strcmp(cpu->stage[a].opcode, "ADDL") == 0) ||
-      (strcmp(cpu->stage[a].opcode, "SUB") == 0) ||
-      (strcmp(cpu->stage[a].opcode, "SUBL") == 0) ||
-      (strcmp(cpu->stage[a].opcode, "MUL") == 0) || (strcmp(cpu->stage[EX_ONE].opcode, "DIV") == 0)) {
-
-      status = 1;
+    // any instruction of the group may set the flags
+    for (int j = 0; j < get_group_size(cpu, a); ++j) {
+      if (sets_branch_flags[get_lane_instruction(cpu, a, j)->opcode]) {
+        status = 1;
+      }
+    }
+    for (int j = 0; j < get_group_size(cpu, EX_ONE); ++j) {
+      if (get_lane_instruction(cpu, EX_ONE, j)->opcode == OP_DIV) {
+        status = 1;
+      }
     }
   }
 
   return status;
 }
 
+/*
+ * Every stage has one handler per opcode, the stage function looks up the
+ * handler of the instruction in its latch, so no string compare is done per cycle.
+ * A handler returns the exit code of the stage (only used by writeback).
+ */
+typedef int (*APEX_Stage_Handler)(APEX_CPU* cpu, CPU_Stage* stage, const APEX_Instruction* ins);
+
+static int stage_nothing(APEX_CPU* cpu, CPU_Stage* stage, const APEX_Instruction* ins) {
+  // Nothing for now, instruction just passes through the stage
+  return SUCCESS;
+}
+
+static int stage_held(const APEX_CPU* cpu, int stage_index) {
+  // stage keeps its latch without executing while it or a later stage waits
+  return (cpu->waiting >> stage_index) != 0;
+}
+
+static int stage_latency(APEX_CPU* cpu, int stage_index, const CPU_Stage* stage, int opcode) {
+  // cycles an instruction spends in stage, one unless configured longer, memory accesses go through caches.
+  // Functional units of Execute Two do not hold it, their results are waited for by ready_cycle
+  if ((stage_index == MEM_ONE) &&
+           ((opcode == OP_LOAD) || (opcode == OP_LDR) || (opcode == OP_STORE) || (opcode == OP_STR))) {
+    if (cpu->config.l1d_size && is_valid_mem(stage->mem_address)) {
+      return access_data_cache(cpu, stage->mem_address, (opcode == OP_STORE) || (opcode == OP_STR));
+    }
+    return cpu->config.mem_latency;
+  }
+  return 1;
+}
+
+static void start_wait(APEX_CPU* cpu, int stage_index, int cycles) {
+  // stage and all stages before it hold their latch for cycles more
+  if (cycles > 0) {
+    cpu->waiting |= STAGE_BIT(stage_index);
+    cpu->wait_cycles[stage_index] = cycles;
+  }
+}
+
+static void finish_wait(APEX_CPU* cpu, int stage_index) {
+  // one cycle of waiting done, latch moves on at end of the last one
+  if (--cpu->wait_cycles[stage_index] <= 0) {
+    cpu->waiting &= ~STAGE_BIT(stage_index);
+  }
+}
+
 /*
  * ########################################## Fetch Stage ##########################################
  */
+static void fetch_instruction(APEX_CPU* cpu, CPU_Stage* stage) {
+  // Latch only keeps pc, instruction fields are read from code memory by later stages
+  stage->pc = cpu->pc;
+  cpu->group_size[F] = 1;
+  cpu->bubble &= ~STAGE_BIT(F);
+  cpu->predicted &= ~STAGE_BIT(F);
+}
+
+static int joins_fetch_group(APEX_CPU* cpu, int last_opcode) {
+  // Instruction at pc joins the Fetch group unless the group is full, the last one changes control
+  // flow, code memory ends or, with an instruction cache, it starts a line not looked up this cycle
+  if ((cpu->group_size[F] == cpu->config.width) || (last_opcode == OP_BZ) || (last_opcode == OP_BNZ) ||
+      (last_opcode == OP_JUMP) || (last_opcode == OP_HALT) || (get_code_index(cpu->pc) >= cpu->code_memory_size)) {
+    return 0;
+  }
+  return !cpu->config.l1i_size || (cpu->pc / cpu->config.line_size == cpu->stage[0][F].pc / cpu->config.line_size);
+}
+
+static int fetch_line_ready(APEX_CPU* cpu) {
+  // Returns 1 if line of pc is in the instruction cache, a miss makes Fetch wait for the line
+  int pending = cpu->icache_pending;
+  cpu->icache_pending = 0;
+  if (!cpu->config.l1i_size || (pending == cpu->pc)) {
+    return 1;
+  }
+  int cycles = access_instruction_cache(cpu, cpu->pc);
+  if (cycles > 0) {
+    cpu->icache_pending = cpu->pc;
+    cpu->bubble |= STAGE_BIT(F); // latch holds nothing new, Decode/RF must not take it again
+    start_wait(cpu, F, cycles - 1); // this cycle is the first one lost
+    return 0;
+  }
+  return 1;
+}
+
 int fetch(APEX_CPU* cpu) {
 
-  cpu->stage[F].executed = 0;
-  CPU_Stage* stage = &cpu->stage[F];
+  cpu->executed &= ~STAGE_BIT(F);
+  CPU_Stage* stage = &cpu->stage[0][F];
+  int ex_two_opcode = get_lane_instruction(cpu, EX_TWO, get_group_size(cpu, EX_TWO) - 1)->opcode;
   // dont execute if bz, bnz got SUCCESsfully executed
-  if (((strcmp(cpu->stage[EX_TWO].opcode, "BZ") == 0)||
-      (strcmp(cpu->stage[EX_TWO].opcode, "BNZ") == 0))&&cpu->stage[DRF].empty){
+  if (((ex_two_opcode == OP_BZ)||
+      (ex_two_opcode == OP_BNZ))&&(cpu->empty & STAGE_BIT(DRF))){
     ; // Dont fetch new instruction
   }
-  else if (!stage->busy && !stage->stalled) {
+  else if (cpu->waiting & STAGE_BIT(F)) {
+    // no fetch for branch penalty cycles or while an instruction cache line is on its way
+    finish_wait(cpu, F);
+    if (cpu->icache_pending) {
+      cpu->counters.stall_icache++;
+    }
+    else {
+      cpu->counters.stall_branch++;
+    }
+  }
+  else if (stage_held(cpu, F)) {
+    cpu->counters.stall_structural++; // later stage waits on a multi-cycle operation
+  }
+  else if (!((cpu->busy | cpu->stalled) & STAGE_BIT(F)) && !fetch_line_ready(cpu)) {
+    cpu->counters.stall_icache++; // instruction cache miss, first cycle of waiting for the line
+  }
+  else if (!((cpu->busy | cpu->stalled) & STAGE_BIT(F))) {
     /* Store current PC in fetch latch */
-    stage->pc = cpu->pc;
-
-    /* Index into code memory using this pc and copy all instruction fields into fetch latch */
-    APEX_Instruction* current_ins = &cpu->code_memory[get_code_index(cpu->pc)];
-    strcpy(stage->opcode, current_ins->opcode);
-    stage->rd = current_ins->rd;
-    stage->rs1 = current_ins->rs1;
-    stage->rs2 = current_ins->rs2;
-    stage->imm = current_ins->imm;
-
-    /* Copy data from Fetch latch to Decode latch*/
-    cpu->stage[F].executed = 1;
-    // cpu->stage[DRF] = cpu->stage[F]; // this is cool I should empty the fetch stage as well to avoid repetition ?
-    // cpu->stage[DRF].executed = 0;
-    if (strcmp(cpu->stage[F].opcode, "") == 0) {
+    fetch_instruction(cpu, stage);
+    stage->id = ++cpu->ins_fetched;
+
+    cpu->executed |= STAGE_BIT(F);
+    if (get_stage_instruction(cpu, F)->opcode == OP_EMPTY) {
       // stop fetching Instructions, exit from writeback stage
-      cpu->stage[F].stalled = 0;
-      cpu->stage[F].empty = 1;
+      cpu->stalled &= ~STAGE_BIT(F);
+      cpu->empty |= STAGE_BIT(F);
     }
     else {
-      /* Update PC for next instruction */
-      cpu->pc += 4;
-      cpu->stage[F].empty = 0;
+      /* Update PC for next instruction, predicted taken branches continue at their target */
+      for (;;) {
+        int lane = cpu->group_size[F] - 1;
+        int opcode = get_lane_instruction(cpu, F, lane)->opcode;
+        int target = 0;
+        if (((opcode == OP_BZ) || (opcode == OP_BNZ)) && predict_branch(cpu, cpu->stage[lane][F].pc, &target)) {
+          cpu->pc = target;
+          cpu->predicted |= STAGE_BIT(F);
+          break;
+        }
+        cpu->pc += 4;
+        if (!joins_fetch_group(cpu, opcode)) {
+          break;
+        }
+        cpu->stage[cpu->group_size[F]][F].pc = cpu->pc;
+        cpu->stage[cpu->group_size[F]++][F].id = ++cpu->ins_fetched;
+      }
+      cpu->empty &= ~STAGE_BIT(F);
     }
   }
-  if (cpu->stage[F].stalled) {
+  else if (cpu->flags[IF] && (cpu->stalled & STAGE_BIT(F))) {
+    cpu->counters.stall_halt++; // HALT stopped fetching, older instructions drain
+  }
+  if ((cpu->stalled & STAGE_BIT(F)) && !stage_held(cpu, F)) {
     //If Fetch has HALT and Decode has HALT fetch only one Inst
-    if (strcmp(cpu->stage[DRF].opcode, "HALT") == 0){
-      // just fetch the next instruction
-      stage->pc = cpu->pc;
-      APEX_Instruction* current_ins = &cpu->code_memory[get_code_index(cpu->pc)];
-      strcpy(stage->opcode, current_ins->opcode);
-      stage->rd = current_ins->rd;
-      stage->rs1 = current_ins->rs1;
-      stage->rs2 = current_ins->rs2;
-      stage->imm = current_ins->imm;
+    if (get_lane_instruction(cpu, DRF, get_group_size(cpu, DRF) - 1)->opcode == OP_HALT){
+      // just fetch the next instruction, the same one keeps its id
+      if (stage->pc != cpu->pc) {
+        stage->id = ++cpu->ins_fetched;
+      }
+      fetch_instruction(cpu, stage);
     }
   }
 
-  if (ENABLE_DEBUG_MESSAGES) {
-    print_stage_content("Fetch", stage);
-  }
+  show_stage(cpu, "Fetch", F);
 
   return 0;
 }
@@ -365,238 +641,206 @@ int fetch(APEX_CPU* cpu) {
 /*
  * ########################################## Decode Stage ##########################################
  */
+static void stall_decode(APEX_CPU* cpu) {
+  // keep DF and Fetch Stage in stall while a source register is pending
+  cpu->stalled |= STAGE_BIT(DRF);
+  cpu->stalled |= STAGE_BIT(F);
+}
+
+static int decode_store(APEX_CPU* cpu, CPU_Stage* stage, const APEX_Instruction* ins) {
+  // STORE reads rd as source along with rs1
+  if (sources_ready(cpu, ins)) {
+    // read literal and register values
+    stage->rd_value = get_reg_values(cpu, stage, 0, ins->rd);
+    stage->rs1_value = get_reg_values(cpu, stage, 1, ins->rs1);
+  }
+  else {
+    stall_decode(cpu);
+  }
+  return SUCCESS;
+}
+
+static int decode_str(APEX_CPU* cpu, CPU_Stage* stage, const APEX_Instruction* ins) {
+  // STR reads rd as source along with rs1 and rs2
+  if (sources_ready(cpu, ins)) {
+    stage->rd_value = get_reg_values(cpu, stage, 0, ins->rd);
+    stage->rs1_value = get_reg_values(cpu, stage, 1, ins->rs1); // Here rd becomes src1 and src2, src3 are rs1, rs2
+    stage->rs2_value = get_reg_values(cpu, stage, 2, ins->rs2);
+  }
+  else {
+    stall_decode(cpu);
+  }
+  return SUCCESS;
+}
+
+static int decode_rs1_imm(APEX_CPU* cpu, CPU_Stage* stage, const APEX_Instruction* ins) {
+  // LOAD, ADDL, SUBL read rs1 and a literal
+  if (sources_ready(cpu, ins)) {
+    stage->rs1_value = get_reg_values(cpu, stage, 1, ins->rs1);
+  }
+  else {
+    stall_decode(cpu);
+  }
+  return SUCCESS;
+}
+
+static int decode_rs1_rs2(APEX_CPU* cpu, CPU_Stage* stage, const APEX_Instruction* ins) {
+  // read only values of last two registers
+  if (sources_ready(cpu, ins)) {
+    stage->rs1_value = get_reg_values(cpu, stage, 1, ins->rs1);
+    stage->rs2_value = get_reg_values(cpu, stage, 2, ins->rs2);
+  }
+  else {
+    stall_decode(cpu);
+  }
+  return SUCCESS;
+}
+
+static int decode_movc(APEX_CPU* cpu, CPU_Stage* stage, const APEX_Instruction* ins) {
+  /* No Register file read needed for MOVC, literal is read from code memory in exe stage */
+  return SUCCESS;
+}
+
+static int decode_mov(APEX_CPU* cpu, CPU_Stage* stage, const APEX_Instruction* ins) {
+  // this is MOV one Reg value to another Reg
+  if (sources_ready(cpu, ins)) {
+    stage->rs1_value = get_reg_values(cpu, stage, 1, ins->rs1);
+  }
+  else {
+    stall_decode(cpu);
+  }
+  return SUCCESS;
+}
+
+static int decode_branch(APEX_CPU* cpu, CPU_Stage* stage, const APEX_Instruction* ins) {
+  // BZ, BNZ read literal values, with forwarding flags are on a bypass path once computed in EX_TWO
+  int lane = 0;
+  int producer = cpu->config.forwarding ? get_flags_producer_stage(cpu, EX_ONE, &lane) : -1;
+  if (cpu->config.forwarding ? ((producer == EX_ONE) || ((producer > EX_ONE) && (cpu->stage[lane][producer].ready_cycle > cpu->clock + 2)))
+                             : previous_arithmetic_check(cpu)) {
+    // keep DF and Fetch Stage in stall till flags are computed
+    cpu->counters.stall_cause = STALL_FLAGS;
+    stall_decode(cpu);
+  }
+  return SUCCESS;
+}
+
+static int decode_jump(APEX_CPU* cpu, CPU_Stage* stage, const APEX_Instruction* ins) {
+  // read literal and register values
+  if (sources_ready(cpu, ins)) {
+    stage->rs1_value = get_reg_values(cpu, stage, 1, ins->rs1);
+  }
+  else {
+    stall_decode(cpu);
+  }
+  return SUCCESS;
+}
+
+static int decode_halt(APEX_CPU* cpu, CPU_Stage* stage, const APEX_Instruction* ins) {
+  // Halt causes a type of Intrupt where Fetch is stalled and cpu intrupt Bit is Set
+  // Stop fetching new instruction but allow all the instruction to go from Decode Writeback
+  cpu->stalled |= STAGE_BIT(F); // add NOP from fetch stage
+  cpu->flags[IF] = 1; // Halt as Interrupt
+  return SUCCESS;
+}
+
+static const APEX_Stage_Handler decode_handlers[NUM_OPCODES] = {
+  [OP_STORE] = decode_store,
+  [OP_STR]   = decode_str,
+  [OP_LOAD]  = decode_rs1_imm,
+  [OP_LDR]   = decode_rs1_rs2,
+  [OP_MOVC]  = decode_movc,
+  [OP_MOV]   = decode_mov,
+  [OP_ADD]   = decode_rs1_rs2,
+  [OP_ADDL]  = decode_rs1_imm,
+  [OP_SUB]   = decode_rs1_rs2,
+  [OP_SUBL]  = decode_rs1_imm,
+  [OP_MUL]   = decode_rs1_rs2,
+  [OP_DIV]   = decode_rs1_rs2,
+  [OP_AND]   = decode_rs1_rs2,
+  [OP_OR]    = decode_rs1_rs2,
+  [OP_EXOR]  = decode_rs1_rs2,
+  [OP_BZ]    = decode_branch,
+  [OP_BNZ]   = decode_branch,
+  [OP_JUMP]  = decode_jump,
+  [OP_HALT]  = decode_halt,
+  [OP_NOP]   = stage_nothing,
+  [OP_EMPTY] = stage_nothing,
+};
+
+static int depends_on_group(APEX_CPU* cpu, int lane) {
+  // Instruction in lane of Decode/RF needs a register or the flags from an older instruction of its own group
+  const APEX_Instruction* ins = get_lane_instruction(cpu, DRF, lane);
+  for (int i = 0; i < lane; ++i) {
+    const APEX_Instruction* older = get_lane_instruction(cpu, DRF, i);
+    if (older->dest_mask & ins->src_mask) {
+      return 1;
+    }
+    if (((ins->opcode == OP_BZ) || (ins->opcode == OP_BNZ)) && (sets_branch_flags[older->opcode] || (older->opcode == OP_DIV))) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
 int decode(APEX_CPU* cpu) {
 
-  cpu->stage[DRF].executed = 0;
-  CPU_Stage* stage = &cpu->stage[DRF];
+  cpu->executed &= ~STAGE_BIT(DRF);
   // decode stage only has power to stall itself and Fetch stage
   // unstalling will happen in Mem_two or Writeback stage
-  if (!stage->busy && !stage->stalled) {
-    /* Read data from register file for store */
-    if (strcmp(stage->opcode, "STORE") == 0) {
-
-      if (!get_reg_status(cpu, stage->rd) && !get_reg_status(cpu, stage->rs1)) {
-        // read literal and register values
-        stage->rd_value = get_reg_values(cpu, stage, 0, stage->rd);
-        stage->rs1_value = get_reg_values(cpu, stage, 1, stage->rs1);
-        stage->buffer = stage->imm; // keeping literal value in buffer to calculate mem add in exe stage
-      }
-      else {
-      // keep DF and Fetch Stage in stall if regs_invalid is set
-      cpu->stage[DRF].stalled = 1;
-      cpu->stage[F].stalled = 1;
-      }
-    }
-    else if (strcmp(stage->opcode, "STR") == 0) {
-      // read only values of last two registers
-      if (!get_reg_status(cpu, stage->rd) && !get_reg_status(cpu, stage->rs1) && !get_reg_status(cpu, stage->rs2)) {
-        stage->rd_value = get_reg_values(cpu, stage, 0, stage->rd);
-        stage->rs1_value = get_reg_values(cpu, stage, 1, stage->rs1); // Here rd becomes src1 and src2, src3 are rs1, rs2
-        stage->rs2_value = get_reg_values(cpu, stage, 2, stage->rs2);
-      }
-      else {
-        // keep DF and Fetch Stage in stall if regs_invalid is set
-        cpu->stage[DRF].stalled = 1;
-        cpu->stage[F].stalled = 1;
-      }
-    }
-    else if (strcmp(stage->opcode, "LOAD") == 0) {
-      // read literal and register values
-      if (!get_reg_status(cpu, stage->rs1)) {
-        stage->rs1_value = get_reg_values(cpu, stage, 1, stage->rs1);
-        stage->buffer = stage->imm; // keeping literal value in buffer to calculate mem add in exe stage
-      }
-      else {
-        // keep DF and Fetch Stage in stall if regs_invalid is set
-        cpu->stage[DRF].stalled = 1;
-        cpu->stage[F].stalled = 1;
-      }
-    }
-    else if (strcmp(stage->opcode, "LDR") == 0) {
-      // read only values of last two registers
-      if (!get_reg_status(cpu, stage->rs1) && !get_reg_status(cpu, stage->rs2)) {
-        stage->rs1_value = get_reg_values(cpu, stage, 1, stage->rs1);
-        stage->rs2_value = get_reg_values(cpu, stage, 2, stage->rs2);
-      }
-      else {
-        // keep DF and Fetch Stage in stall if regs_invalid is set
-        cpu->stage[DRF].stalled = 1;
-        cpu->stage[F].stalled = 1;
-      }
-    }
-    /* No Register file read needed for MOVC */
-    else if (strcmp(stage->opcode, "MOVC") == 0) { // this is MOV Constant to Register
-      // read literal values
-      stage->buffer = stage->imm; // keeping literal value in buffer to load in mem stage
-    }
-    else if (strcmp(stage->opcode, "MOV") == 0) { // this is MOV one Reg value to another Reg
-      // read register values
-      if (!get_reg_status(cpu, stage->rs1)) {
-        stage->rs1_value = get_reg_values(cpu, stage, 1, stage->rs1);
-      }
-      else {
-        // keep DF and Fetch Stage in stall if regs_invalid is set
-        cpu->stage[DRF].stalled = 1;
-        cpu->stage[F].stalled = 1;
-      }
-    }
-    else if (strcmp(stage->opcode, "ADD") == 0) {
-      // read only values of last two registers
-      if (!get_reg_status(cpu, stage->rs1) && !get_reg_status(cpu, stage->rs2)) {
-        stage->rs1_value = get_reg_values(cpu, stage, 1, stage->rs1);
-        stage->rs2_value = get_reg_values(cpu, stage, 2, stage->rs2);
-      }
-      else {
-        // keep DF and Fetch Stage in stall if regs_invalid is set
-        cpu->stage[DRF].stalled = 1;
-        cpu->stage[F].stalled = 1;
-      }
-    }
-    else if (strcmp(stage->opcode, "ADDL") == 0) {
-      // read only values of last two registers
-      if (!get_reg_status(cpu, stage->rs1)) {
-        stage->rs1_value = get_reg_values(cpu, stage, 1, stage->rs1);
-        stage->buffer = stage->imm; // keeping literal value in buffer to add in exe stage
-      }
-      else {
-        // keep DF and Fetch Stage in stall if regs_invalid is set
-        cpu->stage[DRF].stalled = 1;
-        cpu->stage[F].stalled = 1;
-      }
-    }
-    else if (strcmp(stage->opcode, "SUB") == 0) {
-      // read only values of last two registers
-      if (!get_reg_status(cpu, stage->rs1) && !get_reg_status(cpu, stage->rs2)) {
-        stage->rs1_value = get_reg_values(cpu, stage, 1, stage->rs1);
-        stage->rs2_value = get_reg_values(cpu, stage, 2, stage->rs2);
-      }
-      else {
-        // keep DF and Fetch Stage in stall if regs_invalid is set
-        cpu->stage[DRF].stalled = 1;
-        cpu->stage[F].stalled = 1;
-      }
-    }
-    else if (strcmp(stage->opcode, "SUBL") == 0) {
-      // read only values of last two registers
-      if (!get_reg_status(cpu, stage->rs1)) {
-        stage->rs1_value = get_reg_values(cpu, stage, 1, stage->rs1);
-        stage->buffer = stage->imm; // keeping literal value in buffer to sub in exe stage
-      }
-      else {
-        // keep DF and Fetch Stage in stall if regs_invalid is set
-        cpu->stage[DRF].stalled = 1;
-        cpu->stage[F].stalled = 1;
-      }
-    }
-    else if (strcmp(stage->opcode, "MUL") == 0) {
-      // read only values of last two registers
-      if (!get_reg_status(cpu, stage->rs1) && !get_reg_status(cpu, stage->rs2)) {
-        stage->rs1_value = get_reg_values(cpu, stage, 1, stage->rs1);
-        stage->rs2_value = get_reg_values(cpu, stage, 2, stage->rs2);
-      }
-      else {
-        // keep DF and Fetch Stage in stall if regs_invalid is set
-        cpu->stage[DRF].stalled = 1;
-        cpu->stage[F].stalled = 1;
-      }
-    }
-    else if (strcmp(stage->opcode, "DIV") == 0) {
-      // read only values of last two registers
-      if (!get_reg_status(cpu, stage->rs1) && !get_reg_status(cpu, stage->rs2)) {
-        stage->rs1_value = get_reg_values(cpu, stage, 1, stage->rs1);
-        stage->rs2_value = get_reg_values(cpu, stage, 2, stage->rs2);
-      }
-      else {
-        // keep DF and Fetch Stage in stall if regs_invalid is set
-        cpu->stage[DRF].stalled = 1;
-        cpu->stage[F].stalled = 1;
-      }
-    }
-    else if (strcmp(stage->opcode, "AND") == 0) {
-      // read only values of last two registers
-      if (!get_reg_status(cpu, stage->rs1) && !get_reg_status(cpu, stage->rs2)) {
-        stage->rs1_value = get_reg_values(cpu, stage, 1, stage->rs1);
-        stage->rs2_value = get_reg_values(cpu, stage, 2, stage->rs2);
-      }
-      else {
-        // keep DF and Fetch Stage in stall if regs_invalid is set
-        cpu->stage[DRF].stalled = 1;
-        cpu->stage[F].stalled = 1;
-      }
-    }
-    else if (strcmp(stage->opcode, "OR") == 0) {
-      // read only values of last two registers
-      if (!get_reg_status(cpu, stage->rs1) && !get_reg_status(cpu, stage->rs2)) {
-        stage->rs1_value = get_reg_values(cpu, stage, 1, stage->rs1);
-        stage->rs2_value = get_reg_values(cpu, stage, 2, stage->rs2);
-      }
-      else {
-        // keep DF and Fetch Stage in stall if regs_invalid is set
-        cpu->stage[DRF].stalled = 1;
-        cpu->stage[F].stalled = 1;
-      }
-    }
-    else if (strcmp(stage->opcode, "EX-OR") == 0) {
-      // read only values of last two registers
-      if (!get_reg_status(cpu, stage->rs1) && !get_reg_status(cpu, stage->rs2)) {
-        stage->rs1_value = get_reg_values(cpu, stage, 1, stage->rs1);
-        stage->rs2_value = get_reg_values(cpu, stage, 2, stage->rs2);
-      }
-      else {
-        // keep DF and Fetch Stage in stall if regs_invalid is set
-        cpu->stage[DRF].stalled = 1;
-        cpu->stage[F].stalled = 1;
-      }
-    }
-    else if (strcmp(stage->opcode, "BZ") == 0) {
-      // read literal values
-      stage->buffer = stage->imm; // keeping literal value in buffer to jump in exe stage
-      if (previous_arithmetic_check(cpu)) {
-        // keep DF and Fetch Stage in stall if regs_invalid is set
-        cpu->stage[DRF].stalled = 1;
-        cpu->stage[F].stalled = 1;
-      }
-    }
-    else if (strcmp(stage->opcode, "BNZ") == 0) {
-      // read literal values
-      stage->buffer = stage->imm; // keeping literal value in buffer to jump in exe stage
-      if (previous_arithmetic_check(cpu)) {
-        // keep DF and Fetch Stage in stall if regs_invalid is set
-        cpu->stage[DRF].stalled = 1;
-        cpu->stage[F].stalled = 1;
-      }
-    }
-    else if (strcmp(stage->opcode, "JUMP") == 0) {
-      // read literal and register values
-      if (!get_reg_status(cpu, stage->rs1) && !get_reg_status(cpu, stage->rs2)) {
-        stage->rs1_value = get_reg_values(cpu, stage, 1, stage->rs1);
-        stage->buffer = stage->imm; // keeping literal value in buffer to cal memory to jump in exe stage
+  if (cpu->group_split || cpu->unit_wait) {
+    // rest of a split group or a group waiting for a functional unit decodes again,
+    // Fetch was only held for a cycle
+    cpu->stalled &= ~(STAGE_BIT(F) | (cpu->unit_wait ? STAGE_BIT(DRF) : 0));
+    cpu->group_split = 0;
+    cpu->unit_wait = 0;
+  }
+  if (cpu->config.forwarding && (cpu->stalled & STAGE_BIT(DRF)) && !stage_held(cpu, DRF)) {
+    // with forwarding a producer reaching a bypass path unstalls, read operands again
+    cpu->stalled &= ~(STAGE_BIT(DRF) | STAGE_BIT(F));
+  }
+  if (!((cpu->busy | cpu->stalled) & STAGE_BIT(DRF)) && !stage_held(cpu, DRF)) {
+    // lanes decode oldest first, the first one that has to wait ends the part of the group moving on
+    int size = get_group_size(cpu, DRF);
+    int lane = 0;
+    while ((lane < size) && !(lane && depends_on_group(cpu, lane))) {
+      const APEX_Instruction* ins = get_lane_instruction(cpu, DRF, lane);
+      if (!unit_available(cpu, lane)) {
+        // structural hazard, all units it needs are busy when it would reach Execute Two
+        cpu->units.stalls[get_unit_kind(ins->opcode)]++;
+        cpu->unit_wait = !lane;
+        if (!lane) {
+          stall_decode(cpu);
+        }
+        break;
       }
-      else {
-        // keep DF and Fetch Stage in stall if regs_invalid is set
-        cpu->stage[DRF].stalled = 1;
-        cpu->stage[F].stalled = 1;
+      decode_handlers[ins->opcode](cpu, &cpu->stage[lane][DRF], ins);
+      if (cpu->stalled & STAGE_BIT(DRF)) {
+        break;
       }
+      lane++;
     }
-    else if (strcmp(stage->opcode, "HALT") == 0) {
-      // Halt causes a type of Intrupt where Fetch is stalled and cpu intrupt Bit is Set
-      // Stop fetching new instruction but allow all the instruction to go from Decode Writeback
-      cpu->stage[F].stalled = 1; // add NOP from fetch stage
-      cpu->flags[IF] = 1; // Halt as Interrupt
-    }
-    else if (strcmp(stage->opcode, "NOP") == 0) {
-      ; // Nothing
+    if ((lane > 0) && (lane < size)) {
+      // older lanes go on to Execute One, the rest stay in Decode/RF with Fetch held behind them
+      cpu->group_split = lane;
+      cpu->stalled &= ~STAGE_BIT(DRF);
+      cpu->stalled |= STAGE_BIT(F);
     }
-    else {
-      if (strcmp(stage->opcode, "") != 0) {
-        fprintf(stderr, "Decode/RF Invalid Instruction Found :: %s\n", stage->opcode);
-      }
+    cpu->executed |= STAGE_BIT(DRF);
+  }
+  if (cpu->unit_wait) {
+    cpu->counters.stall_structural++;
+    if (cpu->trace) {
+      trace_stall(cpu, STALL_STRUCTURAL);
     }
-    cpu->stage[DRF].executed = 1;
   }
-  if (ENABLE_DEBUG_MESSAGES) {
-    print_stage_content("Decode/RF", stage);
+  else if (cpu->stalled & STAGE_BIT(DRF)) {
+    count_data_stall(cpu, 1);
+    if (cpu->trace) {
+      trace_stall(cpu, cpu->counters.stall_cause);
+    }
   }
+  show_stage(cpu, "Decode/RF", DRF);
 
   return 0;
 }
@@ -604,84 +848,48 @@ int decode(APEX_CPU* cpu) {
 /*
  * ########################################## EX One Stage ##########################################
  */
-int execute_one(APEX_CPU* cpu) {
+static int execute_one_dest(APEX_CPU* cpu, CPU_Stage* stage, const APEX_Instruction* ins) {
+  cpu->dest_masks[EX_ONE] |= ins->dest_mask; // make desitination regs invalid so following instructions stall
+  return SUCCESS;
+}
 
-  cpu->stage[EX_ONE].executed = 0;
-  CPU_Stage* stage = &cpu->stage[EX_ONE];
-  if (!stage->busy && !stage->stalled) {
+static const APEX_Stage_Handler execute_one_handlers[NUM_OPCODES] = {
+  [OP_STORE] = stage_nothing, // memory address is created in execute_two
+  [OP_STR]   = stage_nothing,
+  [OP_LOAD]  = execute_one_dest,
+  [OP_LDR]   = execute_one_dest,
+  [OP_MOVC]  = execute_one_dest,
+  [OP_MOV]   = execute_one_dest,
+  [OP_ADD]   = execute_one_dest,
+  [OP_ADDL]  = execute_one_dest,
+  [OP_SUB]   = execute_one_dest,
+  [OP_SUBL]  = execute_one_dest,
+  [OP_MUL]   = execute_one_dest,
+  [OP_DIV]   = execute_one_dest,
+  [OP_AND]   = execute_one_dest,
+  [OP_OR]    = execute_one_dest,
+  [OP_EXOR]  = execute_one_dest,
+  [OP_BZ]    = stage_nothing, // flush all the previous stages and start fetching instruction from mem_address in execute_two
+  [OP_BNZ]   = stage_nothing,
+  [OP_JUMP]  = stage_nothing,
+  [OP_HALT]  = stage_nothing, // treat Halt as an interrupt stoped fetching instructions
+  [OP_NOP]   = stage_nothing, // Do nothing its just a bubble
+  [OP_EMPTY] = stage_nothing,
+};
 
-    /* Store */
-    if (strcmp(stage->opcode, "STORE") == 0) {
-      // create memory address using literal and register values
-      stage->mem_address = stage->rs1_value + stage->buffer;
-    }
-    else if (strcmp(stage->opcode, "STR") == 0) {
-      // create memory address using register values
-      stage->mem_address = stage->rs1_value + stage->rs2_value;
+int execute_one(APEX_CPU* cpu) {
+
+  cpu->executed &= ~STAGE_BIT(EX_ONE);
+  if (!((cpu->busy | cpu->stalled) & STAGE_BIT(EX_ONE)) && !stage_held(cpu, EX_ONE)) {
+    cpu->dest_masks[EX_ONE] = 0;
+    for (int lane = 0; lane < get_group_size(cpu, EX_ONE); ++lane) {
+      const APEX_Instruction* ins = get_lane_instruction(cpu, EX_ONE, lane);
+      execute_one_handlers[ins->opcode](cpu, &cpu->stage[lane][EX_ONE], ins);
     }
-    else if (strcmp(stage->opcode, "LOAD") == 0) {
-      set_reg_status(cpu, stage->rd, 1); // make desitination regs invalid so following instructions stall
-    }
-    else if (strcmp(stage->opcode, "LDR") == 0) {
-      set_reg_status(cpu, stage->rd, 1); // make desitination regs invalid so following instructions stall
-    }
-    /* MOVC */
-    else if (strcmp(stage->opcode, "MOVC") == 0) {
-      set_reg_status(cpu, stage->rd, 1); // make desitination regs invalid so following instructions stall
-    }
-    else if (strcmp(stage->opcode, "MOV") == 0) {
-      set_reg_status(cpu, stage->rd, 1); // make desitination regs invalid so following instructions stall
-    }
-    else if (strcmp(stage->opcode, "ADD") == 0) {
-      set_reg_status(cpu, stage->rd, 1); // make desitination regs invalid so following instructions stall
-    }
-    else if (strcmp(stage->opcode, "ADDL") == 0) {
-      set_reg_status(cpu, stage->rd, 1); // make desitination regs invalid so following instructions stall
-    }
-    else if (strcmp(stage->opcode, "SUB") == 0) {
-      set_reg_status(cpu, stage->rd, 1); // make desitination regs invalid so following instructions stall
-    }
-    else if (strcmp(stage->opcode, "SUBL") == 0) {
-      set_reg_status(cpu, stage->rd, 1); // make desitination regs invalid so following instructions stall
-    }
-    else if (strcmp(stage->opcode, "MUL") == 0) {
-      set_reg_status(cpu, stage->rd, 1); // make desitination regs invalid so following instructions stall
-    }
-    else if (strcmp(stage->opcode, "DIV") == 0) {
-      set_reg_status(cpu, stage->rd, 1); // make desitination regs invalid so following instructions stall
-    }
-    else if (strcmp(stage->opcode, "AND") == 0) {
-      set_reg_status(cpu, stage->rd, 1); // make desitination regs invalid so following instructions stall
-    }
-    else if (strcmp(stage->opcode, "OR") == 0) {
-      set_reg_status(cpu, stage->rd, 1); // make desitination regs invalid so following instructions stall
-    }
-    else if (strcmp(stage->opcode, "EX-OR") == 0) {
-      set_reg_status(cpu, stage->rd, 1); // make desitination regs invalid so following instructions stall
-    }
-    else if (strcmp(stage->opcode, "BZ") == 0) {
-      ; // flush all the previous stages and start fetching instruction from mem_address in execute_two
-    }
-    else if (strcmp(stage->opcode, "BNZ") == 0) {
-      ; // flush all the previous stages and start fetching instruction from mem_address in execute_two
-    }
-    else if (strcmp(stage->opcode, "JUMP") == 0) {
-      ; // flush all the previous stages and start fetching instruction from mem_address in execute_two
-    }
-    else if (strcmp(stage->opcode, "HALT") == 0) {
-      ; // treat Halt as an interrupt stoped fetching instructions
-    }
-    else if (strcmp(stage->opcode, "NOP") == 0) {
-      ; // Do nothing its just a bubble
-    }
-    else {
-      ; // Do nothing
-    }
-    cpu->stage[EX_ONE].executed = 1;
-  }
-  if (ENABLE_DEBUG_MESSAGES) {
-    print_stage_content("Execute One", stage);
+    update_pending(cpu);
+    cpu->executed |= STAGE_BIT(EX_ONE);
   }
+  show_stage(cpu, "Execute One", EX_ONE);
 
   return 0;
 }
@@ -689,184 +897,213 @@ int execute_one(APEX_CPU* cpu) {
 /*
  * ########################################## EX Two Stage ##########################################
  */
-int execute_two(APEX_CPU* cpu) {
+static int execute_two_mem_imm(APEX_CPU* cpu, CPU_Stage* stage, const APEX_Instruction* ins) {
+  // STORE, LOAD create memory address using literal and register values
+  stage->mem_address = stage->rs1_value + ins->imm;
+  return SUCCESS;
+}
 
-  cpu->stage[EX_TWO].executed = 0;
-  CPU_Stage* stage = &cpu->stage[EX_TWO];
-  if (!stage->busy && !stage->stalled) {
+static int execute_two_mem_reg(APEX_CPU* cpu, CPU_Stage* stage, const APEX_Instruction* ins) {
+  // STR, LDR create memory address using register values
+  stage->mem_address = stage->rs1_value + stage->rs2_value;
+  return SUCCESS;
+}
 
-    /* Store */
-    if (strcmp(stage->opcode, "STORE") == 0) {
-      // create memory address using literal and register values
-      stage->mem_address = stage->rs1_value + stage->buffer;
-    }
-    else if (strcmp(stage->opcode, "STR") == 0) {
-      // create memory address using register values
-      stage->mem_address = stage->rs1_value + stage->rs2_value;
-    }
-    else if (strcmp(stage->opcode, "LOAD") == 0) {
-      // create memory address using literal and register values
-      stage->mem_address = stage->rs1_value + stage->buffer;
-    }
-    else if (strcmp(stage->opcode, "LDR") == 0) {
-      // create memory address using register values
-      stage->mem_address = stage->rs1_value + stage->rs2_value;
-    }
-    /* MOVC */
-    else if (strcmp(stage->opcode, "MOVC") == 0) {
-      stage->rd_value = stage->buffer; // move buffer value to rd_value so it can be forwarded
-    }
-    else if (strcmp(stage->opcode, "MOV") == 0) {
-      stage->rd_value = stage->rs1_value; // move rs1_value value to rd_value so it can be forwarded
-    }
-    else if (strcmp(stage->opcode, "ADD") == 0) {
-      // add registers value and keep in rd_value for mem / writeback stage
-      if ((stage->rs2_value > 0 && stage->rs1_value > INT_MAX - stage->rs2_value) ||
-        (stage->rs2_value < 0 && stage->rs1_value < INT_MIN - stage->rs2_value)) {
-        cpu->flags[OF] = 1; // there is an overflow
-      }
-      else {
-        stage->rd_value = stage->rs1_value + stage->rs2_value;
-        cpu->flags[OF] = 0; // there is no overflow
-      }
-    }
-    else if (strcmp(stage->opcode, "ADDL") == 0) {
-      // add literal and register value and keep in rd_value for mem / writeback stage
-      if ((stage->buffer > 0 && stage->rs1_value > INT_MAX - stage->buffer) ||
-        (stage->buffer < 0 && stage->rs1_value < INT_MIN - stage->buffer)) {
-        cpu->flags[OF] = 1; // there is an overflow
-      }
-      else {
-        stage->rd_value = stage->rs1_value + stage->buffer;
-        cpu->flags[OF] = 0; // there is no overflow
-      }
-    }
-    else if (strcmp(stage->opcode, "SUB") == 0) {
-      // sub registers value and keep in rd_value for mem / writeback stage
-      if (stage->rs2_value > stage->rs1_value) {
-        stage->rd_value = stage->rs1_value - stage->rs2_value;
-        cpu->flags[CF] = 1; // there is an carry
-      }
-      else {
-        stage->rd_value = stage->rs1_value - stage->rs2_value;
-        cpu->flags[CF] = 0; // there is no carry
-      }
-    }
-    else if (strcmp(stage->opcode, "SUBL") == 0) {
-      // sub literal and register value and keep in rd_value for mem / writeback stage
-      if (stage->buffer > stage->rs1_value) {
-        stage->rd_value = stage->rs1_value - stage->buffer;
-        cpu->flags[CF] = 1; // there is an carry
-      }
-      else {
-        stage->rd_value = stage->rs1_value - stage->buffer;
-        cpu->flags[CF] = 0; // there is no carry
-      }
-    }
-    else if (strcmp(stage->opcode, "MUL") == 0) {
-      // mul registers value and keep in rd_value for mem / writeback stage
-      stage->rd_value = stage->rs1_value * stage->rs2_value;
-    }
-    else if (strcmp(stage->opcode, "DIV") == 0) {
-      // div registers value and keep in rd_value for mem / writeback stage
-      if (stage->rs2_value != 0) {
-        stage->rd_value = stage->rs1_value / stage->rs2_value;
-      }
-      else {
-        fprintf(stderr, "Division By Zero Returning Value Zero\n");
-        stage->rd_value = 0;
-      }
-    }
-    else if (strcmp(stage->opcode, "AND") == 0) {
-      // mul registers value and keep in rd_value for mem / writeback stage
-      stage->rd_value = stage->rs1_value & stage->rs2_value;
-    }
-    else if (strcmp(stage->opcode, "OR") == 0) {
-      // or registers value and keep in rd_value for mem / writeback stage
-      stage->rd_value = stage->rs1_value | stage->rs2_value;
-    }
-    else if (strcmp(stage->opcode, "EX-OR") == 0) {
-      // ex-or registers value and keep in rd_value for mem / writeback stage
-      stage->rd_value = stage->rs1_value ^ stage->rs2_value;
-    }
-    else if (strcmp(stage->opcode, "BZ") == 0) {
-      // load buffer value to mem_address
-      stage->mem_address = stage->buffer;
-      if (cpu->flags[ZF]) {
-        // check address validity, pc-add % 4 should be 0
-        if (((stage->pc + stage->mem_address)%4 == 0)&&!((stage->pc + stage->mem_address) < 4000)) {
-          // reset status of rd in exe_one stage
-          set_reg_status(cpu, cpu->stage[EX_ONE].rd, 0); // make desitination regs valid so following instructions won't stall
-          // flush previous instructions add NOP
-          add_bubble_to_stage(cpu, EX_ONE, 1); // next cycle Bubble will be executed
-          add_bubble_to_stage(cpu, DRF, 1); // next cycle Bubble will be executed
-          add_bubble_to_stage(cpu, F, 1); // next cycle Bubble will be executed
-          // change pc value
-          cpu->pc = stage->pc + stage->mem_address;
-          // un stall Fetch and Decode stage if they are stalled
-          cpu->stage[DRF].stalled = 0;
-          cpu->stage[F].stalled = 0;
-        }
-        else {
-          fprintf(stderr, "Invalid Branch Loction for %s\n", stage->opcode);
-          fprintf(stderr, "Instruction %s Relative Address %d\n", stage->opcode, cpu->pc + stage->mem_address);
-        }
-      }
-    }
-    else if (strcmp(stage->opcode, "BNZ") == 0) {
-      // load buffer value to mem_address
-      stage->mem_address = stage->buffer;
-      if (!cpu->flags[ZF]) {
-        // check address validity, pc-add % 4 should be 0
-        if (((stage->pc + stage->mem_address)%4 == 0)&&!((stage->pc + stage->mem_address) < 4000)) {
-          // reset status of rd in exe_one stage
-          set_reg_status(cpu, cpu->stage[EX_ONE].rd, 0); // make desitination regs valid so following instructions won't stall
-          // flush previous instructions add NOP
-          add_bubble_to_stage(cpu, EX_ONE, 1); // next cycle Bubble will be executed
-          add_bubble_to_stage(cpu, DRF, 1); // next cycle Bubble will be executed
-          add_bubble_to_stage(cpu, F, 1); // next cycle Bubble will be executed
-          // change pc value
-          cpu->pc = stage->pc + stage->mem_address;
-          // un stall Fetch and Decode stage if they are stalled
-          cpu->stage[DRF].stalled = 0;
-          cpu->stage[F].stalled = 0;
-        }
-        else {
-          fprintf(stderr, "Invalid Branch Loction for %s\n", stage->opcode);
-          fprintf(stderr, "Instruction %s Relative Address %d\n", stage->opcode, cpu->pc + stage->mem_address);
-        }
-      }
-    }
-    else if (strcmp(stage->opcode, "JUMP") == 0) {
-      // load buffer value to mem_address
-      stage->mem_address = stage->rs1_value + stage->buffer;
-      // check address validity, pc-add % 4 should be 0
-      if (((stage->pc + stage->mem_address)%4 == 0)&&!((stage->pc + stage->mem_address) < 4000)) {
-        // change pc value
-        cpu->pc = stage->mem_address;
-        // un stall Fetch and Decode stage if they are stalled
-        cpu->stage[DRF].stalled = 0;
-        cpu->stage[F].stalled = 0;
-      }
-      else {
-        fprintf(stderr, "Invalid Branch Loction for %s\n", stage->opcode);
-        fprintf(stderr, "Instruction %s Relative Address %d\n", stage->opcode, cpu->pc + stage->mem_address);
-      }
-    }
-    else if (strcmp(stage->opcode, "HALT") == 0) {
-      ; // treat Halt as an interrupt stoped fetching instructions
-    }
-    else if (strcmp(stage->opcode, "NOP") == 0) {
-      ; // Do nothing its just a bubble
-    }
-    else {
-      ; // Do nothing
-    }
-    cpu->stage[EX_TWO].executed = 1;
+static int execute_two_movc(APEX_CPU* cpu, CPU_Stage* stage, const APEX_Instruction* ins) {
+  stage->rd_value = ins->imm; // move literal value to rd_value so it can be forwarded
+  return SUCCESS;
+}
+
+static int execute_two_mov(APEX_CPU* cpu, CPU_Stage* stage, const APEX_Instruction* ins) {
+  stage->rd_value = stage->rs1_value; // move rs1_value value to rd_value so it can be forwarded
+  return SUCCESS;
+}
+
+static int execute_two_add(APEX_CPU* cpu, CPU_Stage* stage, const APEX_Instruction* ins) {
+  // add registers value and keep in rd_value for mem / writeback stage
+  if ((stage->rs2_value > 0 && stage->rs1_value > INT_MAX - stage->rs2_value) ||
+    (stage->rs2_value < 0 && stage->rs1_value < INT_MIN - stage->rs2_value)) {
+    cpu->flags[OF] = 1; // there is an overflow
   }
-  if (ENABLE_DEBUG_MESSAGES) {
-    print_stage_content("Execute Two", stage);
+  else {
+    stage->rd_value = stage->rs1_value + stage->rs2_value;
+    cpu->flags[OF] = 0; // there is no overflow
   }
+  return SUCCESS;
+}
+
+static int execute_two_addl(APEX_CPU* cpu, CPU_Stage* stage, const APEX_Instruction* ins) {
+  // add literal and register value and keep in rd_value for mem / writeback stage
+  if ((ins->imm > 0 && stage->rs1_value > INT_MAX - ins->imm) ||
+    (ins->imm < 0 && stage->rs1_value < INT_MIN - ins->imm)) {
+    cpu->flags[OF] = 1; // there is an overflow
+  }
+  else {
+    stage->rd_value = stage->rs1_value + ins->imm;
+    cpu->flags[OF] = 0; // there is no overflow
+  }
+  return SUCCESS;
+}
+
+static int execute_two_sub(APEX_CPU* cpu, CPU_Stage* stage, const APEX_Instruction* ins) {
+  // sub registers value and keep in rd_value for mem / writeback stage
+  stage->rd_value = stage->rs1_value - stage->rs2_value;
+  cpu->flags[CF] = (stage->rs2_value > stage->rs1_value); // there is a carry if rs2 is bigger
+  return SUCCESS;
+}
+
+static int execute_two_subl(APEX_CPU* cpu, CPU_Stage* stage, const APEX_Instruction* ins) {
+  // sub literal and register value and keep in rd_value for mem / writeback stage
+  stage->rd_value = stage->rs1_value - ins->imm;
+  cpu->flags[CF] = (ins->imm > stage->rs1_value); // there is a carry if literal is bigger
+  return SUCCESS;
+}
+
+static int execute_two_mul(APEX_CPU* cpu, CPU_Stage* stage, const APEX_Instruction* ins) {
+  // mul registers value and keep in rd_value for mem / writeback stage
+  stage->rd_value = stage->rs1_value * stage->rs2_value;
+  return SUCCESS;
+}
+
+static int execute_two_div(APEX_CPU* cpu, CPU_Stage* stage, const APEX_Instruction* ins) {
+  // div registers value and keep in rd_value for mem / writeback stage
+  if (stage->rs2_value != 0) {
+    stage->rd_value = stage->rs1_value / stage->rs2_value;
+  }
+  else {
+    fprintf(stderr, "Division By Zero Returning Value Zero\n");
+    stage->rd_value = 0;
+  }
+  return SUCCESS;
+}
+
+static int execute_two_and(APEX_CPU* cpu, CPU_Stage* stage, const APEX_Instruction* ins) {
+  // and registers value and keep in rd_value for mem / writeback stage
+  stage->rd_value = stage->rs1_value & stage->rs2_value;
+  return SUCCESS;
+}
+
+static int execute_two_or(APEX_CPU* cpu, CPU_Stage* stage, const APEX_Instruction* ins) {
+  // or registers value and keep in rd_value for mem / writeback stage
+  stage->rd_value = stage->rs1_value | stage->rs2_value;
+  return SUCCESS;
+}
+
+static int execute_two_exor(APEX_CPU* cpu, CPU_Stage* stage, const APEX_Instruction* ins) {
+  // ex-or registers value and keep in rd_value for mem / writeback stage
+  stage->rd_value = stage->rs1_value ^ stage->rs2_value;
+  return SUCCESS;
+}
+
+static void flush_fetch_path(APEX_CPU* cpu, int target) {
+  // Instructions in F, DRF and EX_ONE were fetched down the wrong path, fetch restarts at target
+  int lost = 0;
+  for (int i = F; i <= EX_ONE; ++i) {
+    for (int lane = 0; lane < get_group_size(cpu, i); ++lane) {
+      int opcode = get_lane_instruction(cpu, i, lane)->opcode;
+      lost += (opcode != OP_NOP) && (opcode != OP_EMPTY); // instructions lost to the flush
+    }
+  }
+  cpu->counters.squashed += lost;
+  cpu->counters.flushes++;
+  if (cpu->trace) {
+    trace_flush(cpu, target, lost);
+  }
+  cpu->waiting &= ~STAGE_BIT(F); // a line fetched for the wrong path is not waited for
+  cpu->icache_pending = 0;
+  start_wait(cpu, F, cpu->config.branch_penalty);
+  // flush previous instructions add NOP
+  add_bubble_to_stage(cpu, EX_ONE, 1); // next cycle Bubble will be executed
+  add_bubble_to_stage(cpu, DRF, 1); // next cycle Bubble will be executed
+  add_bubble_to_stage(cpu, F, 1); // next cycle Bubble will be executed
+  cpu->flags[IF] = 0; // a HALT fetched after the branch is flushed too
+  // change pc value
+  cpu->pc = target;
+  // un stall Fetch and Decode stage if they are stalled
+  cpu->stalled &= ~STAGE_BIT(DRF);
+  cpu->stalled &= ~STAGE_BIT(F);
+}
+
+static void resolve_branch(APEX_CPU* cpu, CPU_Stage* stage, const APEX_Instruction* ins, int taken) {
+  // load literal value to mem_address, flush if Fetch went down the other path
+  stage->mem_address = ins->imm;
+  int target = stage->pc + stage->mem_address;
+  if (taken && !is_valid_branch(stage->pc, stage->mem_address)) {
+    fprintf(stderr, "Invalid Branch Loction for %s\n", get_opcode_name(ins->opcode));
+    fprintf(stderr, "Instruction %s Relative Address %d\n", get_opcode_name(ins->opcode), cpu->pc + stage->mem_address);
+    taken = 0;
+  }
+  int predicted = (cpu->predicted & STAGE_BIT(EX_TWO)) != 0;
+  cpu->predictor.branches++;
+  if (taken != predicted) {
+    cpu->predictor.mispredictions++;
+    flush_fetch_path(cpu, taken ? target : stage->pc + 4);
+  }
+  train_predictor(cpu, stage->pc, taken, target);
+}
+
+static int execute_two_bz(APEX_CPU* cpu, CPU_Stage* stage, const APEX_Instruction* ins) {
+  resolve_branch(cpu, stage, ins, get_zero_flag(cpu));
+  return SUCCESS;
+}
+
+static int execute_two_bnz(APEX_CPU* cpu, CPU_Stage* stage, const APEX_Instruction* ins) {
+  resolve_branch(cpu, stage, ins, !get_zero_flag(cpu));
+  return SUCCESS;
+}
+
+static int execute_two_jump(APEX_CPU* cpu, CPU_Stage* stage, const APEX_Instruction* ins) {
+  // load literal value to mem_address
+  stage->mem_address = stage->rs1_value + ins->imm;
+  if (is_valid_branch(stage->pc, stage->mem_address)) {
+    // Fetch went on past the JUMP, those instructions are flushed like after a taken branch
+    flush_fetch_path(cpu, stage->mem_address);
+  }
+  else {
+    fprintf(stderr, "Invalid Branch Loction for %s\n", get_opcode_name(ins->opcode));
+    fprintf(stderr, "Instruction %s Relative Address %d\n", get_opcode_name(ins->opcode), cpu->pc + stage->mem_address);
+  }
+  return SUCCESS;
+}
+
+static const APEX_Stage_Handler execute_two_handlers[NUM_OPCODES] = {
+  [OP_STORE] = execute_two_mem_imm,
+  [OP_STR]   = execute_two_mem_reg,
+  [OP_LOAD]  = execute_two_mem_imm,
+  [OP_LDR]   = execute_two_mem_reg,
+  [OP_MOVC]  = execute_two_movc,
+  [OP_MOV]   = execute_two_mov,
+  [OP_ADD]   = execute_two_add,
+  [OP_ADDL]  = execute_two_addl,
+  [OP_SUB]   = execute_two_sub,
+  [OP_SUBL]  = execute_two_subl,
+  [OP_MUL]   = execute_two_mul,
+  [OP_DIV]   = execute_two_div,
+  [OP_AND]   = execute_two_and,
+  [OP_OR]    = execute_two_or,
+  [OP_EXOR]  = execute_two_exor,
+  [OP_BZ]    = execute_two_bz,
+  [OP_BNZ]   = execute_two_bnz,
+  [OP_JUMP]  = execute_two_jump,
+  [OP_HALT]  = stage_nothing, // treat Halt as an interrupt stoped fetching instructions
+  [OP_NOP]   = stage_nothing, // Do nothing its just a bubble
+  [OP_EMPTY] = stage_nothing,
+};
+
+int execute_two(APEX_CPU* cpu) {
+
+  cpu->executed &= ~STAGE_BIT(EX_TWO);
+  if (!((cpu->busy | cpu->stalled) & STAGE_BIT(EX_TWO)) && !stage_held(cpu, EX_TWO)) {
+    // every lane starts on its functional unit, a multi-cycle result is done while the group moves on
+    for (int lane = 0; lane < get_group_size(cpu, EX_TWO); ++lane) {
+      CPU_Stage* stage = &cpu->stage[lane][EX_TWO];
+      const APEX_Instruction* ins = get_lane_instruction(cpu, EX_TWO, lane);
+      execute_two_handlers[ins->opcode](cpu, stage, ins);
+      stage->ready_cycle = cpu->clock + start_unit(cpu, ins->opcode) - 1;
+    }
+    cpu->executed |= STAGE_BIT(EX_TWO);
+  }
+  show_stage(cpu, "Execute Two", EX_TWO);
 
   return 0;
 }
@@ -874,121 +1111,92 @@ int execute_two(APEX_CPU* cpu) {
 /*
  * ########################################## Mem One Stage ##########################################
  */
-int memory_one(APEX_CPU* cpu) {
-
-  cpu->stage[MEM_ONE].executed = 0;
-  CPU_Stage* stage = &cpu->stage[MEM_ONE];
-  if (!stage->busy && !stage->stalled) {
+static int in_stage(const APEX_CPU* cpu, const CPU_Stage* stage, int stage_index) {
+  // stage is one of the lanes of latch of stage_index, latches of a lane follow each other
+  long offset = stage - &cpu->stage[0][0];
+  return (offset >= 0) && (offset < NUM_STAGES * MAX_ISSUE_WIDTH) && (offset % NUM_STAGES == stage_index);
+}
 
-    /* Store */
-    if (strcmp(stage->opcode, "STORE") == 0) {
-      // use memory address and write value in data_memory
-      if (stage->mem_address > DATA_MEMORY_SIZE) {
-        // Segmentation fault
-        fprintf(stderr, "Segmentation fault for writing memory location :: %d\n", stage->mem_address);
-      }
-      else {
-        cpu->data_memory[stage->mem_address] = stage->rd_value;
-      }
-    }
-    else if (strcmp(stage->opcode, "STR") == 0) {
-      // use memory address and write value in data_memory
-      if (stage->mem_address > DATA_MEMORY_SIZE) {
-        // Segmentation fault
-        fprintf(stderr, "Segmentation fault for writing memory location :: %d\n", stage->mem_address);
-      }
-      else {
-        cpu->data_memory[stage->mem_address] = stage->rd_value;
-      }
-    }
-    else if (strcmp(stage->opcode, "LOAD") == 0) {
-      // use memory address and write value in data_memory
-      if (stage->mem_address > DATA_MEMORY_SIZE) {
-        // Segmentation fault
-        fprintf(stderr, "Segmentation fault for accessing memory location :: %d\n", stage->mem_address);
-      }
-      else {
-        stage->rd_value = cpu->data_memory[stage->mem_address];
-      }
-    }
-    else if (strcmp(stage->opcode, "LDR") == 0) {
-      // use memory address and write value in data_memory
-      if (stage->mem_address > DATA_MEMORY_SIZE) {
-        // Segmentation fault
-        fprintf(stderr, "Segmentation fault for accessing memory location :: %d\n", stage->mem_address);
-      }
-      else {
-        stage->rd_value = cpu->data_memory[stage->mem_address];
-      }
-    }
-    /* MOVC */
-    else if (strcmp(stage->opcode, "MOVC") == 0) {
-      // can flags be used to make better decision
-      ; // Nothing for now do operation in writeback stage
-    }
-    else if (strcmp(stage->opcode, "MOV") == 0) {
-      // can flags be used to make better decision
-      ; // Nothing for now do operation in writeback stage
-    }
-    else if (strcmp(stage->opcode, "ADD") == 0) {
-      // can flags be used to make better decision
-      ; // Nothing for now holding rd_value from exe stage
-    }
-    else if (strcmp(stage->opcode, "ADDL") == 0) {
-      // can flags be used to make better decision
-      ; // Nothing for now holding rd_value from exe stage
-    }
-    else if (strcmp(stage->opcode, "SUB") == 0) {
-      // can flags be used to make better decision
-      ; // Nothing for now holding rd_value from exe stage
-    }
-    else if (strcmp(stage->opcode, "SUBL") == 0) {
-      // can flags be used to make better decision
-      ; // Nothing for now holding rd_value from exe stage
-    }
-    else if (strcmp(stage->opcode, "MUL") == 0) {
-      // can flags be used to make better decision
-      ; // Nothing for now holding rd_value from exe stage
-    }
-    else if (strcmp(stage->opcode, "DIV") == 0) {
-      // can flags be used to make better decision
-      ; // Nothing for now holding rd_value from exe stage
-    }
-    else if (strcmp(stage->opcode, "AND") == 0) {
-      // can flags be used to make better decision
-      ; // Nothing for now holding rd_value from exe stage
-    }
-    else if (strcmp(stage->opcode, "OR") == 0) {
-      // can flags be used to make better decision
-      ; // Nothing for now holding rd_value from exe stage
-    }
-    else if (strcmp(stage->opcode, "EX-OR") == 0) {
-      // can flags be used to make better decision
-      ; // Nothing for now holding rd_value from exe stage
-    }
-    else if (strcmp(stage->opcode, "BZ") == 0) {
-      ; // Nothing for now
-    }
-    else if (strcmp(stage->opcode, "BNZ") == 0) {
-      ; // Nothing for now
-    }
-    else if (strcmp(stage->opcode, "JUMP") == 0) {
-      ; // Nothing for now
-    }
-    else if (strcmp(stage->opcode, "HALT") == 0) {
-      ; // Nothing for now
+static int memory_write(APEX_CPU* cpu, CPU_Stage* stage, const APEX_Instruction* ins) {
+  // STORE, STR use memory address and write value in data_memory
+  if (!is_valid_mem(stage->mem_address)) {
+    // Segmentation fault
+    fprintf(stderr, "Segmentation fault for writing memory location :: %d\n", stage->mem_address);
+  }
+  else {
+    cpu->data_memory[stage->mem_address] = stage->rd_value;
+    if (in_stage(cpu, stage, MEM_ONE)) {
+      cpu->counters.stores++; // counted once, both memory stages perform the access
     }
-    else if (strcmp(stage->opcode, "NOP") == 0) {
-      ; // Nothing for now
+    if (cpu->memory_access) {
+      cpu->memory_access[stage->mem_address] |= MEMORY_WRITTEN;
     }
-    else {
-      ; // Nothing
+  }
+  return SUCCESS;
+}
+
+static int memory_read(APEX_CPU* cpu, CPU_Stage* stage, const APEX_Instruction* ins) {
+  // LOAD, LDR use memory address and read value from data_memory
+  if (!is_valid_mem(stage->mem_address)) {
+    // Segmentation fault
+    fprintf(stderr, "Segmentation fault for accessing memory location :: %d\n", stage->mem_address);
+  }
+  else if (in_stage(cpu, stage, MEM_ONE)) {
+    // value read in Memory One stays, a younger store of the group may write the location before Memory Two
+    stage->rd_value = cpu->data_memory[stage->mem_address];
+    cpu->counters.loads++;
+    if (cpu->memory_access) {
+      cpu->memory_access[stage->mem_address] |= MEMORY_READ;
     }
-    cpu->stage[MEM_ONE].executed = 1;
   }
-  if (ENABLE_DEBUG_MESSAGES) {
-    print_stage_content("Memory One", stage);
+  return SUCCESS;
+}
+
+/* Both memory stages access data_memory, others hold rd_value from exe stage */
+static const APEX_Stage_Handler memory_handlers[NUM_OPCODES] = {
+  [OP_STORE] = memory_write,
+  [OP_STR]   = memory_write,
+  [OP_LOAD]  = memory_read,
+  [OP_LDR]   = memory_read,
+  [OP_MOVC]  = stage_nothing,
+  [OP_MOV]   = stage_nothing,
+  [OP_ADD]   = stage_nothing,
+  [OP_ADDL]  = stage_nothing,
+  [OP_SUB]   = stage_nothing,
+  [OP_SUBL]  = stage_nothing,
+  [OP_MUL]   = stage_nothing,
+  [OP_DIV]   = stage_nothing,
+  [OP_AND]   = stage_nothing,
+  [OP_OR]    = stage_nothing,
+  [OP_EXOR]  = stage_nothing,
+  [OP_BZ]    = stage_nothing,
+  [OP_BNZ]   = stage_nothing,
+  [OP_JUMP]  = stage_nothing,
+  [OP_HALT]  = stage_nothing,
+  [OP_NOP]   = stage_nothing,
+  [OP_EMPTY] = stage_nothing,
+};
+
+int memory_one(APEX_CPU* cpu) {
+
+  cpu->executed &= ~STAGE_BIT(MEM_ONE);
+  if (cpu->waiting & STAGE_BIT(MEM_ONE)) {
+    finish_wait(cpu, MEM_ONE); // memory access still in progress
   }
+  else if (!((cpu->busy | cpu->stalled) & STAGE_BIT(MEM_ONE)) && !stage_held(cpu, MEM_ONE)) {
+    // every lane has its own memory port, the group moves on with its slowest access
+    int latency = 1;
+    for (int lane = 0; lane < get_group_size(cpu, MEM_ONE); ++lane) {
+      CPU_Stage* stage = &cpu->stage[lane][MEM_ONE];
+      const APEX_Instruction* ins = get_lane_instruction(cpu, MEM_ONE, lane);
+      memory_handlers[ins->opcode](cpu, stage, ins);
+      int cycles = stage_latency(cpu, MEM_ONE, stage, ins->opcode);
+      latency = (cycles > latency) ? cycles : latency;
+    }
+    cpu->executed |= STAGE_BIT(MEM_ONE);
+    start_wait(cpu, MEM_ONE, latency - 1);
+  }
+  show_stage(cpu, "Memory One", MEM_ONE);
 
   return 0;
 }
@@ -998,117 +1206,15 @@ int memory_one(APEX_CPU* cpu) {
  */
 int memory_two(APEX_CPU* cpu) {
 
-  cpu->stage[MEM_TWO].executed = 0;
-  CPU_Stage* stage = &cpu->stage[MEM_TWO];
-  if (!stage->busy && !stage->stalled) {
-
-    /* Store */
-    if (strcmp(stage->opcode, "STORE") == 0) {
-      // use memory address and write value in data_memory
-      if (stage->mem_address > DATA_MEMORY_SIZE) {
-        // Segmentation fault
-        fprintf(stderr, "Segmentation fault for writing memory location :: %d\n", stage->mem_address);
-      }
-      else {
-        cpu->data_memory[stage->mem_address] = stage->rd_value;
-      }
-    }
-    else if (strcmp(stage->opcode, "STR") == 0) {
-      // use memory address and write value in data_memory
-      if (stage->mem_address > DATA_MEMORY_SIZE) {
-        // Segmentation fault
-        fprintf(stderr, "Segmentation fault for writing memory location :: %d\n", stage->mem_address);
-      }
-      else {
-        cpu->data_memory[stage->mem_address] = stage->rd_value;
-      }
-    }
-    else if (strcmp(stage->opcode, "LOAD") == 0) {
-      // use memory address and write value in data_memory
-      if (stage->mem_address > DATA_MEMORY_SIZE) {
-        // Segmentation fault
-        fprintf(stderr, "Segmentation fault for accessing memory location :: %d\n", stage->mem_address);
-      }
-      else {
-        stage->rd_value = cpu->data_memory[stage->mem_address];
-      }
-    }
-    else if (strcmp(stage->opcode, "LDR") == 0) {
-      // use memory address and write value in data_memory
-      if (stage->mem_address > DATA_MEMORY_SIZE) {
-        // Segmentation fault
-        fprintf(stderr, "Segmentation fault for accessing memory location :: %d\n", stage->mem_address);
-      }
-      else {
-        stage->rd_value = cpu->data_memory[stage->mem_address];
-      }
-    }
-    /* MOVC */
-    else if (strcmp(stage->opcode, "MOVC") == 0) {
-      ; // stage->rd_value = stage->buffer; // move buffer value to rd_value so it can be forwarded
-    }
-    else if (strcmp(stage->opcode, "MOV") == 0) {
-      ; // stage->rd_value = stage->rs1_value; // move rs1_value value to rd_value so it can be forwarded
-    }
-    else if (strcmp(stage->opcode, "ADD") == 0) {
-      // can flags be used to make better decision
-      ; // Nothing for now holding rd_value from exe stage
-    }
-    else if (strcmp(stage->opcode, "ADDL") == 0) {
-      // can flags be used to make better decision
-      ; // Nothing for now holding rd_value from exe stage
-    }
-    else if (strcmp(stage->opcode, "SUB") == 0) {
-      // can flags be used to make better decision
-      ; // Nothing for now holding rd_value from exe stage
-    }
-    else if (strcmp(stage->opcode, "SUBL") == 0) {
-      // can flags be used to make better decision
-      ; // Nothing for now holding rd_value from exe stage
-    }
-    else if (strcmp(stage->opcode, "MUL") == 0) {
-      // can flags be used to make better decision
-      ; // Nothing for now holding rd_value from exe stage
-    }
-    else if (strcmp(stage->opcode, "DIV") == 0) {
-      // can flags be used to make better decision
-      ; // Nothing for now holding rd_value from exe stage
-    }
-    else if (strcmp(stage->opcode, "AND") == 0) {
-      // can flags be used to make better decision
-      ; // Nothing for now holding rd_value from exe stage
-    }
-    else if (strcmp(stage->opcode, "OR") == 0) {
-      // can flags be used to make better decision
-      ; // Nothing for now holding rd_value from exe stage
+  cpu->executed &= ~STAGE_BIT(MEM_TWO);
+  if (!((cpu->busy | cpu->stalled) & STAGE_BIT(MEM_TWO)) && !stage_held(cpu, MEM_TWO)) {
+    for (int lane = 0; lane < get_group_size(cpu, MEM_TWO); ++lane) {
+      const APEX_Instruction* ins = get_lane_instruction(cpu, MEM_TWO, lane);
+      memory_handlers[ins->opcode](cpu, &cpu->stage[lane][MEM_TWO], ins);
     }
-    else if (strcmp(stage->opcode, "EX-OR") == 0) {
-      // can flags be used to make better decision
-      ; // Nothing for now holding rd_value from exe stage
-    }
-    else if (strcmp(stage->opcode, "BZ") == 0) {
-      ; // Nothing for now
-    }
-    else if (strcmp(stage->opcode, "BNZ") == 0) {
-      ; // Nothing for now
-    }
-    else if (strcmp(stage->opcode, "JUMP") == 0) {
-      ; // Nothing for now
-    }
-    else if (strcmp(stage->opcode, "HALT") == 0) {
-      ; // Nothing for now
-    }
-    else if (strcmp(stage->opcode, "NOP") == 0) {
-      ; // Nothing for now
-    }
-    else {
-      ; // Nothing
-    }
-    cpu->stage[MEM_TWO].executed = 1;
-  }
-  if (ENABLE_DEBUG_MESSAGES) {
-    print_stage_content("Memory Two", stage);
+    cpu->executed |= STAGE_BIT(MEM_TWO);
   }
+  show_stage(cpu, "Memory Two", MEM_TWO);
 
   return 0;
 }
@@ -1116,395 +1222,457 @@ int memory_two(APEX_CPU* cpu) {
 /*
  * ########################################## Writeback Stage ##########################################
  */
+static void write_register(APEX_CPU* cpu, CPU_Stage* stage, const APEX_Instruction* ins) {
+  cpu->regs[ins->rd] = stage->rd_value;
+  cpu->dest_masks[WB] &= ~ins->dest_mask; // make desitination regs valid so following instructions won't stall
+  update_pending(cpu);
+  if (cpu->trace) {
+    trace_register_write(cpu, ins->rd, stage->rd_value);
+  }
+  // also unstall instruction which were dependent on rd reg
+  // values are valid unstall DF and Fetch Stage
+  cpu->stalled &= ~STAGE_BIT(DRF);
+  cpu->stalled &= ~STAGE_BIT(F);
+}
+
+static int writeback_reg(APEX_CPU* cpu, CPU_Stage* stage, const APEX_Instruction* ins) {
+  // use rd address and write value in register
+  if (!ins->dest_mask) {
+    // Segmentation fault, rd is outside the register file
+    fprintf(stderr, "Segmentation fault for accessing register location :: %d\n", ins->rd);
+  }
+  else {
+    write_register(cpu, stage, ins);
+  }
+  return SUCCESS;
+}
+
+static int writeback_arithmetic(APEX_CPU* cpu, CPU_Stage* stage, const APEX_Instruction* ins) {
+  // use rd address and write value in register, result decides zero flag
+  if (!ins->dest_mask) {
+    // Segmentation fault, rd is outside the register file
+    fprintf(stderr, "Segmentation fault for accessing register location :: %d\n", ins->rd);
+  }
+  else {
+    cpu->flags[ZF] = (stage->rd_value == 0); // computation resulted value zero
+    write_register(cpu, stage, ins);
+  }
+  return SUCCESS;
+}
+
+static int writeback_div(APEX_CPU* cpu, CPU_Stage* stage, const APEX_Instruction* ins) {
+  // use rd address and write value in register, remainder decides zero flag
+  if (!ins->dest_mask) {
+    // Segmentation fault, rd is outside the register file
+    fprintf(stderr, "Segmentation fault for accessing register location :: %d\n", ins->rd);
+  }
+  else {
+    // remainder / operation result is zero, division by zero gives 0 with ZF clear like func functional
+    cpu->flags[ZF] = (stage->rs2_value != 0) && (stage->rs1_value % stage->rs2_value != 0);
+    write_register(cpu, stage, ins);
+  }
+  return SUCCESS;
+}
+
+static int writeback_halt(APEX_CPU* cpu, CPU_Stage* stage, const APEX_Instruction* ins) {
+  return HALT; // return exit code halt to stop simulation
+}
+
+static int writeback_empty(APEX_CPU* cpu, CPU_Stage* stage, const APEX_Instruction* ins) {
+  return EMPTY; // return exit code empty to stop simulation
+}
+
+static const APEX_Stage_Handler writeback_handlers[NUM_OPCODES] = {
+  [OP_STORE] = stage_nothing,
+  [OP_STR]   = stage_nothing,
+  [OP_LOAD]  = writeback_reg,
+  [OP_LDR]   = writeback_reg,
+  [OP_MOVC]  = writeback_reg,
+  [OP_MOV]   = writeback_reg,
+  [OP_ADD]   = writeback_arithmetic,
+  [OP_ADDL]  = writeback_arithmetic,
+  [OP_SUB]   = writeback_arithmetic,
+  [OP_SUBL]  = writeback_arithmetic,
+  [OP_MUL]   = writeback_arithmetic,
+  [OP_DIV]   = writeback_div,
+  [OP_AND]   = writeback_reg,
+  [OP_OR]    = writeback_reg,
+  [OP_EXOR]  = writeback_reg,
+  [OP_BZ]    = stage_nothing,
+  [OP_BNZ]   = stage_nothing,
+  [OP_JUMP]  = stage_nothing,
+  [OP_HALT]  = writeback_halt,
+  [OP_NOP]   = stage_nothing,
+  [OP_EMPTY] = writeback_empty,
+};
+
+static int results_done(APEX_CPU* cpu, int stage_index) {
+  // every lane of stage has its result, a bubble has nothing to wait for
+  for (int lane = 0; (lane < get_group_size(cpu, stage_index)) && !(cpu->bubble & STAGE_BIT(stage_index)); ++lane) {
+    if (cpu->stage[lane][stage_index].ready_cycle > cpu->clock) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
 int writeback(APEX_CPU* cpu) {
 
   int ret = 0;
-  cpu->stage[WB].executed = 0;
-  CPU_Stage* stage = &cpu->stage[WB];
-  if (!stage->busy && !stage->stalled) {
-
-    /* Store */
-    if (strcmp(stage->opcode, "STORE") == 0) {
-      ; // Nothing for now
-    }
-    else if (strcmp(stage->opcode, "STR") == 0) {
-      ; // Nothing for now
-    }
-    else if (strcmp(stage->opcode, "LOAD") == 0) {
-      // use rd address and write value in register
-      if (stage->rd > REGISTER_FILE_SIZE) {
-        // Segmentation fault
-        fprintf(stderr, "Segmentation fault for accessing register location :: %d\n", stage->rd);
-      }
-      else {
-        cpu->regs[stage->rd] = stage->rd_value;
-        set_reg_status(cpu, stage->rd, -1); // make desitination regs valid so following instructions won't stall
-        // also unstall instruction which were dependent on rd reg
-        // values are valid unstall DF and Fetch Stage
-        cpu->stage[DRF].stalled = 0;
-        cpu->stage[F].stalled = 0;
-      }
-    }
-    else if (strcmp(stage->opcode, "LDR") == 0) {
-      // use rd address and write value in register
-      if (stage->rd > REGISTER_FILE_SIZE) {
-        // Segmentation fault
-        fprintf(stderr, "Segmentation fault for accessing register location :: %d\n", stage->rd);
-      }
-      else {
-        cpu->regs[stage->rd] = stage->rd_value;
-        set_reg_status(cpu, stage->rd, -1); // make desitination regs valid so following instructions won't stall
-        // also unstall instruction which were dependent on rd reg
-        // values are valid unstall DF and Fetch Stage
-        cpu->stage[DRF].stalled = 0;
-        cpu->stage[F].stalled = 0;
-      }
-    }
-    /* MOVC */
-    else if (strcmp(stage->opcode, "MOVC") == 0) {
-      // use rd address and write value in register
-      if (stage->rd > REGISTER_FILE_SIZE) {
-        // Segmentation fault
-        fprintf(stderr, "Segmentation fault for accessing register location :: %d\n", stage->rd);
-      }
-      else {
-        cpu->regs[stage->rd] = stage->rd_value;
-        set_reg_status(cpu, stage->rd, -1); // make desitination regs valid so following instructions won't stall
-        // also unstall instruction which were dependent on rd reg
-        // values are valid unstall DF and Fetch Stage
-        cpu->stage[DRF].stalled = 0;
-        cpu->stage[F].stalled = 0;
-      }
-    }
-    else if (strcmp(stage->opcode, "MOV") == 0) {
-      // use rd address and write value in register
-      if (stage->rd > REGISTER_FILE_SIZE) {
-        // Segmentation fault
-        fprintf(stderr, "Segmentation fault for accessing register location :: %d\n", stage->rd);
-      }
-      else {
-        cpu->regs[stage->rd] = stage->rd_value;
-        set_reg_status(cpu, stage->rd, -1); // make desitination regs valid so following instructions won't stall
-        // also unstall instruction which were dependent on rd reg
-        // values are valid unstall DF and Fetch Stage
-        cpu->stage[DRF].stalled = 0;
-        cpu->stage[F].stalled = 0;
-      }
-    }
-    else if (strcmp(stage->opcode, "ADD") == 0) {
-      // use rd address and write value in register
-      if (stage->rd > REGISTER_FILE_SIZE) {
-        // Segmentation fault
-        fprintf(stderr, "Segmentation fault for accessing register location :: %d\n", stage->rd);
-      }
-      else {
-        if (stage->rd_value == 0) {
-          cpu->flags[ZF] = 1; // computation resulted value zero
-        }
-        else {
-          cpu->flags[ZF] = 0; // computation did not resulted value zero
-        }
-        cpu->regs[stage->rd] = stage->rd_value;
-        set_reg_status(cpu, stage->rd, -1); // make desitination regs valid so following instructions won't stall
-        // also unstall instruction which were dependent on rd reg
-        // values are valid unstall DF and Fetch Stage
-        cpu->stage[DRF].stalled = 0;
-        cpu->stage[F].stalled = 0;
-      }
-    }
-    else if (strcmp(stage->opcode, "ADDL") == 0) {
-      // use rd address and write value in register
-      if (stage->rd > REGISTER_FILE_SIZE) {
-        // Segmentation fault
-        fprintf(stderr, "Segmentation fault for accessing register location :: %d\n", stage->rd);
-      }
-      else {
-        if (stage->rd_value == 0) {
-          cpu->flags[ZF] = 1; // computation resulted value zero
-        }
-        else {
-          cpu->flags[ZF] = 0; // computation did not resulted value zero
-        }
-        cpu->regs[stage->rd] = stage->rd_value;
-        set_reg_status(cpu, stage->rd, -1); // make desitination regs valid so following instructions won't stall
-        // also unstall instruction which were dependent on rd reg
-        // values are valid unstall DF and Fetch Stage
-        cpu->stage[DRF].stalled = 0;
-        cpu->stage[F].stalled = 0;
-      }
-    }
-    else if (strcmp(stage->opcode, "SUB") == 0) {
-      // use rd address and write value in register
-      if (stage->rd > REGISTER_FILE_SIZE) {
-        // Segmentation fault
-        fprintf(stderr, "Segmentation fault for accessing register location :: %d\n", stage->rd);
-      }
-      else {
-        if (stage->rd_value == 0) {
-          cpu->flags[ZF] = 1; // computation resulted value zero
-        }
-        else {
-          cpu->flags[ZF] = 0; // computation did not resulted value zero
-        }
-        cpu->regs[stage->rd] = stage->rd_value;
-        set_reg_status(cpu, stage->rd, -1); // make desitination regs valid so following instructions won't stall
-        // also unstall instruction which were dependent on rd reg
-        // values are valid unstall DF and Fetch Stage
-        cpu->stage[DRF].stalled = 0;
-        cpu->stage[F].stalled = 0;
-      }
-    }
-    else if (strcmp(stage->opcode, "SUBL") == 0) {
-      // use rd address and write value in register
-      if (stage->rd > REGISTER_FILE_SIZE) {
-        // Segmentation fault
-        fprintf(stderr, "Segmentation fault for accessing register location :: %d\n", stage->rd);
-      }
-      else {
-        if (stage->rd_value == 0) {
-          cpu->flags[ZF] = 1; // computation resulted value zero
-        }
-        else {
-          cpu->flags[ZF] = 0; // computation did not resulted value zero
-        }
-        cpu->regs[stage->rd] = stage->rd_value;
-        set_reg_status(cpu, stage->rd, -1); // make desitination regs valid so following instructions won't stall
-        // also unstall instruction which were dependent on rd reg
-        // values are valid unstall DF and Fetch Stage
-        cpu->stage[DRF].stalled = 0;
-        cpu->stage[F].stalled = 0;
-      }
-    }
-    else if (strcmp(stage->opcode, "MUL") == 0) {
-      // use rd address and write value in register
-      if (stage->rd > REGISTER_FILE_SIZE) {
-        // Segmentation fault
-        fprintf(stderr, "Segmentation fault for accessing register location :: %d\n", stage->rd);
-      }
-      else {
-        if (stage->rd_value == 0) {
-          cpu->flags[ZF] = 1; // computation resulted value zero
-        }
-        else {
-          cpu->flags[ZF] = 0; // computation did not resulted value zero
-        }
-        cpu->regs[stage->rd] = stage->rd_value;
-        set_reg_status(cpu, stage->rd, -1); // make desitination regs valid so following instructions won't stall
-        // also unstall instruction which were dependent on rd reg
-        // values are valid unstall DF and Fetch Stage
-        cpu->stage[DRF].stalled = 0;
-        cpu->stage[F].stalled = 0;
-      }
-    }
-    else if (strcmp(stage->opcode, "DIV") == 0) {
-      // use rd address and write value in register
-      if (stage->rd > REGISTER_FILE_SIZE) {
-        // Segmentation fault
-        fprintf(stderr, "Segmentation fault for accessing register location :: %d\n", stage->rd);
-      }
-      else {
-        if (stage->rs1_value % stage->rs2_value != 0) {
-          cpu->flags[ZF] = 1; // remainder / operation result is zero
-        }
-        else {
-          cpu->flags[ZF] = 0; // remainder / operation result is not zero
-        }
-        cpu->regs[stage->rd] = stage->rd_value;
-        set_reg_status(cpu, stage->rd, -1); // make desitination regs valid so following instructions won't stall
-        // also un-stall instruction which were dependent on rd reg
-        // values are valid un-stall DF and Fetch Stage
-        cpu->stage[DRF].stalled = 0;
-        cpu->stage[F].stalled = 0;
-      }
-    }
-    else if (strcmp(stage->opcode, "AND") == 0) {
-      // use rd address and write value in register
-      if (stage->rd > REGISTER_FILE_SIZE) {
-        // Segmentation fault
-        fprintf(stderr, "Segmentation fault for accessing register location :: %d\n", stage->rd);
-      }
-      else {
-        cpu->regs[stage->rd] = stage->rd_value;
-        set_reg_status(cpu, stage->rd, -1); // make desitination regs valid so following instructions won't stall
-        // also unstall instruction which were dependent on rd reg
-        // values are valid unstall DF and Fetch Stage
-        cpu->stage[DRF].stalled = 0;
-        cpu->stage[F].stalled = 0;
-      }
-    }
-    else if (strcmp(stage->opcode, "OR") == 0) {
-      // use rd address and write value in register
-      if (stage->rd > REGISTER_FILE_SIZE) {
-        // Segmentation fault
-        fprintf(stderr, "Segmentation fault for accessing register location :: %d\n", stage->rd);
-      }
-      else {
-        cpu->regs[stage->rd] = stage->rd_value;
-        set_reg_status(cpu, stage->rd, -1); // make desitination regs valid so following instructions won't stall
-        // also unstall instruction which were dependent on rd reg
-        // values are valid unstall DF and Fetch Stage
-        cpu->stage[DRF].stalled = 0;
-        cpu->stage[F].stalled = 0;
-      }
-    }
-    else if (strcmp(stage->opcode, "EX-OR") == 0) {
-      // use rd address and write value in register
-      if (stage->rd > REGISTER_FILE_SIZE) {
-        // Segmentation fault
-        fprintf(stderr, "Segmentation fault for accessing register location :: %d\n", stage->rd);
-      }
-      else {
-        cpu->regs[stage->rd] = stage->rd_value;
-        set_reg_status(cpu, stage->rd, -1); // make desitination regs valid so following instructions won't stall
-        // also unstall instruction which were dependent on rd reg
-        // values are valid unstall DF and Fetch Stage
-        cpu->stage[DRF].stalled = 0;
-        cpu->stage[F].stalled = 0;
-      }
-    }
-    else if (strcmp(stage->opcode, "BZ") == 0) {
-      ; // Nothing for now
-    }
-    else if (strcmp(stage->opcode, "BNZ") == 0) {
-      ; // Nothing for now
-    }
-    else if (strcmp(stage->opcode, "JUMP") == 0) {
-      ; // Nothing for now
-    }
-    else if (strcmp(stage->opcode, "HALT") == 0) {
-      ret = HALT; // return exit code halt to stop simulation
-    }
-    else if (strcmp(stage->opcode, "NOP") == 0) {
-      ; // Nothing for now
-    }
-    else {
-      if (strcmp(stage->opcode, "") == 0) {
-        ret = EMPTY; // return exit code empty to stop simulation
+  cpu->executed &= ~STAGE_BIT(WB);
+  cpu->waiting &= ~STAGE_BIT(WB); // results still on a functional unit are looked at again every cycle
+  if (!((cpu->busy | cpu->stalled) & STAGE_BIT(WB)) && !results_done(cpu, WB)) {
+    cpu->waiting |= STAGE_BIT(WB); // every stage holds till the slowest result of the group is done
+    cpu->wait_cycles[WB] = 1;
+  }
+  else if (!((cpu->busy | cpu->stalled) & STAGE_BIT(WB))) {
+    // lanes retire oldest first, nothing after a HALT or the end of code memory
+    for (int lane = 0; (lane < get_group_size(cpu, WB)) && !ret; ++lane) {
+      const APEX_Instruction* ins = get_lane_instruction(cpu, WB, lane);
+      ret = writeback_handlers[ins->opcode](cpu, &cpu->stage[lane][WB], ins);
+      cpu->counters.ins_completed++;
+      if (!(cpu->bubble & STAGE_BIT(WB)) && (ins->opcode != OP_EMPTY)) {
+        cpu->counters.ins_retired++; // an instruction of the program, not a bubble
       }
     }
-    cpu->stage[WB].executed = 1;
-    cpu->ins_completed++;
+    cpu->executed |= STAGE_BIT(WB);
   }
   // But If Fetch has Something and Decode Has NOP Do Not Un Stall Fetch
   // Intrupt Flag is set
-  if ((cpu->flags[IF])&&(strcmp(cpu->stage[DRF].opcode, "NOP") == 0)){
-    cpu->stage[F].stalled = 1;
-  }
-  if (ENABLE_DEBUG_MESSAGES) {
-    print_stage_content("Writeback", stage);
+  if ((cpu->flags[IF])&&(get_stage_instruction(cpu, DRF)->opcode == OP_NOP)){
+    cpu->stalled |= STAGE_BIT(F);
   }
+  show_stage(cpu, "Writeback", WB);
 
   return ret;
 }
 
+/* Move status bits of stages in mask to the next stage, status travels with the latch */
+static unsigned int push_status(unsigned int status, unsigned int moved) {
+  return (status & ~moved) | ((status << 1) & moved);
+}
+
 static void push_stages(APEX_CPU* cpu) {
 
-  cpu->stage[WB] = cpu->stage[MEM_TWO];
-  cpu->stage[WB].executed = 0;
-  cpu->stage[MEM_TWO] = cpu->stage[MEM_ONE];
-  cpu->stage[MEM_TWO].executed = 0;
-  cpu->stage[MEM_ONE] = cpu->stage[EX_TWO];
-  cpu->stage[MEM_ONE].executed = 0;
-  cpu->stage[EX_TWO] = cpu->stage[EX_ONE];
-  cpu->stage[EX_TWO].executed = 0;
-  if (!cpu->stage[DRF].stalled) {
-    cpu->stage[EX_ONE] = cpu->stage[DRF];
-    cpu->stage[EX_ONE].executed = 0;
+  // stages taking the latch of the stage before them
+  unsigned int moved = STAGE_BIT(WB) | STAGE_BIT(MEM_TWO) | STAGE_BIT(MEM_ONE) | STAGE_BIT(EX_TWO);
+  if (!(cpu->stalled & STAGE_BIT(DRF))) {
+    moved |= STAGE_BIT(EX_ONE);
   }
-  else {
-    add_bubble_to_stage(cpu, EX_ONE, 0); // next cycle Bubble will be executed
-    cpu->stage[EX_ONE].executed = 0;
+  if (!(cpu->stalled & STAGE_BIT(F))) {
+    moved |= STAGE_BIT(DRF);
   }
-  if (!cpu->stage[F].stalled) {
-    cpu->stage[DRF].rd = -99;
-    cpu->stage[DRF].rs1 = -99;
-    cpu->stage[DRF].rs2 = -99;
-    cpu->stage[DRF] = cpu->stage[F];
-    cpu->stage[DRF].executed = 0;
+  // stages up to the last waiting one keep their latch, the stage after it gets a bubble
+  unsigned int held = 0;
+  for (int i = WB; (i >= F) && !held; --i) {
+    if (cpu->waiting & STAGE_BIT(i)) {
+      held = (STAGE_BIT(i) << 1) - 1;
+    }
   }
-  else if (!cpu->stage[DRF].stalled) {
+  moved &= ~(held | (held << 1));
+  for (int i = WB; i > F; --i) {
+    if (moved & STAGE_BIT(i)) {
+      for (int lane = 0; lane < cpu->config.width; ++lane) {
+        cpu->stage[lane][i] = cpu->stage[lane][i - 1];
+      }
+      cpu->group_size[i] = cpu->group_size[i - 1];
+      cpu->dest_masks[i] = cpu->dest_masks[i - 1];
+    }
+  }
+  int split = (moved & STAGE_BIT(EX_ONE)) ? cpu->group_split : 0;
+  if (split) {
+    // only the older lanes of the Decode/RF group went on, the rest move down to lane 0
+    int rest = cpu->group_size[DRF] - split;
+    cpu->group_size[EX_ONE] = split;
+    for (int lane = 0; lane < rest; ++lane) {
+      cpu->stage[lane][DRF] = cpu->stage[lane + split][DRF];
+    }
+    cpu->group_size[DRF] = rest;
+  }
+  cpu->busy = push_status(cpu->busy, moved);
+  cpu->stalled = push_status(cpu->stalled, moved);
+  cpu->empty = push_status(cpu->empty, moved);
+  cpu->bubble = push_status(cpu->bubble, moved);
+  cpu->predicted = push_status(cpu->predicted, moved);
+  cpu->executed = push_status(cpu->executed, moved);
+  if (split) {
+    cpu->predicted &= ~STAGE_BIT(EX_ONE); // a predicted branch ends its group, so it stayed behind
+  }
+
+  if (!(moved & STAGE_BIT(EX_ONE)) && !(held & STAGE_BIT(EX_ONE))) {
+    add_bubble_to_stage(cpu, EX_ONE, 0); // next cycle Bubble will be executed
+  }
+  if (!(moved & STAGE_BIT(DRF)) && !(cpu->stalled & STAGE_BIT(DRF)) && !(held & STAGE_BIT(DRF)) && !split) {
     add_bubble_to_stage(cpu, DRF, 0); // next cycle Bubble will be executed
-    cpu->stage[DRF].executed = 0;
   }
+  for (int i = EX_TWO; i <= WB; ++i) {
+    if ((held << 1) & ~held & STAGE_BIT(i)) {
+      // instruction behind a waiting stage moved on and nothing took its place
+      cpu->bubble |= STAGE_BIT(i);
+      cpu->busy &= ~STAGE_BIT(i);
+      cpu->stalled &= ~STAGE_BIT(i);
+      cpu->empty &= ~STAGE_BIT(i);
+      cpu->dest_masks[i] = 0;
+    }
+  }
+  if (!(moved & STAGE_BIT(EX_ONE)) && !(held & STAGE_BIT(EX_ONE))) {
+    cpu->dest_masks[EX_ONE] = 0; // its group moved on, the bubble left behind writes nothing
+  }
+  update_pending(cpu);
+  cpu->executed &= STAGE_BIT(F); // stages below fetch have not executed their new latch yet
   if (ENABLE_PUSH_STAGE_PRINT) {
-    printf("\n--------------------------------\n");
-    printf("Clock Cycle #: %d Instructions Pushed\n", cpu->clock);
-    printf("%-15s: Executed: Instruction\n", "Stage");
-    printf("--------------------------------\n");
-    print_stage_content("Writeback", &cpu->stage[WB]);
-    print_stage_content("Memory Two", &cpu->stage[MEM_TWO]);
-    print_stage_content("Memory One", &cpu->stage[MEM_ONE]);
-    print_stage_content("Execute Two", &cpu->stage[EX_TWO]);
-    print_stage_content("Execute One", &cpu->stage[EX_ONE]);
-    print_stage_content("Decode/RF", &cpu->stage[DRF]);
-    print_stage_content("Fetch", &cpu->stage[F]);
+    fprintf(cpu->out, "\n--------------------------------\n");
+    fprintf(cpu->out, "Clock Cycle #: %d Instructions Pushed\n", cpu->clock);
+    fprintf(cpu->out, "%-15s: Executed: Instruction\n", "Stage");
+    fprintf(cpu->out, "--------------------------------\n");
+    print_stage_content(cpu, "Writeback", WB);
+    print_stage_content(cpu, "Memory Two", MEM_TWO);
+    print_stage_content(cpu, "Memory One", MEM_ONE);
+    print_stage_content(cpu, "Execute Two", EX_TWO);
+    print_stage_content(cpu, "Execute One", EX_ONE);
+    print_stage_content(cpu, "Decode/RF", DRF);
+    print_stage_content(cpu, "Fetch", F);
   }
 }
+/*
+ * ########################################## Cycle Skipping ##########################################
+ */
+static int stage_has_work(int stage_index, int opcode) {
+  // handler of opcode in stage changes cpu state (not counting the latch move)
+  switch (stage_index) {
+    case EX_ONE:
+      return execute_one_handlers[opcode] != stage_nothing;
+    case EX_TWO:
+      return execute_two_handlers[opcode] != stage_nothing;
+    case MEM_ONE:
+    case MEM_TWO:
+      return memory_handlers[opcode] != stage_nothing;
+    case WB:
+      return writeback_handlers[opcode] != stage_nothing;
+    default:
+      return 1;
+  }
+}
+
+/* Stages moving a latch every cycle while Fetch is stalled */
+#define IN_FLIGHT_STAGES (STAGE_BIT(EX_ONE) | STAGE_BIT(EX_TWO) | STAGE_BIT(MEM_ONE) | STAGE_BIT(MEM_TWO) | STAGE_BIT(WB))
+
+static int skippable_cycles(APEX_CPU* cpu) {
+  // While Fetch is stalled and Decode/RF either waits on a producer or holds a bubble,
+  // a cycle only moves latches towards WB until some instruction reaches a stage with work.
+  // Returns number of such cycles from now, 0 if next one has work, INT_MAX if none ever has
+  unsigned int drf = STAGE_BIT(DRF);
+  if (!(cpu->stalled & STAGE_BIT(F)) || ((cpu->busy | cpu->stalled) & IN_FLIGHT_STAGES) || cpu->waiting || cpu->unit_wait) {
+    return 0;
+  }
+  if (cpu->config.forwarding && (cpu->stalled & drf)) {
+    return 0; // a stall ends once the producer reaches a bypass path, not at its writeback
+  }
+  int drf_opcode = get_stage_instruction(cpu, DRF)->opcode;
+  if ((drf_opcode == OP_HALT) || (!(cpu->stalled & drf) && ((drf_opcode != OP_NOP) || (cpu->busy & drf)))) {
+    return 0;
+  }
+  int cycles = INT_MAX;
+  for (int i = EX_ONE; (i <= WB) && cycles; ++i) {
+    for (int lane = 0; lane < get_group_size(cpu, i); ++lane) {
+      int opcode = get_lane_instruction(cpu, i, lane)->opcode;
+      for (int j = i; (j <= WB) && (j - i < cycles); ++j) {
+        if (stage_has_work(j, opcode)) {
+          cycles = j - i;
+          break;
+        }
+      }
+    }
+  }
+  return cycles;
+}
+
+static void skip_cycles(APEX_CPU* cpu, int cycles) {
+  // Same state as running the stage functions for cycles, none of them has work to do
+  for (int i = 0; i < cycles; ++i) {
+    CPU_Stage stage[MAX_ISSUE_WIDTH][NUM_STAGES];
+    size_t lanes_size = cpu->config.width * sizeof(stage[0]); // lanes past config.width are never used
+    int group_size[NUM_STAGES];
+    unsigned int status[] = {cpu->busy, cpu->stalled, cpu->empty, cpu->bubble};
+    memcpy(stage, cpu->stage, lanes_size);
+    memcpy(group_size, cpu->group_size, sizeof(group_size));
+    int leaving = get_group_size(cpu, WB);
+    cpu->clock++;
+    cpu->counters.ins_completed += leaving; // bubble or instructions without writeback work leave writeback
+    if (!(cpu->bubble & STAGE_BIT(WB))) {
+      cpu->counters.ins_retired += leaving;
+    }
+    if (cpu->stalled & STAGE_BIT(DRF)) {
+      count_data_stall(cpu, 1);
+    }
+    if (cpu->flags[IF] && (cpu->stalled & STAGE_BIT(F))) {
+      cpu->counters.stall_halt++;
+    }
+    cpu->executed = ~(cpu->busy | cpu->stalled) & ~STAGE_BIT(F); // stalled Fetch does not execute
+    push_stages(cpu);
+    unsigned int pushed[] = {cpu->busy, cpu->stalled, cpu->empty, cpu->bubble};
+    if (!memcmp(stage, cpu->stage, lanes_size) && !memcmp(group_size, cpu->group_size, sizeof(group_size)) &&
+        !memcmp(status, pushed, sizeof(status))) {
+      // nothing moves any more, rest of the cycles look the same
+      leaving = get_group_size(cpu, WB);
+      cpu->clock += cycles - i - 1;
+      cpu->counters.ins_completed += (cycles - i - 1) * leaving;
+      if (!(cpu->bubble & STAGE_BIT(WB))) {
+        cpu->counters.ins_retired += (cycles - i - 1) * leaving;
+      }
+      if (cpu->stalled & STAGE_BIT(DRF)) {
+        count_data_stall(cpu, cycles - i - 1);
+      }
+      if (cpu->flags[IF] && (cpu->stalled & STAGE_BIT(F))) {
+        cpu->counters.stall_halt += cycles - i - 1;
+      }
+      break;
+    }
+  }
+  cpu->counters.cycles_skipped += cycles;
+}
+
 /*
  * ########################################## CPU Run ##########################################
  */
+static int run_cycle(APEX_CPU* cpu) {
+  // Simulates one clock cycle, returns HALT or EMPTY once they reach writeback
+  cpu->clock++; // places here so we can see prints aligned with executions
+
+  if (print_cycle(cpu)) {
+    fprintf(cpu->out, "\n--------------------------------\n");
+    fprintf(cpu->out, "Clock Cycle #: %d\n", cpu->clock);
+    fprintf(cpu->out, "%-15s: Executed: Instruction\n", "Stage");
+    fprintf(cpu->out, "--------------------------------\n");
+  }
+  if (cpu->trace) {
+    trace_cycle(cpu);
+  }
+
+  // why we are executing from behind ??
+  int stage_ret = 0;
+  stage_ret = writeback(cpu);
+  if ((stage_ret == HALT) || (stage_ret == EMPTY)) {
+    show_stage(cpu, "Memory Two", MEM_TWO);
+    show_stage(cpu, "Memory One", MEM_ONE);
+    show_stage(cpu, "Execute Two", EX_TWO);
+    show_stage(cpu, "Execute One", EX_ONE);
+    show_stage(cpu, "Decode/RF", DRF);
+    show_stage(cpu, "Fetch", F);
+    if (cpu->timeline) {
+      timeline_cycle(cpu);
+    }
+    return stage_ret; // halt is encountered or empty instruction goes to writeback
+  }
+  stage_ret = memory_two(cpu);
+  stage_ret = memory_one(cpu);
+  stage_ret = execute_two(cpu);
+  stage_ret = execute_one(cpu);
+  stage_ret = decode(cpu);
+  stage_ret = fetch(cpu);
+  if (cpu->timeline) {
+    timeline_cycle(cpu);
+  }
+  push_stages(cpu);
+  return (stage_ret != HALT) ? stage_ret : SUCCESS;
+}
+
+static int step_pipeline(APEX_CPU* cpu, int num_cycle) {
+  // Simulates next cycle, quiet runs skip ahead while the pipeline only drains stalls,
+  // a traced run or timeline records every cycle
+  if (cpu->config.engine) {
+    return APEX_ooo_cycle(cpu);
+  }
+  if (ENABLE_CYCLE_SKIPPING && cpu->quiet && !cpu->trace && !cpu->timeline) {
+    int cycles = skippable_cycles(cpu);
+    int limit = (num_cycle > 0) ? num_cycle - cpu->clock : WB - EX_ONE + 1;
+    if (cpu->checkpoint_file && (cpu->checkpoint_cycle > cpu->clock) && (cpu->checkpoint_cycle - cpu->clock < limit)) {
+      limit = cpu->checkpoint_cycle - cpu->clock;
+    }
+    if (cycles > limit) {
+      cycles = limit;
+    }
+    if (cycles > 0) {
+      skip_cycles(cpu, cycles);
+      return SUCCESS;
+    }
+  }
+  return run_cycle(cpu);
+}
+
 int APEX_cpu_run(APEX_CPU* cpu, int num_cycle) {
 
   int ret = 0;
 
   while (ret==0) {
 
+    /* Checkpoint requested at this cycle, written once */
+    if (cpu->checkpoint_file && (cpu->clock == cpu->checkpoint_cycle)) {
+      if (write_checkpoint(cpu, cpu->checkpoint_file) == SUCCESS) {
+        fprintf(stderr, "APEX_CPU : Checkpoint at cycle %d written to %s\n", cpu->clock, cpu->checkpoint_file);
+      }
+      else {
+        fprintf(stderr, "APEX_Error : Unable to write checkpoint %s\n", cpu->checkpoint_file);
+      }
+      cpu->checkpoint_file = NULL;
+    }
+
     /* Requested number of cycle committed, so pause and exit */
     if ((num_cycle>0)&&(cpu->clock == num_cycle)) {
-      printf("Requested %d Cycle Completed\n", num_cycle);
+      fprintf(cpu->out, "Requested %d Cycle Completed\n", num_cycle);
       break;
     }
     // /* All the instructions committed, so exit */
-    // if (cpu->ins_completed == cpu->code_memory_size) { // check number of instruction executed to break from while loop
+    // if (cpu->counters.ins_completed == cpu->code_memory_size) { // check number of instruction executed to break from while loop
     //   // also check if no brach is taken
     //   printf("All Instruction are Completed\n");
     //   break;
     // }
     else {
-      cpu->clock++; // places here so we can see prints aligned with executions
-
-      if (ENABLE_DEBUG_MESSAGES) {
-        printf("\n--------------------------------\n");
-        printf("Clock Cycle #: %d\n", cpu->clock);
-        printf("%-15s: Executed: Instruction\n", "Stage");
-        printf("--------------------------------\n");
-      }
-
-      // why we are executing from behind ??
-      int stage_ret = 0;
-      stage_ret = writeback(cpu);
-      if ((stage_ret == HALT) || (stage_ret == EMPTY)) {
-        if (ENABLE_DEBUG_MESSAGES) {
-          print_stage_content("Memory Two", &cpu->stage[MEM_TWO]);
-          print_stage_content("Memory One", &cpu->stage[MEM_ONE]);
-          print_stage_content("Execute Two", &cpu->stage[EX_TWO]);
-          print_stage_content("Execute One", &cpu->stage[EX_ONE]);
-          print_stage_content("Decode/RF", &cpu->stage[DRF]);
-          print_stage_content("Fetch", &cpu->stage[F]);
-        }
-        if (stage_ret == HALT) {
-          fprintf(stderr, "Simulation Stoped ....\n");
-          printf("Instruction HALT Encountered\n");
-        }
-        else if (stage_ret == EMPTY) {
-          fprintf(stderr, "Simulation Stoped ....\n");
-          printf("No More Instructions Encountered\n");
-        }
-        ret = stage_ret;
-        break; // break when halt is encountered or empty instruction goes to writeback
+      ret = step_pipeline(cpu, num_cycle);
+      if (ret == HALT) {
+        fprintf(stderr, "Simulation Stoped ....\n");
+        fprintf(cpu->out, "Instruction HALT Encountered\n");
       }
-      stage_ret = memory_two(cpu);
-      stage_ret = memory_one(cpu);
-      stage_ret = execute_two(cpu);
-      stage_ret = execute_one(cpu);
-      stage_ret = decode(cpu);
-      stage_ret = fetch(cpu);
-      if ((stage_ret!=HALT)&&(stage_ret!=SUCCESS)) {
-        ret = stage_ret;
+      else if (ret == EMPTY) {
+        fprintf(stderr, "Simulation Stoped ....\n");
+        fprintf(cpu->out, "No More Instructions Encountered\n");
       }
-      push_stages(cpu);
     }
   }
+  if (ENABLE_PERF_COUNTER_PRINT) {
+    print_perf_counters(cpu);
+  }
+
+  return ret;
+}
+
+int APEX_cpu_run_until(APEX_CPU* cpu, int end_cycle) {
+  // Simulates without messages till clock reaches end_cycle, returns HALT or EMPTY if program ends first
+  int ret = SUCCESS;
+  while ((ret == SUCCESS) && (cpu->clock < end_cycle)) {
+    ret = step_pipeline(cpu, end_cycle);
+  }
+  return ret;
+}
 
+int APEX_cpu_run_window(APEX_CPU* cpu, int warmup, int detail, int max_cycles, int* cycles, int* instructions) {
+  // Simulates the pipeline quietly from cpu->pc with empty stages, the first warmup instructions
+  // fill the pipeline and are not measured, then cycles taken by the next detail instructions are measured.
+  // Stops after max_cycles, returns HALT or EMPTY when program ends inside the window
+  APEX_cpu_reset_pipeline(cpu);
+  cpu->quiet = 1;
+  cpu->clock = 0;
+  cpu->counters.ins_retired = 0;
+  int start = (warmup > 0) ? -1 : 0; // clock when warmup was done
+  int ret = SUCCESS;
+  while ((ret == SUCCESS) && (cpu->counters.ins_retired < warmup + detail) && (cpu->clock < max_cycles)) {
+    ret = step_pipeline(cpu, max_cycles);
+    if ((start < 0) && (cpu->counters.ins_retired >= warmup)) {
+      start = cpu->clock;
+    }
+  }
+  *instructions = (start < 0) ? 0 : cpu->counters.ins_retired - warmup;
+  *cycles = (start < 0) ? 0 : cpu->clock - start;
   return ret;
 }
@@ -9,11 +9,15 @@
  *  State University of New York, Binghamton
  */
 
-#define RUNNING_IN_WINDOWS 0
+#include <stddef.h>
+#include <stdio.h>
 
 #define DATA_MEMORY_SIZE 4096
 #define REGISTER_FILE_SIZE 32
 
+/* Most instructions a pipeline latch or the out-of-order engine moves per cycle */
+#define MAX_ISSUE_WIDTH 8
+
 enum {
   F,
   DRF,
@@ -42,34 +46,316 @@ enum {
   NUM_FLAG
 };
 
+/* Operation Codes, resolved once while parsing the input file */
+enum {
+  OP_STORE,
+  OP_STR,
+  OP_LOAD,
+  OP_LDR,
+  OP_MOVC,
+  OP_MOV,
+  OP_ADD,
+  OP_ADDL,
+  OP_SUB,
+  OP_SUBL,
+  OP_MUL,
+  OP_DIV,
+  OP_AND,
+  OP_OR,
+  OP_EXOR,
+  OP_BZ,
+  OP_BNZ,
+  OP_JUMP,
+  OP_HALT,
+  OP_NOP,
+  OP_EMPTY, // No instruction, fetched past the end of code memory
+  NUM_OPCODES
+};
+
+/* Operand format class of an instruction */
+enum {
+  FMT_NONE,       // HALT, NOP
+  FMT_RD_RS1_IMM, // STORE, LOAD, ADDL, SUBL
+  FMT_RD_RS1_RS2, // STR, LDR, ADD, SUB, MUL, DIV, AND, OR, EX-OR
+  FMT_RD_IMM,     // MOVC
+  FMT_RD_RS1,     // MOV
+  FMT_IMM,        // BZ, BNZ
+  FMT_RS1_IMM,    // JUMP
+  NUM_FORMATS
+};
+
 /* Format of an APEX instruction  */
 typedef struct APEX_Instruction {
-  char opcode[128];	// Operation Code
+  int opcode;       // Operation Code
+  int format;       // Operand Format Class
   int rd;           // Destination Register Address
   int rs1;          // Source-1 Register Address
   int rs2;          // Source-2 Register Address
   int imm;          // Literal Value
+  unsigned int src_mask;  // Registers read in Decode/RF, one bit per register
+  unsigned int dest_mask; // Register written in Writeback, 0 if none
 } APEX_Instruction;
 
-/* Model of CPU stage latch */
+/* Checks shared by the pipeline, functional, jit, translated and out-of-order execution,
+ * inline so generated code including this header folds them like its own helpers */
+static inline int is_valid_reg(int reg_number) {
+  return (reg_number >= 0) && (reg_number < REGISTER_FILE_SIZE);
+}
+
+static inline int is_valid_mem(int mem_address) {
+  return (mem_address >= 0) && (mem_address < DATA_MEMORY_SIZE);
+}
+
+static inline int is_valid_branch(int pc, int offset) {
+  // check address validity, pc-add % 4 should be 0
+  return ((pc + offset) % 4 == 0) && !((pc + offset) < 4000);
+}
+
+static inline int has_valid_regs(const APEX_Instruction* ins) {
+  // Registers used by the format must be inside the register file
+  switch (ins->format) {
+    case FMT_RD_RS1_IMM:
+    case FMT_RD_RS1:
+      return is_valid_reg(ins->rd) && is_valid_reg(ins->rs1);
+    case FMT_RD_RS1_RS2:
+      return is_valid_reg(ins->rd) && is_valid_reg(ins->rs1) && is_valid_reg(ins->rs2);
+    case FMT_RD_IMM:
+      return is_valid_reg(ins->rd);
+    case FMT_RS1_IMM:
+      return is_valid_reg(ins->rs1);
+    default:
+      return 1;
+  }
+}
+
+/* Model of CPU stage latch
+ * Only the dynamic values live in the latch, the static fields (opcode, rd, rs1, rs2, imm)
+ * are read from decoded code memory using pc, so pushing a stage is a copy of 6 words.
+ */
 typedef struct CPU_Stage {
-  int pc;           // Program Counter
-  char opcode[128]; // Operation Code
-  int rs1;          // Source-1 Register Address
-  int rs2;          // Source-2 Register Address
-  int rd;           // Destination Register Address
-  int imm;          // Literal Value
-  int rs1_value;    // Source-1 Register Value
+  int pc;           // Program Counter, also locates the instruction in code memory
+  union {
+    int rs1_value;  // Source-1 Register Value
+    int mem_address;// Computed Memory Address, replaces rs1_value once computed in EX stage
+  };
   int rs2_value;    // Source-2 Register Value
   int rd_value;     // Destination Register Value
-  int buffer;       // Latch to hold some value  (currently used to hold literal value from decode)
-  int mem_address;  // Computed Memory Address
-  int busy;         // Flag to indicate, stage is performing some action
-  int stalled;      // Flag to indicate, stage is stalled
-  int executed;     // Flag to indicate, stage has executed or not
-  int empty;        // Flag to indicate, stage is empty
+  int ready_cycle;  // Cycle rd_value (and flags) are done in, after Execute Two for a multi-cycle unit
+  int id;           // Fetch number, tells apart instructions of the same pc in a pipeline timeline
 } CPU_Stage;
 
+/* Pipeline parameters chosen at run time, set by name with APEX_config_set */
+typedef struct APEX_Config {
+  int branch_penalty; // Cycles Fetch waits after a taken branch or jump, on top of the flush
+  int mul_latency;    // Cycles till a MUL result is done, counted from Execute Two
+  int div_latency;    // Cycles till a DIV result is done, counted from Execute Two
+  int mem_latency;    // Cycles LOAD, LDR, STORE, STR spend in Memory One, with a cache cycles added by a miss to memory
+  int forwarding;     // 1 reads operands through bypass paths from EX_TWO, MEM_ONE, MEM_TWO and WB
+  int predictor;      // Branch prediction in Fetch, 0 none (not taken), 1 bimodal, 2 gshare
+  int btb_entries;    // Entries of direct mapped branch target buffer
+  int history_bits;   // Global history bits hashed into gshare counter index
+  int l1d_size;       // Bytes of L1 data cache, 0 for none
+  int l1d_assoc;      // Ways of L1 data cache
+  int l1d_latency;    // Cycles of an L1 data cache hit
+  int l2_size;        // Bytes of L2 cache behind L1, 0 for none
+  int l2_assoc;       // Ways of L2 cache
+  int l2_latency;     // Cycles added by an L1 miss that hits in L2
+  int line_size;      // Bytes of a cache line, same for both levels
+  int replacement;    // Victim of a full set, 0 LRU, 1 FIFO, 2 random
+  int write_policy;   // 0 write-back with write-allocate, 1 write-through without write-allocate
+  int l1i_size;       // Bytes of L1 instruction cache, 0 for none
+  int l1i_assoc;      // Ways of L1 instruction cache, a miss waits for L2 (shared with data) or memory
+  int engine;         // Core model, 0 the in-order 7 stage pipeline, 1 the out-of-order engine
+  int width;          // Instructions fetched, decoded and executed per cycle, a latch holds a group of them
+  int rob_size;       // Entries of the reorder buffer
+  int iq_size;        // Entries of the issue queue
+  int lsq_size;       // Entries of the load/store queue
+  int prf_size;       // Physical registers, 33 hold the committed registers and zero flag
+  int alu_units;      // Integer ALUs, MOVC, MOV, ADD, SUB, AND, OR, EX-OR and literal forms, always pipelined
+  int alu_latency;    // Cycles till an ALU result is done
+  int mul_units;      // Multipliers
+  int mul_pipelined;  // 1 a multiplier takes a new MUL every cycle, 0 only once the last one is done
+  int div_units;      // Dividers
+  int div_pipelined;  // 1 a divider takes a new DIV every cycle, 0 only once the last one is done
+} APEX_Config;
+
+/* Counters and BTB entries the predictor can index */
+#define PREDICTOR_TABLE_SIZE 4096
+
+/* Lines a cache can hold, data memory is 4096 words (16 KB) so a bigger cache is never needed */
+#define CACHE_MAX_LINES 4096
+
+/* One line of a cache, only tags are kept, data stays in data_memory */
+typedef struct APEX_Cache_Line {
+  int tag;                // line number (byte address / line_size) held in the line
+  unsigned int stamp;     // last use (LRU) or fill (FIFO) time
+  unsigned char valid;
+  unsigned char dirty;
+} APEX_Cache_Line;
+
+/* Timing model of one cache level, sets are stored one after another, ways of a set next to each other */
+typedef struct APEX_Cache {
+  APEX_Cache_Line lines[CACHE_MAX_LINES];
+  unsigned int time;      // stamp given to next access
+  unsigned int random;    // state of random replacement
+  int accesses;
+  int hits;
+  int misses;
+  int writebacks;         // dirty lines evicted to next level
+} APEX_Cache;
+
+/* Branch predictor state, tables are indexed by pc / 4 */
+typedef struct APEX_Predictor {
+  int btb_pc[PREDICTOR_TABLE_SIZE];             // pc of branch in each BTB entry, 0 if entry is empty
+  int btb_target[PREDICTOR_TABLE_SIZE];         // target of that branch when last taken
+  unsigned char counters[PREDICTOR_TABLE_SIZE]; // 2-bit saturating counters, 2 and 3 predict taken
+  unsigned int history;                         // outcomes of resolved branches, newest in bit 0
+  int branches;                                 // BZ, BNZ resolved in Execute Two
+  int mispredictions;                           // of those, fetched down the wrong path
+} APEX_Predictor;
+
+/* Kinds of functional units in Execute Two, see units.c */
+enum {
+  FU_NONE,  // LOAD, STORE, branches and HALT compute nothing on a unit
+  FU_ALU,
+  FU_MUL,
+  FU_DIV,
+  NUM_FU_KINDS
+};
+
+/* Most units of one kind */
+#define MAX_FUNCTIONAL_UNITS 8
+
+/* Occupancy and use of the functional units */
+typedef struct APEX_Units {
+  int free_cycle[NUM_FU_KINDS][MAX_FUNCTIONAL_UNITS]; // first cycle each unit takes a new operation
+  int operations[NUM_FU_KINDS];                       // operations started on units of a kind
+  int busy_cycles[NUM_FU_KINDS];                      // cycles units of a kind could not take another one
+  int stalls[NUM_FU_KINDS];                           // cycles an instruction waited for a unit of a kind
+} APEX_Units;
+
+/* Binary pipeline trace writer, see trace.c */
+typedef struct APEX_Trace APEX_Trace;
+
+/* Konata or Chrome trace timeline writer, see timeline.c */
+typedef struct APEX_Timeline APEX_Timeline;
+
+/* Stall causes of Decode/RF other than a register */
+#define STALL_FLAGS (-1)
+#define STALL_STRUCTURAL (-2)
+
+/* Performance counters not kept with the part of the model they measure, see counters.c */
+typedef struct APEX_Counters {
+  int ins_completed;                  // instructions and bubbles through writeback
+  int ins_retired;                    // instructions of the program through writeback, bubbles not counted
+  int cycles_skipped;                 // cycles advanced without calling stage functions
+  int loads;                          // LOAD, LDR through memory stages
+  int stores;                         // STORE, STR through memory stages
+  int stall_raw[REGISTER_FILE_SIZE];  // cycles Decode/RF waited on each source register
+  int stall_flags;                    // cycles BZ, BNZ waited in Decode/RF for the flags
+  int stall_halt;                     // cycles Fetch was stopped by HALT while older instructions drained
+  int stall_structural;               // cycles Fetch was held behind a stage waiting on a multi-cycle operation or Decode/RF waited for a unit
+  int stall_branch;                   // cycles Fetch waited after taken or mispredicted branches, flushed instructions are in squashed
+  int stall_memory;                   // cycles Memory One spent on cache misses beyond an L1 hit
+  int stall_icache;                   // cycles Fetch waited on instruction cache misses
+  int flushes;                        // taken or mispredicted branches flushing younger instructions
+  int squashed;                       // instructions thrown away by flushes
+  int stall_cause;                    // register Decode/RF waits on, STALL_FLAGS for the flags
+} APEX_Counters;
+
+/* Largest reorder buffer, issue queue and load/store queue of the out-of-order engine */
+#define OOO_MAX_ENTRIES 256
+
+/* Largest physical register file of the out-of-order engine */
+#define OOO_MAX_PHYS_REGS 512
+
+/* Zero flag is renamed like a register, its rename table entry follows the registers */
+#define OOO_ZF_REG REGISTER_FILE_SIZE
+
+/* Instruction in the reorder buffer, the instruction itself is read from code memory using pc */
+typedef struct APEX_ROB_Entry {
+  int pc;
+  int opcode;         // OP_EMPTY past the end of code memory
+  int state;          // waiting in issue queue, issued or done, see ooo.c
+  int src[3];         // physical registers read (rs1, rs2 or zero flag, rd of STORE, STR), -1 if unused
+  int dest;           // physical register of rd, -1 if none
+  int prev_dest;      // physical register rd was mapped to before, freed at commit
+  int flag_dest;      // physical register of zero flag, -1 if flag is not written
+  int prev_flag;
+  int done_cycle;     // clock when result is written back
+  int mem_address;    // LOAD, LDR, STORE, STR address, JUMP target
+  int store_value;    // STORE, STR value written at commit
+  int carry;          // CF written at commit by SUB, SUBL, -1 if unchanged
+  int overflow;       // OF written at commit by ADD, ADDL, -1 if unchanged
+  int taken;          // BZ, BNZ outcome
+  int next_pc;        // pc of next instruction, known once executed
+  int predicted_pc;   // pc dispatch continued at, 0 if it stopped behind a JUMP
+  int fault;          // error reported when instruction commits, see ooo.c
+} APEX_ROB_Entry;
+
+/* Out-of-order engine state, issue and load/store queues hold ROB indices oldest first */
+typedef struct APEX_OoO {
+  int started;                          // rename state built from architectural state
+  APEX_ROB_Entry rob[OOO_MAX_ENTRIES];
+  int rob_head;
+  int rob_count;
+  int iq[OOO_MAX_ENTRIES];
+  int iq_count;
+  int lsq[OOO_MAX_ENTRIES];
+  int lsq_count;
+  int rat[REGISTER_FILE_SIZE + 1];      // physical register of each register and the zero flag
+  int prf_value[OOO_MAX_PHYS_REGS];
+  unsigned char prf_ready[OOO_MAX_PHYS_REGS];
+  int free_list[OOO_MAX_PHYS_REGS];
+  int free_count;
+  int fetch_stopped;                    // HALT, JUMP or end of code dispatched, waits for commit or redirect
+  int fetch_wait;                       // cycles dispatch waits for branch penalty or I-cache line
+  long long rob_occupancy;              // entries summed over cycles
+  long long iq_occupancy;
+  int stall_rob;                        // cycles dispatch found a full structure
+  int stall_iq;
+  int stall_lsq;
+  int stall_regs;
+  int squashed;                         // instructions removed by mispredicted branches and jumps
+  int forwarded;                        // loads that took their value from an older store
+} APEX_OoO;
+
+/* Block cache counters of the x86-64 translator */
+typedef struct APEX_JIT_Stats {
+  long long hits;         // Entered a translated block, from dispatcher or chained
+  long long chained;      // Hits where a block jumped straight into the next one
+  long long misses;       // Dispatcher found no translated block
+  long long interpreted;  // Instructions executed by the interpreter instead
+  long long flushes;      // Times the code buffer filled up and was dropped
+  int blocks;             // Blocks translated
+} APEX_JIT_Stats;
+
+/* Sampling schedule, repeated until the program ends */
+typedef struct APEX_Sample_Schedule {
+  long long fast_forward; // Instructions executed functionally before each window
+  int warmup;             // Instructions simulated in the pipeline to fill it, not measured
+  int detail;             // Instructions simulated in the pipeline and measured
+} APEX_Sample_Schedule;
+
+/* Extrapolated result of sampled simulation */
+typedef struct APEX_Sample_Result {
+  long long instructions;           // Instructions of the whole program
+  long long detailed_instructions;  // Instructions measured in windows
+  int windows;                      // Windows measured
+  int dropped_windows;              // Windows where the pipeline got stuck
+  double cpi;                       // Mean CPI of the windows
+  double cpi_error;                 // Half width of 95% confidence interval of cpi
+  double cycles;                    // Estimated cycles of the whole program
+  double cycles_error;              // Half width of 95% confidence interval of cycles
+} APEX_Sample_Result;
+
+/* Bit of a stage in stage status bitmaps */
+#define STAGE_BIT(stage) (1u << (stage))
+
+/* Bits of APEX_CPU memory_access */
+#define MEMORY_READ    1
+#define MEMORY_WRITTEN 2
+
 /* Model of APEX CPU */
 typedef struct APEX_CPU {
   /* Clock cycles elasped */
@@ -78,12 +364,71 @@ typedef struct APEX_CPU {
   /* Current program counter */
   int pc;
 
+  /* Simulation output, stdout unless a batch run captures it */
+  FILE* out;
+
+  /* No per cycle prints, lets APEX_cpu_run skip cycles where only stalls drain */
+  int quiet;
+
+  /* Functional execution also trains caches and branch predictor, set while sampled runs fast-forward */
+  int warming;
+
+  /* APEX_cpu_run writes a checkpoint to checkpoint_file when clock reaches checkpoint_cycle, NULL for none */
+  int checkpoint_cycle;
+  const char* checkpoint_file;
+
+  /* 7 CPU_stage latches per lane, each latch holds a group of up to config.width instructions in program order, lane 0 oldest.
+   * Lane major so the 7 latches of lane 0, all a width 1 run uses, sit together */
+  CPU_Stage stage[MAX_ISSUE_WIDTH][NUM_STAGES]; // Note: use . in struct with variable names, use -> when its a pointer
+  int group_size[NUM_STAGES];   // lanes of each latch in use, a bubble or empty stage has 1
+  int group_split;              // lanes of the Decode/RF group moving on alone this cycle, the rest stay behind them
+  int unit_wait;                // Decode/RF waits for a functional unit this cycle, looked at again next cycle
+
+  /* Status of stages, one STAGE_BIT per stage */
+  unsigned int busy;      // stage is performing some action
+  unsigned int stalled;   // stage is stalled
+  unsigned int executed;  // stage has executed in current cycle
+  unsigned int empty;     // stage is empty
+  unsigned int bubble;    // stage holds a Bubble (NOP) in place of its instruction
+  unsigned int predicted; // stage holds a branch Fetch predicted taken, instructions after it come from its target
+  unsigned int waiting;   // stage holds its latch for a multi-cycle operation, earlier stages hold too
+
+  /* Cycles left for each waiting stage */
+  int wait_cycles[NUM_STAGES];
+
+  /* Pipeline parameters */
+  APEX_Config config;
+
+  /* Branch predictor used by Fetch */
+  APEX_Predictor predictor;
+
+  /* Caches, L1 data accessed in Memory One, L1 instruction in Fetch, L2 behind both */
+  APEX_Cache l1d;
+  APEX_Cache l1i;
+  APEX_Cache l2;
+  int icache_pending;   // pc whose line arrives once Fetch stops waiting, fetched without another lookup, 0 for none
+
+  /* Functional units of Execute Two */
+  APEX_Units units;
+
+  /* Binary trace of every cycle, NULL when not tracing */
+  APEX_Trace* trace;
+
+  /* Pipeline timeline of every instruction, NULL when not exported */
+  APEX_Timeline* timeline;
+
+  /* Performance counters */
+  APEX_Counters counters;
+
+  /* Out-of-order engine, used in place of the stages when config.engine is 1 */
+  APEX_OoO ooo;
+
   /* Integer register file */
   int regs[REGISTER_FILE_SIZE];
-  int regs_invalid[REGISTER_FILE_SIZE];
 
-  /* Array of 5 CPU_stage */
-  CPU_Stage stage[NUM_STAGES]; // array of 5 CPU_Stage struct. Note: use . in struct with variable names, use -> when its a pointer
+  /* Scoreboard, registers written by the group in each stage and those with a write in flight */
+  unsigned int dest_masks[NUM_STAGES];
+  unsigned int regs_pending;
 
   /* Code Memory where instructions are stored */
   APEX_Instruction* code_memory;  // APEX_Instruction struct pointer code_memory
@@ -92,18 +437,134 @@ typedef struct APEX_CPU {
 
   int code_memory_size;
 
+  /* Mapping of pre-assembled program image code memory points into, NULL if parsed from text */
+  void* program_image;
+  size_t program_image_size;
+
+  /* Input file code memory was created from, recorded in checkpoints */
+  const char* program_file;
+
   /* Data Memory */
   int data_memory[DATA_MEMORY_SIZE];
 
+  /* MEMORY_READ / MEMORY_WRITTEN bits of each location in current quantum of a multi-core run, NULL otherwise */
+  unsigned char* memory_access;
+
   /* Some stats */
-  int ins_completed;
+  int ins_fetched;      // instructions put in the Fetch latch, last id given to one
 
 } APEX_CPU;
 
 APEX_Instruction* create_code_memory(const char* filename, int* size);
 
+int is_valid_instruction(const APEX_Instruction* ins);
+
+const char* get_opcode_name(int opcode);
+
+int is_program_image(const char* filename);
+
+int write_program_image(const char* filename, const APEX_Instruction* code_memory, int code_memory_size,
+                        const int* data_memory, int data_memory_size);
+
+int load_program_image(APEX_CPU* cpu, const char* filename);
+
+int write_program_c(const char* filename, const char* source_name,
+                    const APEX_Instruction* code_memory, int code_memory_size);
+
+void unload_program_image(APEX_CPU* cpu);
+
+int write_checkpoint(const APEX_CPU* cpu, const char* filename);
+
+int load_checkpoint(APEX_CPU* cpu, const char* filename);
+
 APEX_CPU* APEX_cpu_init(const char* filename);
 
+APEX_CPU* APEX_cpu_create(const char* filename, FILE* out);
+
+APEX_CPU* APEX_cpu_clone(const APEX_CPU* cpu);
+
+void APEX_config_default(APEX_Config* config);
+
+int APEX_config_set(APEX_Config* config, const char* name, int value);
+
+int APEX_config_parse(APEX_Config* config, const char* assignments);
+
+int APEX_config_get(const APEX_Config* config, const char* name, int* value);
+
+int APEX_config_num_params(void);
+
+const char* APEX_config_param_name(int index);
+
+int predict_branch(APEX_CPU* cpu, int pc, int* target);
+
+void train_predictor(APEX_CPU* cpu, int pc, int taken, int target);
+
+void print_branch_stats(APEX_CPU* cpu);
+
+int access_data_cache(APEX_CPU* cpu, int address, int write);
+
+int access_instruction_cache(APEX_CPU* cpu, int pc);
+
+void print_cache_stats(APEX_CPU* cpu);
+
+int get_unit_kind(int opcode);
+
+int unit_available(APEX_CPU* cpu, int lane);
+
+int unit_free(APEX_CPU* cpu, int opcode);
+
+int start_unit(APEX_CPU* cpu, int opcode);
+
+void print_unit_stats(APEX_CPU* cpu);
+
+int APEX_counter_get(const APEX_CPU* cpu, const char* name, int* value);
+
+int APEX_counter_num(void);
+
+const char* APEX_counter_name(int index);
+
+void count_data_stall(APEX_CPU* cpu, int cycles);
+
+void print_perf_counters(APEX_CPU* cpu);
+
+int APEX_trace_open(APEX_CPU* cpu, const char* filename);
+
+void APEX_trace_close(APEX_CPU* cpu);
+
+void trace_cycle(APEX_CPU* cpu);
+
+void trace_stage(APEX_CPU* cpu, int stage_index);
+
+void trace_register_write(APEX_CPU* cpu, int reg_number, int value);
+
+void trace_stall(APEX_CPU* cpu, int cause);
+
+void trace_flush(APEX_CPU* cpu, int target, int squashed);
+
+int APEX_trace_decode(const char* filename, FILE* out, int show_events);
+
+int APEX_timeline_open(APEX_CPU* cpu, const char* filename);
+
+void APEX_timeline_close(APEX_CPU* cpu);
+
+void timeline_cycle(APEX_CPU* cpu);
+
+int APEX_ooo_cycle(APEX_CPU* cpu);
+
+void print_ooo_stats(APEX_CPU* cpu);
+
+void APEX_cpu_reset_pipeline(APEX_CPU* cpu);
+
+int get_code_index(int pc);
+
+const APEX_Instruction* get_stage_instruction(APEX_CPU* cpu, int stage_index);
+
+const APEX_Instruction* get_lane_instruction(APEX_CPU* cpu, int stage_index, int lane);
+
+int get_group_size(const APEX_CPU* cpu, int stage_index);
+
+void print_instruction(FILE* out, const APEX_Instruction* ins);
+
 int previous_arithmetic_check(APEX_CPU* cpu);
 
 int simulate(APEX_CPU* cpu, int num_cycle);
@@ -114,6 +575,34 @@ void print_cpu_content(APEX_CPU* cpu);
 
 int APEX_cpu_run(APEX_CPU* cpu, int num_cycle);
 
+int APEX_cpu_run_until(APEX_CPU* cpu, int end_cycle);
+
+int APEX_cpu_run_window(APEX_CPU* cpu, int warmup, int detail, int max_cycles, int* cycles, int* instructions);
+
+int APEX_cpu_execute_functional(APEX_CPU* cpu, long long max_instructions, long long* executed);
+
+int APEX_cpu_run_functional(APEX_CPU* cpu, int num_instructions);
+
+int APEX_cpu_execute_sampled(APEX_CPU* cpu, const APEX_Sample_Schedule* schedule, APEX_Sample_Result* result);
+
+int APEX_cpu_run_sampled(APEX_CPU* cpu, const APEX_Sample_Schedule* schedule);
+
+int APEX_cpu_run_multicore(const char* const* programs, int num_cores, int quantum, int num_cycle);
+
+int APEX_cpu_run_batch(const char* manifest, const char* results_file, int num_threads);
+
+void APEX_run_parallel(int num_jobs, int num_threads, void (*run_job)(void* arg, int job), void* arg);
+
+int APEX_cpu_run_sweep(const char* const* workloads, int num_workloads, const char* grid,
+                       int random_points, int max_cycles, int num_threads, const char* csv_file);
+
+int APEX_cpu_run_bench(const char* const* workloads, int num_workloads, const char* config, int repeat,
+                       const char* csv_file);
+
+int APEX_cpu_execute_jit(APEX_CPU* cpu, long long max_instructions, long long* executed, APEX_JIT_Stats* stats);
+
+int APEX_cpu_run_jit(APEX_CPU* cpu, int num_instructions);
+
 void APEX_cpu_stop(APEX_CPU* cpu);
 
 int fetch(APEX_CPU* cpu);
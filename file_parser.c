@@ -10,233 +10,366 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "cpu.h"
 
+/* Input files bigger than this are split into chunks parsed on multiple threads */
+#define PARALLEL_PARSE_THRESHOLD (4 << 20)
+#define MAX_PARSE_THREADS 16
+
+/* Max number of comma separated tokens in a line, opcode and 3 operands */
+#define MAX_TOKENS 6
+
 /*
  * This function is related to parsing input file
- *
- * Note : You are not supposed to edit this function
+ * Token is a register (R5) or literal (#-12), first character is skipped
+ * and the rest is read like atoi does
  */
-static int get_num_from_string(char* buffer) {
+static int get_num_from_token(const char* token, const char* end) {
 
-  char str[16];
-  int j = 0;
-  for (int i = 1; buffer[i] != '\0'; ++i) {
-    str[j] = buffer[i];
-    j++;
+  const char* p = token + 1;
+  while ((p < end) && isspace((unsigned char)*p)) {
+    p++;
   }
-  str[j] = '\0';
-  return atoi(str);
+  int negative = 0;
+  if ((p < end) && ((*p == '-') || (*p == '+'))) {
+    negative = (*p == '-');
+    p++;
+  }
+  int value = 0;
+  while ((p < end) && (*p >= '0') && (*p <= '9')) {
+    value = value * 10 + (*p - '0');
+    p++;
+  }
+  return negative ? -value : value;
+}
+
+static unsigned int get_register_bit(int reg_number) {
+  // Scoreboard bit of a register, a number outside the register file has none
+  return ((reg_number >= 0) && (reg_number < REGISTER_FILE_SIZE)) ? (1u << reg_number) : 0;
 }
+
 /*
- * To remove \n \r from instruction
+ * Mnemonic and operand format of every instruction, indexed by opcode
+ *
+ * Note : you can edit this table to add new instructions
  */
-static char* remove_escape_sequences(char* buffer) {
+static const struct {
+  const char* name;
+  int format;
+} opcode_table[NUM_OPCODES] = {
+  [OP_STORE] = {"STORE", FMT_RD_RS1_IMM}, // here rd is source and Mem[rs1 + imm] is destination
+  [OP_STR]   = {"STR",   FMT_RD_RS1_RS2}, // here rd is source and Mem[rs1 + rs2] is destination
+  [OP_LOAD]  = {"LOAD",  FMT_RD_RS1_IMM}, // here rd is destination and Mem[rs1 + imm] is source
+  [OP_LDR]   = {"LDR",   FMT_RD_RS1_RS2}, // here rd is destination and Mem[rs1 + rs2] is source
+  [OP_MOVC]  = {"MOVC",  FMT_RD_IMM},     // this is MOV Constant to Register
+  [OP_MOV]   = {"MOV",   FMT_RD_RS1},     // this is MOV One Register value to other Register
+  [OP_ADD]   = {"ADD",   FMT_RD_RS1_RS2},
+  [OP_ADDL]  = {"ADDL",  FMT_RD_RS1_IMM},
+  [OP_SUB]   = {"SUB",   FMT_RD_RS1_RS2},
+  [OP_SUBL]  = {"SUBL",  FMT_RD_RS1_IMM},
+  [OP_MUL]   = {"MUL",   FMT_RD_RS1_RS2},
+  [OP_DIV]   = {"DIV",   FMT_RD_RS1_RS2},
+  [OP_AND]   = {"AND",   FMT_RD_RS1_RS2},
+  [OP_OR]    = {"OR",    FMT_RD_RS1_RS2},
+  [OP_EXOR]  = {"EX-OR", FMT_RD_RS1_RS2},
+  [OP_BZ]    = {"BZ",    FMT_IMM},        // Variation 1 only literal, relative to pc of branch
+  [OP_BNZ]   = {"BNZ",   FMT_IMM},        // Variation 1 only literal, relative to pc of branch
+  [OP_JUMP]  = {"JUMP",  FMT_RS1_IMM},    // here jump location is giving by addidng rs1 + imm
+  [OP_HALT]  = {"HALT",  FMT_NONE},
+  [OP_NOP]   = {"NOP",   FMT_NONE},
+  [OP_EMPTY] = {"",      FMT_NONE},
+};
 
-  char array[strlen(buffer)];
-  for (int i=0; i<strlen(buffer);i++){
-    array[i] = buffer[i];
+const char* get_opcode_name(int opcode) {
+  // Returns mnemonic of opcode, used while printing instructions
+  if ((opcode < 0) || (opcode >= NUM_OPCODES)) {
+    return "";
   }
-  int r = strcspn(array, "\r");
-  int n = strcspn(array, "\n");
-  if (r < n) {
-    array[strcspn(array, "\r")] = '\0';
+  return opcode_table[opcode].name;
+}
+
+/*
+ * Look up opcode for a mnemonic, trailing \r is ignored
+ * Returns -1 if mnemonic is not a valid instruction
+ */
+static int get_opcode_from_token(const char* token, const char* end) {
+
+  const char* cr = memchr(token, '\r', end - token);
+  size_t len = (cr ? cr : end) - token;
+  for (int i = 0; i < OP_EMPTY; ++i) {
+    if ((opcode_table[i].name[0] == token[0]) &&
+        (strlen(opcode_table[i].name) == len) && (memcmp(opcode_table[i].name, token, len) == 0)) {
+      return i;
+    }
   }
-  else {
-    array[strcspn(array, "\n")] = '\0';
+  return -1;
+}
+
+static void set_register_masks(APEX_Instruction* ins) {
+  // registers read and written, so the scoreboard checks an instruction with a single AND
+  ins->src_mask = ins->dest_mask = 0;
+  switch (ins->format) {
+    case FMT_RD_RS1_IMM:
+    case FMT_RD_RS1_RS2:
+      ins->src_mask = get_register_bit(ins->rs1);
+      if (ins->format == FMT_RD_RS1_RS2) {
+        ins->src_mask |= get_register_bit(ins->rs2);
+      }
+      if ((ins->opcode == OP_STORE) || (ins->opcode == OP_STR)) {
+        ins->src_mask |= get_register_bit(ins->rd); // STORE and STR read rd as well
+      }
+      else {
+        ins->dest_mask = get_register_bit(ins->rd);
+      }
+      break;
+    case FMT_RD_IMM:
+      ins->dest_mask = get_register_bit(ins->rd);
+      break;
+    case FMT_RD_RS1:
+      ins->src_mask = get_register_bit(ins->rs1);
+      ins->dest_mask = get_register_bit(ins->rd);
+      break;
+    case FMT_RS1_IMM:
+      ins->src_mask = get_register_bit(ins->rs1);
+      break;
+    default:
+      ; // BZ, BNZ only read flags, nothing for HALT and NOP
   }
-  buffer = array;
-  return buffer;
 }
 
 /*
  * This function is related to parsing input file
+ * Line is [line, end) without its \n, tokens are split on ',' in place
  *
  * Note : you can edit this function to add new instructions
  */
-static void create_APEX_instruction(APEX_Instruction* ins, char* buffer) {
+static void create_APEX_instruction(APEX_Instruction* ins, const char* line, const char* end) {
 
-  if (RUNNING_IN_WINDOWS) {
-    buffer = remove_escape_sequences(buffer); // NOTE: This function should only be used while running in windows
-  }
-  char* token = strtok(buffer, ",");
+  const char* tokens[MAX_TOKENS];
+  const char* token_ends[MAX_TOKENS];
   int token_num = 0;
-  char tokens[6][128];
-  while (token != NULL) {
-    strcpy(tokens[token_num], token);
-    // strcpy(tokens[token_num], remove_escape_sequences(token));
-    token_num++;
-    token = strtok(NULL, ",");
-  }
-
-  strcpy(ins->opcode, tokens[0]);
-
-  // for STORE instruction
-  if (strcmp(ins->opcode, "STORE") == 0) {
-    ins->rd = get_num_from_string(tokens[1]); // here rs1 is source and Mem[rs2 + imm] is destination
-    ins->rs1 = get_num_from_string(tokens[2]);
-    ins->imm = get_num_from_string(tokens[3]);
-  }
-  // for STR instruction
-  else if (strcmp(ins->opcode, "STR") == 0) {
-    ins->rd = get_num_from_string(tokens[1]); // here rd is source and Mem[rs1 + rs2] is destination
-    ins->rs1 = get_num_from_string(tokens[2]);
-    ins->rs2 = get_num_from_string(tokens[3]);
-  }
-  // for LOAD instruction
-  else if (strcmp(ins->opcode, "LOAD") == 0) {
-    ins->rd = get_num_from_string(tokens[1]); // here rd is destination and Mem[rs1 + imm] is source
-    ins->rs1 = get_num_from_string(tokens[2]);
-    ins->imm = get_num_from_string(tokens[3]);
-  }
-  // for LDR instruction
-  else if (strcmp(ins->opcode, "LDR") == 0) {
-    ins->rd = get_num_from_string(tokens[1]); // here rd is destination and Mem[rs1 + rs2] is source
-    ins->rs1 = get_num_from_string(tokens[2]);
-    ins->rs2 = get_num_from_string(tokens[3]);
-  }
-  // for MOVC instruction
-  else if (strcmp(ins->opcode, "MOVC") == 0) {
-    ins->rd = get_num_from_string(tokens[1]); // this is MOV Constant to Register
-    ins->imm = get_num_from_string(tokens[2]);
-  }
-  // for MOV instruction
-  else if (strcmp(ins->opcode, "MOV") == 0) {
-    ins->rd = get_num_from_string(tokens[1]); // this is MOV One Register value to other Register
-    ins->rs1 = get_num_from_string(tokens[2]);
-  }
-  // for ADD instruction
-  else if (strcmp(ins->opcode, "ADD") == 0) {
-    ins->rd = get_num_from_string(tokens[1]);
-    ins->rs1 = get_num_from_string(tokens[2]);
-    ins->rs2 = get_num_from_string(tokens[3]);
-  }
-  // for ADDL instruction
-  else if (strcmp(ins->opcode, "ADDL") == 0) {
-    ins->rd = get_num_from_string(tokens[1]);
-    ins->rs1 = get_num_from_string(tokens[2]);
-    ins->imm = get_num_from_string(tokens[3]);
-  }
-  // for SUB instruction
-  else if (strcmp(ins->opcode, "SUB") == 0) {
-    ins->rd = get_num_from_string(tokens[1]);
-    ins->rs1 = get_num_from_string(tokens[2]);
-    ins->rs2 = get_num_from_string(tokens[3]);
-  }
-  // for SUBL instruction
-  else if (strcmp(ins->opcode, "SUBL") == 0) {
-    ins->rd = get_num_from_string(tokens[1]);
-    ins->rs1 = get_num_from_string(tokens[2]);
-    ins->imm = get_num_from_string(tokens[3]);
-  }
-  // for MUL instruction
-  else if (strcmp(ins->opcode, "MUL") == 0) {
-    ins->rd = get_num_from_string(tokens[1]);
-    ins->rs1 = get_num_from_string(tokens[2]);
-    ins->rs2 = get_num_from_string(tokens[3]);
-  }
-  // for DIV instruction
-  else if (strcmp(ins->opcode, "DIV") == 0) {
-    ins->rd = get_num_from_string(tokens[1]);
-    ins->rs1 = get_num_from_string(tokens[2]);
-    ins->rs2 = get_num_from_string(tokens[3]);
-  }
-  // for AND instruction
-  else if (strcmp(ins->opcode, "AND") == 0) {
-    ins->rd = get_num_from_string(tokens[1]);
-    ins->rs1 = get_num_from_string(tokens[2]);
-    ins->rs2 = get_num_from_string(tokens[3]);
-  }
-  // for OR instruction
-  else if (strcmp(ins->opcode, "OR") == 0) {
-    ins->rd = get_num_from_string(tokens[1]);
-    ins->rs1 = get_num_from_string(tokens[2]);
-    ins->rs2 = get_num_from_string(tokens[3]);
-  }
-  // for EX-OR instruction
-  else if (strcmp(ins->opcode, "EX-OR") == 0) {
-    ins->rd = get_num_from_string(tokens[1]);
-    ins->rs1 = get_num_from_string(tokens[2]);
-    ins->rs2 = get_num_from_string(tokens[3]);
-  }
-  // for BZ instruction Variation 1 only literal
-  else if (strcmp(ins->opcode, "BZ") == 0) {
-    ins->imm = get_num_from_string(tokens[1]); // while executing our pc starts from 4000 so keep a relative index. // get_code_index() can be used with modifications
-  }
-  // for BNZ instruction Variation 1 only literal
-  else if (strcmp(ins->opcode, "BNZ") == 0) {
-    ins->imm = get_num_from_string(tokens[1]); // while executing our pc starts from 4000 so keep a relative index. // get_code_index() can be used with modifications
-  }
-  else if (strcmp(ins->opcode, "JUMP") == 0) {
-    ins->rs1 = get_num_from_string(tokens[1]); // while executing our pc starts from 4000 so keep a relative index. // get_code_index() can be used with modifications
-    ins->imm = get_num_from_string(tokens[2]); // here jump location is giving by addidng rs1 + imm
-  }
-  else if (strcmp(ins->opcode, "HALT") == 0) {
-    ; // do nothing
-  }
-  else if (strcmp(ins->opcode, "NOP") == 0) {
-    ; // do nothing
-  }
-  else {
-    if (strcmp(ins->opcode, "HALT\n") == 0){
-      strcpy(ins->opcode, "HALT");
+  const char* p = line;
+  while ((p < end) && (token_num < MAX_TOKENS)) {
+    const char* comma = memchr(p, ',', end - p);
+    const char* token_end = comma ? comma : end;
+    if (token_end > p) {
+      // empty tokens are skipped, same as strtok
+      tokens[token_num] = p;
+      token_ends[token_num] = token_end;
+      token_num++;
     }
-    else if (strcmp(ins->opcode, "NOP\n") == 0){
-      strcpy(ins->opcode, "NOP");
-    }
-    else if (strcmp(ins->opcode, "") != 0) {
-      fprintf(stderr, "Invalid Instruction Found!\n");
-      fprintf(stderr, "Replacing %s with %s Instruction\n", ins->opcode, "NOP");
-      strcpy(ins->opcode, "NOP");
+    p = token_end + 1;
+  }
+  for (int i = token_num; i < MAX_TOKENS; ++i) {
+    // missing operands read as zero
+    tokens[i] = token_ends[i] = end;
+  }
+
+  memset(ins, 0, sizeof(*ins)); // operands not used by the format are kept zero
+  if (!token_num) {
+    ins->opcode = OP_EMPTY;
+    ins->format = opcode_table[OP_EMPTY].format;
+    return;
+  }
+
+  int opcode = get_opcode_from_token(tokens[0], token_ends[0]);
+  if (opcode < 0) {
+    fprintf(stderr, "Invalid Instruction Found!\n");
+    fprintf(stderr, "Replacing %.*s with %s Instruction\n", (int)(token_ends[0] - tokens[0]), tokens[0], "NOP");
+    opcode = OP_NOP;
+  }
+  ins->opcode = opcode;
+  ins->format = opcode_table[opcode].format;
+
+  // operands are decoded once here, stages only look at opcode and format
+  switch (ins->format) {
+    case FMT_RD_RS1_IMM:
+      ins->rd = get_num_from_token(tokens[1], token_ends[1]);
+      ins->rs1 = get_num_from_token(tokens[2], token_ends[2]);
+      ins->imm = get_num_from_token(tokens[3], token_ends[3]);
+      break;
+    case FMT_RD_RS1_RS2:
+      ins->rd = get_num_from_token(tokens[1], token_ends[1]);
+      ins->rs1 = get_num_from_token(tokens[2], token_ends[2]);
+      ins->rs2 = get_num_from_token(tokens[3], token_ends[3]);
+      break;
+    case FMT_RD_IMM:
+      ins->rd = get_num_from_token(tokens[1], token_ends[1]);
+      ins->imm = get_num_from_token(tokens[2], token_ends[2]);
+      break;
+    case FMT_RD_RS1:
+      ins->rd = get_num_from_token(tokens[1], token_ends[1]);
+      ins->rs1 = get_num_from_token(tokens[2], token_ends[2]);
+      break;
+    case FMT_IMM:
+      ins->imm = get_num_from_token(tokens[1], token_ends[1]); // while executing our pc starts from 4000 so keep a relative index
+      break;
+    case FMT_RS1_IMM:
+      ins->rs1 = get_num_from_token(tokens[1], token_ends[1]);
+      ins->imm = get_num_from_token(tokens[2], token_ends[2]);
+      break;
+    default:
+      ; // do nothing for HALT and NOP
+  }
+
+  set_register_masks(ins);
+}
+
+int is_valid_instruction(const APEX_Instruction* ins) {
+  // Instruction the parser could have decoded, code memory read from a program image is checked with it
+  if ((ins->opcode < 0) || (ins->opcode >= NUM_OPCODES) || (ins->format != opcode_table[ins->opcode].format)) {
+    return 0;
+  }
+  if (!has_valid_regs(ins)) {
+    return 0;
+  }
+  APEX_Instruction decoded = *ins;
+  set_register_masks(&decoded);
+  return (decoded.src_mask == ins->src_mask) && (decoded.dest_mask == ins->dest_mask);
+}
+
+/* Part of input file parsed by one thread into its own growable code array */
+typedef struct Code_Chunk {
+  const char* begin;              // first character, always start of a line
+  const char* end;                // one past last character
+  APEX_Instruction* code_memory;  // instructions parsed so far
+  int size;                       // number of instructions parsed
+  int capacity;                   // number of instructions code_memory can hold
+  int failed;                     // set if code_memory could not grow
+} Code_Chunk;
+
+static void* parse_chunk(void* arg) {
+  // One pass over the chunk, every line (also an empty one) becomes an instruction
+  Code_Chunk* chunk = arg;
+  const char* p = chunk->begin;
+  while (p < chunk->end) {
+    if (chunk->size == chunk->capacity) {
+      int capacity = chunk->capacity ? chunk->capacity * 2 : 1024;
+      APEX_Instruction* code_memory = realloc(chunk->code_memory, sizeof(*code_memory) * capacity);
+      if (!code_memory) {
+        chunk->failed = 1;
+        return NULL;
+      }
+      chunk->code_memory = code_memory;
+      chunk->capacity = capacity;
     }
+    const char* eol = memchr(p, '\n', chunk->end - p);
+    const char* line_end = eol ? eol : chunk->end;
+    create_APEX_instruction(&chunk->code_memory[chunk->size], p, line_end);
+    chunk->size++;
+    p = line_end + 1;
   }
+  return NULL;
+}
+
+static int get_num_parse_threads(size_t file_size) {
+  // Small files are parsed on calling thread only
+  if (file_size < PARALLEL_PARSE_THRESHOLD) {
+    return 1;
+  }
+  long cores = sysconf(_SC_NPROCESSORS_ONLN);
+  long chunks = file_size / (PARALLEL_PARSE_THRESHOLD / 4);
+  long threads = (cores < chunks) ? cores : chunks;
+  if (threads > MAX_PARSE_THREADS) {
+    threads = MAX_PARSE_THREADS;
+  }
+  return (threads > 1) ? (int)threads : 1;
 }
 
 /*
  * This function is related to parsing input file
- *
- * Note : You are not supposed to edit this function
+ * File is mapped and read once, big files are split at line boundaries
+ * and the chunks are parsed in parallel, then joined in order
  */
 APEX_Instruction* create_code_memory(const char* filename, int* size) {
 
+  *size = 0;
   if (!filename) {
     return NULL;
   }
 
-  FILE* fp = fopen(filename, "r");
-  if (!fp) {
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0) {
     return NULL;
   }
-
-  char* line = NULL; // the address of the first character position where the input string will be stored.
-  size_t len = 0; // size_t is an unsigned integral data type
-  ssize_t nread; // ssize_t same as size_t but signed
-  int code_memory_size = 0; // for number of lines in a input files
-
-  while ((nread = getline(&line, &len, fp)) != -1) {
-    code_memory_size++;
+  struct stat st;
+  if ((fstat(fd, &st) != 0) || (st.st_size == 0)) {
+    close(fd); // no lines in input file
+    return NULL;
   }
-  *size = code_memory_size;
-  if (!code_memory_size) {
-    fclose(fp);
+  size_t file_size = st.st_size;
+  const char* text = mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (text == MAP_FAILED) {
     return NULL;
   }
+  madvise((void*)text, file_size, MADV_SEQUENTIAL);
 
-  APEX_Instruction* code_memory = malloc(sizeof(*code_memory) * code_memory_size);  // APEX_Instruction struct pointer code_memory
-  if (!code_memory) {
-    fclose(fp);
-    return NULL;
+  Code_Chunk chunks[MAX_PARSE_THREADS];
+  pthread_t threads[MAX_PARSE_THREADS];
+  int num_chunks = get_num_parse_threads(file_size);
+  memset(chunks, 0, sizeof(chunks));
+  const char* begin = text;
+  const char* text_end = text + file_size;
+  for (int i = 0; i < num_chunks; ++i) {
+    // move chunk end forward to the start of next line
+    const char* end = (i == num_chunks - 1) ? text_end : text + file_size / num_chunks * (i + 1);
+    if (end < begin) {
+      end = begin;
+    }
+    const char* eol = (end < text_end) ? memchr(end, '\n', text_end - end) : NULL;
+    end = eol ? eol + 1 : text_end;
+    chunks[i].begin = begin;
+    chunks[i].end = end;
+    begin = end;
   }
 
-  rewind(fp); // fb is not closed yet, rewind sets the file position to the beginning of the file
-  int current_instruction = 0;
-  while ((nread = getline(&line, &len, fp)) != -1) {
-    create_APEX_instruction(&code_memory[current_instruction], line);
-    current_instruction++;
+  // chunk 0 is parsed on calling thread, others get a thread each
+  int num_threads = 1;
+  for (int i = 1; i < num_chunks; ++i) {
+    if (pthread_create(&threads[i], NULL, parse_chunk, &chunks[i]) != 0) {
+      break;
+    }
+    num_threads++;
+  }
+  parse_chunk(&chunks[0]);
+  for (int i = 1; i < num_threads; ++i) {
+    pthread_join(threads[i], NULL);
+  }
+  for (int i = num_threads; i < num_chunks; ++i) {
+    parse_chunk(&chunks[i]); // thread could not be created, parse here
   }
+  munmap((void*)text, file_size);
 
-  free(line);
-  fclose(fp);
+  // join chunks in order into the code memory of chunk 0
+  int code_memory_size = 0;
+  int failed = 0;
+  for (int i = 0; i < num_chunks; ++i) {
+    code_memory_size += chunks[i].size;
+    failed |= chunks[i].failed;
+  }
+  APEX_Instruction* code_memory = NULL;
+  if (!failed && code_memory_size) {
+    code_memory = realloc(chunks[0].code_memory, sizeof(*code_memory) * code_memory_size);
+  }
+  if (code_memory) {
+    chunks[0].code_memory = NULL;
+    int current_instruction = chunks[0].size;
+    for (int i = 1; i < num_chunks; ++i) {
+      memcpy(&code_memory[current_instruction], chunks[i].code_memory, sizeof(*code_memory) * chunks[i].size);
+      current_instruction += chunks[i].size;
+    }
+    *size = code_memory_size;
+  }
+  for (int i = 0; i < num_chunks; ++i) {
+    free(chunks[i].code_memory);
+  }
   return code_memory;
 }
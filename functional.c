@@ -0,0 +1,239 @@
+/*
+ *  functional.c
+ *  Contains fast functional (ISA only) execution of APEX programs,
+ *  instructions run one after another over decoded code memory
+ *  without modeling the pipeline stages
+ *
+ *  Author :
+ *  Sagar Vishwakarma (svishwa2@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+
+#include "cpu.h"
+
+/* Set this flag to 1 to print every instruction as it executes */
+#define ENABLE_FUNCTIONAL_TRACE 0
+
+static int check_regs(const APEX_Instruction* ins, int pc) {
+  // Registers used by the format must be inside the register file
+  int valid = has_valid_regs(ins);
+  if (!valid) {
+    fprintf(stderr, "Segmentation fault for Register location in %s at pc(%d)\n", get_opcode_name(ins->opcode), pc);
+  }
+  return valid;
+}
+
+static void warm_model(APEX_CPU* cpu, const APEX_Instruction* ins, int pc, int mem_address, int next_pc,
+                       int* fetch_line) {
+  // Caches and branch predictor see the accesses the pipeline would make, timing they return is not used
+  const APEX_Config* config = &cpu->config;
+  if (config->l1i_size && (pc / config->line_size != *fetch_line)) {
+    *fetch_line = pc / config->line_size;
+    access_instruction_cache(cpu, pc);
+  }
+  int store = (ins->opcode == OP_STORE) || (ins->opcode == OP_STR);
+  if (config->l1d_size && (store || (ins->opcode == OP_LOAD) || (ins->opcode == OP_LDR)) && is_valid_mem(mem_address)) {
+    access_data_cache(cpu, mem_address, store);
+  }
+  if ((ins->opcode == OP_BZ) || (ins->opcode == OP_BNZ)) {
+    train_predictor(cpu, pc, next_pc != pc + 4, pc + ins->imm);
+  }
+}
+
+int APEX_cpu_execute_functional(APEX_CPU* cpu, long long max_instructions, long long* executed) {
+  // Executes up to max_instructions (0 = no limit) from cpu->pc
+  // Returns HALT, EMPTY or ERROR when program stops, SUCCESS when limit is reached
+  const APEX_Instruction* code_memory = cpu->code_memory;
+  int code_memory_size = cpu->code_memory_size;
+  int* regs = cpu->regs;
+  int* flags = cpu->flags;
+  int* data_memory = cpu->data_memory;
+  int index = get_code_index(cpu->pc);
+  long long count = 0;
+  int ret = SUCCESS;
+  int warming = cpu->warming;
+  int fetch_line = -1;
+
+  while (ret == SUCCESS) {
+    if (max_instructions && (count == max_instructions)) {
+      break;
+    }
+    if ((index < 0) || (index >= code_memory_size)) {
+      ret = EMPTY; // No More Instructions
+      break;
+    }
+    const APEX_Instruction* ins = &code_memory[index];
+    int pc = 4000 + 4 * index;
+    if (!check_regs(ins, pc)) {
+      ret = ERROR;
+      break;
+    }
+    if (ENABLE_FUNCTIONAL_TRACE) {
+      fprintf(cpu->out, "pc(%d) %s,%d,%d,%d,#%d\n", pc, get_opcode_name(ins->opcode), ins->rd, ins->rs1, ins->rs2, ins->imm);
+    }
+    index++;
+    count++;
+
+    int rs1_value = regs[ins->rs1];
+    int rs2_value = regs[ins->rs2];
+    int mem_address = 0;
+    switch (ins->opcode) {
+      case OP_STORE:
+        mem_address = rs1_value + ins->imm;
+        if (is_valid_mem(mem_address)) {
+          data_memory[mem_address] = regs[ins->rd];
+        }
+        else {
+          fprintf(stderr, "Segmentation fault for writing memory location :: %d\n", mem_address);
+        }
+        break;
+      case OP_STR:
+        mem_address = rs1_value + rs2_value;
+        if (is_valid_mem(mem_address)) {
+          data_memory[mem_address] = regs[ins->rd];
+        }
+        else {
+          fprintf(stderr, "Segmentation fault for writing memory location :: %d\n", mem_address);
+        }
+        break;
+      case OP_LOAD:
+      case OP_LDR:
+        mem_address = rs1_value + ((ins->opcode == OP_LOAD) ? ins->imm : rs2_value);
+        if (is_valid_mem(mem_address)) {
+          regs[ins->rd] = data_memory[mem_address];
+        }
+        else {
+          // like the pipeline, latch value 0 is written back
+          fprintf(stderr, "Segmentation fault for accessing memory location :: %d\n", mem_address);
+          regs[ins->rd] = 0;
+        }
+        break;
+      case OP_MOVC:
+        regs[ins->rd] = ins->imm;
+        break;
+      case OP_MOV:
+        regs[ins->rd] = rs1_value;
+        break;
+      case OP_ADDL:
+        rs2_value = ins->imm;
+        /* fall through */
+      case OP_ADD:
+        // on overflow the pipeline keeps result 0 from the latch
+        if ((rs2_value > 0 && rs1_value > INT_MAX - rs2_value) ||
+          (rs2_value < 0 && rs1_value < INT_MIN - rs2_value)) {
+          flags[OF] = 1; // there is an overflow
+          regs[ins->rd] = 0;
+        }
+        else {
+          flags[OF] = 0; // there is no overflow
+          regs[ins->rd] = rs1_value + rs2_value;
+        }
+        flags[ZF] = (regs[ins->rd] == 0);
+        break;
+      case OP_SUBL:
+        rs2_value = ins->imm;
+        /* fall through */
+      case OP_SUB:
+        flags[CF] = (rs2_value > rs1_value); // there is a carry if subtrahend is bigger
+        regs[ins->rd] = rs1_value - rs2_value;
+        flags[ZF] = (regs[ins->rd] == 0);
+        break;
+      case OP_MUL:
+        regs[ins->rd] = rs1_value * rs2_value;
+        flags[ZF] = (regs[ins->rd] == 0);
+        break;
+      case OP_DIV:
+        if (rs2_value != 0) {
+          regs[ins->rd] = rs1_value / rs2_value;
+          flags[ZF] = (rs1_value % rs2_value != 0); // remainder decides zero flag, same as writeback
+        }
+        else {
+          fprintf(stderr, "Division By Zero Returning Value Zero\n");
+          regs[ins->rd] = 0;
+          flags[ZF] = 0;
+        }
+        break;
+      case OP_AND:
+        regs[ins->rd] = rs1_value & rs2_value;
+        break;
+      case OP_OR:
+        regs[ins->rd] = rs1_value | rs2_value;
+        break;
+      case OP_EXOR:
+        regs[ins->rd] = rs1_value ^ rs2_value;
+        break;
+      case OP_BZ:
+      case OP_BNZ:
+        if (flags[ZF] == (ins->opcode == OP_BZ)) {
+          if (is_valid_branch(pc, ins->imm)) {
+            index = get_code_index(pc + ins->imm);
+          }
+          else {
+            fprintf(stderr, "Invalid Branch Loction for %s\n", get_opcode_name(ins->opcode));
+            fprintf(stderr, "Instruction %s Relative Address %d\n", get_opcode_name(ins->opcode), pc + ins->imm);
+          }
+        }
+        break;
+      case OP_JUMP:
+        mem_address = rs1_value + ins->imm;
+        if (is_valid_branch(pc, mem_address)) {
+          index = get_code_index(mem_address);
+        }
+        else {
+          fprintf(stderr, "Invalid Branch Loction for %s\n", get_opcode_name(ins->opcode));
+          fprintf(stderr, "Instruction %s Relative Address %d\n", get_opcode_name(ins->opcode), pc + mem_address);
+        }
+        break;
+      case OP_HALT:
+        flags[IF] = 1; // Halt as Interrupt
+        ret = HALT;
+        break;
+      case OP_EMPTY:
+        ret = EMPTY;
+        break;
+      default:
+        ; // NOP
+    }
+    if (warming) {
+      warm_model(cpu, ins, pc, mem_address, 4000 + 4 * index, &fetch_line);
+    }
+  }
+
+  cpu->pc = 4000 + 4 * index;
+  cpu->counters.ins_completed += count;
+  cpu->counters.ins_retired += count; // every instruction executed here is one of the program
+  if (executed) {
+    *executed = count;
+  }
+  return ret;
+}
+
+int APEX_cpu_run_functional(APEX_CPU* cpu, int num_instructions) {
+  // Runs the program functionally and reports instructions per second
+  struct timespec start, stop;
+  long long executed = 0;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  int ret = APEX_cpu_execute_functional(cpu, (num_instructions > 0) ? num_instructions : 0, &executed);
+  clock_gettime(CLOCK_MONOTONIC, &stop);
+  double seconds = (stop.tv_sec - start.tv_sec) + (stop.tv_nsec - start.tv_nsec) / 1e9;
+
+  if (ret == HALT) {
+    fprintf(stderr, "Simulation Stoped ....\n");
+    fprintf(cpu->out, "Instruction HALT Encountered\n");
+  }
+  else if (ret == EMPTY) {
+    fprintf(stderr, "Simulation Stoped ....\n");
+    fprintf(cpu->out, "No More Instructions Encountered\n");
+  }
+  else if (ret == SUCCESS) {
+    fprintf(cpu->out, "Requested %d Instructions Completed\n", num_instructions);
+  }
+  fprintf(cpu->out, "Executed %lld instructions in %.3f ms (%.2f MIPS)\n",
+                    executed, seconds * 1e3, (seconds > 0) ? executed / seconds / 1e6 : 0.0);
+  return ret;
+}
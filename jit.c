@@ -0,0 +1,593 @@
+/*
+ *  jit.c
+ *  Contains x86-64 dynamic binary translation of APEX basic blocks,
+ *  used on top of functional execution. Blocks are translated on first
+ *  use, kept in a block cache indexed by code memory index and chained
+ *  to each other, anything that can not be translated is interpreted.
+ *
+ *  Author :
+ *  Sagar Vishwakarma (svishwa2@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <limits.h>
+#include <time.h>
+
+#include "cpu.h"
+
+#if defined(__x86_64__)
+#include <sys/mman.h>
+
+/* Set this flag to 1 to print every translated block */
+#define ENABLE_JIT_DEBUG_MESSAGES 0
+
+/* Size of executable buffer, when it is full all blocks are dropped and translated again */
+#define JIT_CODE_BUFFER_SIZE (16 << 20)
+
+/* Max number of APEX instructions in one block */
+#define JIT_MAX_BLOCK_LEN 64
+
+/* Max bytes of x86-64 emitted for one block, checked before translating */
+#define JIT_MAX_BLOCK_BYTES (JIT_MAX_BLOCK_LEN * 128 + 256)
+
+/* x86-64 register numbers used in ModRM encoding */
+enum {
+  EAX = 0,
+  ECX = 1,
+  EDX = 2
+};
+
+/* State shared between the dispatcher and translated code, pointed to by rbp */
+typedef struct JIT_Context {
+  long long executed;   // APEX instructions completed by translated code
+  long long budget;     // translated code goes back to the dispatcher once executed reaches this
+  long long chained;    // jumps from one translated block straight into another
+  int side_exit;        // set when translated code stops before an instruction the interpreter must run
+  void** block_table;   // entry of translated block for each code index, NULL if none
+} JIT_Context;
+
+typedef struct JIT_Buffer {
+  unsigned char* code;  // executable memory
+  size_t size;
+  size_t used;
+  unsigned char* exit;  // pops registers saved by enter and returns next code index in eax
+} JIT_Buffer;
+
+typedef int (*JIT_Enter)(APEX_CPU* cpu, JIT_Context* ctx, void* block);
+
+/*
+ * ########################################## Emitter ##########################################
+ */
+static void emit1(JIT_Buffer* b, int byte) {
+  b->code[b->used++] = (unsigned char)byte;
+}
+
+static void emit4(JIT_Buffer* b, int32_t value) {
+  memcpy(&b->code[b->used], &value, 4);
+  b->used += 4;
+}
+
+static void emit_rel32_to(JIT_Buffer* b, const unsigned char* target) {
+  // rel32 is relative to the end of the 4 byte field
+  emit4(b, (int32_t)(target - (b->code + b->used + 4)));
+}
+
+static size_t emit_rel8_placeholder(JIT_Buffer* b) {
+  emit1(b, 0);
+  return b->used - 1;
+}
+
+static void patch_rel8(JIT_Buffer* b, size_t at) {
+  // short jump at 'at' lands on current position
+  b->code[at] = (unsigned char)(b->used - (at + 1));
+}
+
+static int cpu_reg_disp(int reg_number) {
+  return (int)(offsetof(APEX_CPU, regs) + sizeof(int) * reg_number);
+}
+
+static int cpu_flag_disp(int flag) {
+  return (int)(offsetof(APEX_CPU, flags) + sizeof(int) * flag);
+}
+
+static void emit_op_cpu(JIT_Buffer* b, int opcode, int reg, int disp) {
+  // <op> reg, dword [rbx + disp32] or <op> dword [rbx + disp32], reg
+  if (opcode > 0xFF) {
+    emit1(b, opcode >> 8);
+  }
+  emit1(b, opcode & 0xFF);
+  emit1(b, 0x80 | (reg << 3) | 3);
+  emit4(b, disp);
+}
+
+static void emit_load_reg(JIT_Buffer* b, int reg, int apex_reg) {
+  emit_op_cpu(b, 0x8B, reg, cpu_reg_disp(apex_reg)); // mov reg, regs[apex_reg]
+}
+
+static void emit_store_reg(JIT_Buffer* b, int reg, int apex_reg) {
+  emit_op_cpu(b, 0x89, reg, cpu_reg_disp(apex_reg)); // mov regs[apex_reg], reg
+}
+
+static void emit_set_flag(JIT_Buffer* b, int setcc, int flag) {
+  // flags[flag] = condition of last compare
+  emit1(b, 0x0F); emit1(b, setcc); emit1(b, 0xC1);  // setcc cl
+  emit1(b, 0x0F); emit1(b, 0xB6); emit1(b, 0xC9);   // movzx ecx, cl
+  emit_op_cpu(b, 0x89, ECX, cpu_flag_disp(flag));   // mov flags[flag], ecx
+}
+
+static void emit_zero_flag_from_eax(JIT_Buffer* b) {
+  emit1(b, 0x85); emit1(b, 0xC0);  // test eax, eax
+  emit_set_flag(b, 0x94, ZF);      // sete
+}
+
+static void emit_add_executed(JIT_Buffer* b, int count) {
+  if (count) {
+    emit1(b, 0x48); emit1(b, 0x81); emit1(b, 0x85);  // add qword [rbp + executed], imm32
+    emit4(b, offsetof(JIT_Context, executed));
+    emit4(b, count);
+  }
+}
+
+static void emit_exit(JIT_Buffer* b) {
+  emit1(b, 0xE9); // jmp exit
+  emit_rel32_to(b, b->exit);
+}
+
+static void emit_side_exit(JIT_Buffer* b, int completed, int index) {
+  // leave translated code before instruction 'index', interpreter executes it
+  emit_add_executed(b, completed);
+  emit1(b, 0xC7); emit1(b, 0x85);   // mov dword [rbp + side_exit], 1
+  emit4(b, offsetof(JIT_Context, side_exit));
+  emit4(b, 1);
+  emit1(b, 0xB8); emit4(b, index);  // mov eax, index
+  emit_exit(b);
+}
+
+static void emit_chain_checks(JIT_Buffer* b) {
+  // eax holds next code index, go back to dispatcher once budget is used up
+  emit1(b, 0x48); emit1(b, 0x8B); emit1(b, 0x8D);  // mov rcx, [rbp + budget]
+  emit4(b, offsetof(JIT_Context, budget));
+  emit1(b, 0x48); emit1(b, 0x39); emit1(b, 0x8D);  // cmp [rbp + executed], rcx
+  emit4(b, offsetof(JIT_Context, executed));
+  emit1(b, 0x0F); emit1(b, 0x8D);                  // jge exit
+  emit_rel32_to(b, b->exit);
+  emit1(b, 0x48); emit1(b, 0x8B); emit1(b, 0x8D);  // mov rcx, [rbp + block_table]
+  emit4(b, offsetof(JIT_Context, block_table));
+}
+
+static void emit_chain_jump(JIT_Buffer* b) {
+  // rcx holds entry of next block, NULL goes back to dispatcher
+  emit1(b, 0x48); emit1(b, 0x85); emit1(b, 0xC9);  // test rcx, rcx
+  emit1(b, 0x0F); emit1(b, 0x84);                  // jz exit
+  emit_rel32_to(b, b->exit);
+  emit1(b, 0x48); emit1(b, 0xFF); emit1(b, 0x85);  // inc qword [rbp + chained]
+  emit4(b, offsetof(JIT_Context, chained));
+  emit1(b, 0xFF); emit1(b, 0xE1);                  // jmp rcx
+}
+
+static void emit_chain_static(JIT_Buffer* b, int next_index, int code_memory_size) {
+  // continue at a code index known while translating
+  emit1(b, 0xB8); emit4(b, next_index);  // mov eax, next_index
+  if ((next_index < 0) || (next_index >= code_memory_size)) {
+    emit_exit(b);
+    return;
+  }
+  emit_chain_checks(b);
+  emit1(b, 0x48); emit1(b, 0x8B); emit1(b, 0x89);  // mov rcx, [rcx + next_index * 8]
+  emit4(b, next_index * (int)sizeof(void*));
+  emit_chain_jump(b);
+}
+
+static void emit_chain_dynamic(JIT_Buffer* b, int code_memory_size) {
+  // continue at code index computed in eax
+  emit1(b, 0x3D); emit4(b, code_memory_size);      // cmp eax, code_memory_size
+  emit1(b, 0x0F); emit1(b, 0x83);                  // jae exit, negative index is above as unsigned
+  emit_rel32_to(b, b->exit);
+  emit_chain_checks(b);
+  emit1(b, 0x48); emit1(b, 0x8B); emit1(b, 0x0C); emit1(b, 0xC1);  // mov rcx, [rcx + rax * 8]
+  emit_chain_jump(b);
+}
+
+static void emit_mem_address(JIT_Buffer* b, const APEX_Instruction* ins, int completed, int index) {
+  // eax = rs1 + imm (or rs2), side exit if outside data memory so interpreter reports it
+  emit_load_reg(b, EAX, ins->rs1);
+  if ((ins->opcode == OP_STORE) || (ins->opcode == OP_LOAD)) {
+    emit1(b, 0x05); emit4(b, ins->imm);            // add eax, imm
+  }
+  else {
+    emit_op_cpu(b, 0x03, EAX, cpu_reg_disp(ins->rs2)); // add eax, rs2
+  }
+  emit1(b, 0x3D); emit4(b, DATA_MEMORY_SIZE);      // cmp eax, DATA_MEMORY_SIZE
+  emit1(b, 0x72);                                  // jb ok
+  size_t ok = emit_rel8_placeholder(b);
+  emit_side_exit(b, completed, index);
+  patch_rel8(b, ok);
+}
+
+static void emit_data_memory(JIT_Buffer* b, int opcode) {
+  // <op> ecx, dword [rbx + rax * 4 + data_memory]
+  emit1(b, opcode); emit1(b, 0x8C); emit1(b, 0x83);
+  emit4(b, offsetof(APEX_CPU, data_memory));
+}
+
+/*
+ * ########################################## Translator ##########################################
+ */
+static int can_translate(const APEX_Instruction* ins, int index) {
+  // HALT, EMPTY, bad registers and branches to bad targets stay in the interpreter
+  int pc = 4000 + 4 * index;
+  switch (ins->format) {
+    case FMT_IMM:
+      return is_valid_branch(pc, ins->imm);
+    case FMT_NONE:
+      return ins->opcode == OP_NOP;
+    default:
+      return has_valid_regs(ins);
+  }
+}
+
+static int ends_block(const APEX_Instruction* ins) {
+  return (ins->opcode == OP_BZ) || (ins->opcode == OP_BNZ) || (ins->opcode == OP_JUMP);
+}
+
+static void emit_instruction(JIT_Buffer* b, const APEX_Instruction* ins, int completed, int index, int code_memory_size) {
+  // completed is number of block instructions before this one
+  int pc = 4000 + 4 * index;
+  size_t ok = 0;
+  switch (ins->opcode) {
+    case OP_STORE:
+    case OP_STR:
+      emit_mem_address(b, ins, completed, index);
+      emit_load_reg(b, ECX, ins->rd);
+      emit_data_memory(b, 0x89);                   // mov [data_memory + rax * 4], ecx
+      break;
+    case OP_LOAD:
+    case OP_LDR:
+      emit_mem_address(b, ins, completed, index);
+      emit_data_memory(b, 0x8B);                   // mov ecx, [data_memory + rax * 4]
+      emit_store_reg(b, ECX, ins->rd);
+      break;
+    case OP_MOVC:
+      emit_op_cpu(b, 0xC7, 0, cpu_reg_disp(ins->rd)); // mov dword regs[rd], imm
+      emit4(b, ins->imm);
+      break;
+    case OP_MOV:
+      emit_load_reg(b, EAX, ins->rs1);
+      emit_store_reg(b, EAX, ins->rd);
+      break;
+    case OP_ADD:
+    case OP_ADDL:
+      // result is 0 when it overflows, same as the pipeline
+      emit1(b, 0x31); emit1(b, 0xD2);              // xor edx, edx
+      emit_load_reg(b, EAX, ins->rs1);
+      if (ins->opcode == OP_ADDL) {
+        emit1(b, 0x05); emit4(b, ins->imm);        // add eax, imm
+      }
+      else {
+        emit_op_cpu(b, 0x03, EAX, cpu_reg_disp(ins->rs2)); // add eax, rs2
+      }
+      emit1(b, 0x0F); emit1(b, 0x40); emit1(b, 0xC2); // cmovo eax, edx
+      emit_set_flag(b, 0x90, OF);                  // seto
+      emit_store_reg(b, EAX, ins->rd);
+      emit_zero_flag_from_eax(b);
+      break;
+    case OP_SUB:
+    case OP_SUBL:
+      emit_load_reg(b, EAX, ins->rs1);
+      if (ins->opcode == OP_SUBL) {
+        emit1(b, 0xBA); emit4(b, ins->imm);        // mov edx, imm
+      }
+      else {
+        emit_load_reg(b, EDX, ins->rs2);
+      }
+      emit1(b, 0x39); emit1(b, 0xD0);              // cmp eax, edx
+      emit_set_flag(b, 0x9C, CF);                  // setl, carry if subtrahend is bigger
+      emit1(b, 0x29); emit1(b, 0xD0);              // sub eax, edx
+      emit_store_reg(b, EAX, ins->rd);
+      emit_zero_flag_from_eax(b);
+      break;
+    case OP_MUL:
+      emit_load_reg(b, EAX, ins->rs1);
+      emit_op_cpu(b, 0x0FAF, EAX, cpu_reg_disp(ins->rs2)); // imul eax, rs2
+      emit_store_reg(b, EAX, ins->rd);
+      emit_zero_flag_from_eax(b);
+      break;
+    case OP_DIV:
+      // division by zero is reported by the interpreter
+      emit_load_reg(b, ECX, ins->rs2);
+      emit1(b, 0x85); emit1(b, 0xC9);              // test ecx, ecx
+      emit1(b, 0x75);                              // jnz ok
+      ok = emit_rel8_placeholder(b);
+      emit_side_exit(b, completed, index);
+      patch_rel8(b, ok);
+      emit_load_reg(b, EAX, ins->rs1);
+      emit1(b, 0x99);                              // cdq
+      emit1(b, 0xF7); emit1(b, 0xF9);              // idiv ecx
+      emit_store_reg(b, EAX, ins->rd);
+      emit1(b, 0x85); emit1(b, 0xD2);              // test edx, edx
+      emit_set_flag(b, 0x95, ZF);                  // setne, remainder decides zero flag
+      break;
+    case OP_AND:
+    case OP_OR:
+    case OP_EXOR:
+      emit_load_reg(b, EAX, ins->rs1);
+      emit_op_cpu(b, (ins->opcode == OP_AND) ? 0x23 : (ins->opcode == OP_OR) ? 0x0B : 0x33,
+                  EAX, cpu_reg_disp(ins->rs2));
+      emit_store_reg(b, EAX, ins->rd);
+      break;
+    case OP_BZ:
+    case OP_BNZ:
+      emit_add_executed(b, completed + 1);
+      emit_op_cpu(b, 0x83, 7, cpu_flag_disp(ZF));  // cmp dword flags[ZF], 0
+      emit1(b, 0);
+      emit1(b, 0x0F); emit1(b, (ins->opcode == OP_BZ) ? 0x85 : 0x84); // jne / je taken
+      ok = b->used;
+      emit4(b, 0);
+      emit_chain_static(b, index + 1, code_memory_size);
+      {
+        int32_t rel = (int32_t)(b->used - (ok + 4));
+        memcpy(&b->code[ok], &rel, 4);
+      }
+      emit_chain_static(b, get_code_index(pc + ins->imm), code_memory_size);
+      break;
+    case OP_JUMP:
+      emit_load_reg(b, EAX, ins->rs1);
+      emit1(b, 0x05); emit4(b, ins->imm);          // add eax, imm
+      emit1(b, 0x8D); emit1(b, 0x88); emit4(b, pc); // lea ecx, [rax + pc]
+      emit1(b, 0xF6); emit1(b, 0xC1); emit1(b, 3); // test cl, 3
+      emit1(b, 0x75);                              // jnz bad
+      size_t bad = emit_rel8_placeholder(b);
+      emit1(b, 0x81); emit1(b, 0xF9); emit4(b, 4000); // cmp ecx, 4000
+      emit1(b, 0x7D);                              // jge ok
+      ok = emit_rel8_placeholder(b);
+      patch_rel8(b, bad);
+      emit_side_exit(b, completed, index);
+      patch_rel8(b, ok);
+      emit_add_executed(b, completed + 1);
+      emit1(b, 0x2D); emit4(b, 4000);              // sub eax, 4000
+      emit1(b, 0xC1); emit1(b, 0xF8); emit1(b, 2); // sar eax, 2
+      emit_chain_dynamic(b, code_memory_size);
+      break;
+    default:
+      ; // NOP
+  }
+}
+
+/*
+ * ########################################## Block Cache ##########################################
+ */
+typedef struct JIT_State {
+  JIT_Buffer buffer;
+  JIT_Context ctx;
+  JIT_Enter enter;
+  size_t first_block;         // blocks start after enter / exit code
+  unsigned char* leader;      // 1 for index starting a basic block
+  unsigned char* untranslatable; // 1 for index whose first instruction can not be translated
+  long long hits;             // dispatcher found a translated block
+  long long misses;           // dispatcher had to translate or interpret
+  long long flushes;          // times the buffer filled up and was dropped
+  int blocks;                 // blocks translated
+} JIT_State;
+
+static void find_leaders(const APEX_CPU* cpu, unsigned char* leader) {
+  // basic blocks start at first instruction, branch targets and after branches
+  leader[0] = 1;
+  for (int i = 0; i < cpu->code_memory_size; ++i) {
+    const APEX_Instruction* ins = &cpu->code_memory[i];
+    if (!ends_block(ins)) {
+      continue;
+    }
+    if (i + 1 < cpu->code_memory_size) {
+      leader[i + 1] = 1;
+    }
+    if (ins->opcode != OP_JUMP) {
+      int target = get_code_index(4000 + 4 * i + ins->imm);
+      if ((target >= 0) && (target < cpu->code_memory_size)) {
+        leader[target] = 1;
+      }
+    }
+  }
+}
+
+static void flush_blocks(JIT_State* jit, int code_memory_size) {
+  // drop every translated block, enter / exit code stays
+  jit->buffer.used = jit->first_block;
+  memset(jit->ctx.block_table, 0, sizeof(void*) * code_memory_size);
+  jit->flushes++;
+}
+
+static void* translate_block(JIT_State* jit, const APEX_CPU* cpu, int start) {
+  // translate from start until a branch, a leader or an instruction that needs the interpreter
+  JIT_Buffer* b = &jit->buffer;
+  if (b->used + JIT_MAX_BLOCK_BYTES > b->size) {
+    flush_blocks(jit, cpu->code_memory_size);
+  }
+  unsigned char* entry = b->code + b->used;
+  int count = 0;
+  int index = start;
+  while ((index < cpu->code_memory_size) && (count < JIT_MAX_BLOCK_LEN)) {
+    const APEX_Instruction* ins = &cpu->code_memory[index];
+    if (!can_translate(ins, index) || ((count > 0) && jit->leader[index])) {
+      break;
+    }
+    emit_instruction(b, ins, count, index, cpu->code_memory_size);
+    count++;
+    index++;
+    if (ends_block(ins)) {
+      break;
+    }
+  }
+  if (!count) {
+    return NULL;
+  }
+  if (!ends_block(&cpu->code_memory[index - 1])) {
+    // fall through into next block
+    emit_add_executed(b, count);
+    emit_chain_static(b, index, cpu->code_memory_size);
+  }
+  if (ENABLE_JIT_DEBUG_MESSAGES) {
+    fprintf(stderr, "APEX_JIT : block pc(%d) %d instructions %d bytes\n",
+            4000 + 4 * start, count, (int)(b->code + b->used - entry));
+  }
+  jit->blocks++;
+  return entry;
+}
+
+static int jit_init(JIT_State* jit, const APEX_CPU* cpu) {
+  memset(jit, 0, sizeof(*jit));
+  void* code = mmap(NULL, JIT_CODE_BUFFER_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (code == MAP_FAILED) {
+    return ERROR;
+  }
+  jit->buffer.code = code;
+  jit->buffer.size = JIT_CODE_BUFFER_SIZE;
+  jit->ctx.block_table = calloc(cpu->code_memory_size, sizeof(void*));
+  jit->leader = calloc(cpu->code_memory_size, 1);
+  jit->untranslatable = calloc(cpu->code_memory_size, 1);
+  if (!jit->ctx.block_table || !jit->leader || !jit->untranslatable) {
+    return ERROR;
+  }
+  find_leaders(cpu, jit->leader);
+
+  // enter(cpu, ctx, block) keeps cpu in rbx and ctx in rbp, then jumps into block
+  JIT_Buffer* b = &jit->buffer;
+  jit->enter = (JIT_Enter)(void*)b->code;
+  emit1(b, 0x53);                                  // push rbx
+  emit1(b, 0x55);                                  // push rbp
+  emit1(b, 0x48); emit1(b, 0x89); emit1(b, 0xFB);  // mov rbx, rdi
+  emit1(b, 0x48); emit1(b, 0x89); emit1(b, 0xF5);  // mov rbp, rsi
+  emit1(b, 0xFF); emit1(b, 0xE2);                  // jmp rdx
+  b->exit = b->code + b->used;
+  emit1(b, 0x5D);                                  // pop rbp
+  emit1(b, 0x5B);                                  // pop rbx
+  emit1(b, 0xC3);                                  // ret
+  jit->first_block = b->used;
+  return SUCCESS;
+}
+
+static void jit_free(JIT_State* jit) {
+  if (jit->buffer.code) {
+    munmap(jit->buffer.code, jit->buffer.size);
+  }
+  free(jit->ctx.block_table);
+  free(jit->leader);
+  free(jit->untranslatable);
+}
+
+int APEX_cpu_execute_jit(APEX_CPU* cpu, long long max_instructions, long long* executed, APEX_JIT_Stats* stats) {
+  // Executes up to max_instructions (0 = no limit) from cpu->pc, same results as APEX_cpu_execute_functional
+  JIT_State jit;
+  if (jit_init(&jit, cpu) != SUCCESS) {
+    fprintf(stderr, "APEX_JIT : Unable to allocate executable memory, using interpreter\n");
+    jit_free(&jit);
+    return APEX_cpu_execute_functional(cpu, max_instructions, executed);
+  }
+
+  long long interpreted = 0;
+  int ret = SUCCESS;
+  while (ret == SUCCESS) {
+    long long count = jit.ctx.executed + interpreted;
+    if (max_instructions && (count >= max_instructions)) {
+      break;
+    }
+    int index = get_code_index(cpu->pc);
+    void* block = NULL;
+    if (!jit.ctx.side_exit && (index >= 0) && (index < cpu->code_memory_size)) {
+      block = jit.ctx.block_table[index];
+      if (block) {
+        jit.hits++;
+      }
+      else {
+        jit.misses++;
+        if (!jit.untranslatable[index]) {
+          block = translate_block(&jit, cpu, index);
+          jit.ctx.block_table[index] = block;
+          jit.untranslatable[index] = !block;
+        }
+      }
+    }
+    long long remaining = max_instructions ? max_instructions - count : 0;
+    if (block && (!max_instructions || (remaining > JIT_MAX_BLOCK_LEN))) {
+      // chained blocks stop once budget is reached, one more block never passes the limit
+      jit.ctx.budget = max_instructions ? jit.ctx.executed + remaining - JIT_MAX_BLOCK_LEN : LLONG_MAX;
+      int next = jit.enter(cpu, &jit.ctx, block);
+      cpu->pc = 4000 + 4 * next;
+    }
+    else {
+      // after a side exit the interpreter runs the instruction translated code stopped at
+      long long stepped = 0;
+      jit.ctx.side_exit = 0;
+      ret = APEX_cpu_execute_functional(cpu, 1, &stepped);
+      interpreted += stepped;
+    }
+  }
+
+  cpu->counters.ins_completed += jit.ctx.executed;
+  cpu->counters.ins_retired += jit.ctx.executed;
+  if (executed) {
+    *executed = jit.ctx.executed + interpreted;
+  }
+  if (stats) {
+    stats->hits = jit.hits + jit.ctx.chained;
+    stats->chained = jit.ctx.chained;
+    stats->misses = jit.misses;
+    stats->blocks = jit.blocks;
+    stats->flushes = jit.flushes;
+    stats->interpreted = interpreted;
+  }
+  jit_free(&jit);
+  return ret;
+}
+
+#else
+
+int APEX_cpu_execute_jit(APEX_CPU* cpu, long long max_instructions, long long* executed, APEX_JIT_Stats* stats) {
+  // No translator for this host, everything is interpreted
+  if (stats) {
+    memset(stats, 0, sizeof(*stats));
+  }
+  long long count = 0;
+  int ret = APEX_cpu_execute_functional(cpu, max_instructions, &count);
+  if (stats) {
+    stats->interpreted = count;
+  }
+  if (executed) {
+    *executed = count;
+  }
+  return ret;
+}
+
+#endif
+
+int APEX_cpu_run_jit(APEX_CPU* cpu, int num_instructions) {
+  // Runs the program functionally through the translator and reports block cache counters
+  struct timespec start, stop;
+  long long executed = 0;
+  APEX_JIT_Stats stats;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  int ret = APEX_cpu_execute_jit(cpu, (num_instructions > 0) ? num_instructions : 0, &executed, &stats);
+  clock_gettime(CLOCK_MONOTONIC, &stop);
+  double seconds = (stop.tv_sec - start.tv_sec) + (stop.tv_nsec - start.tv_nsec) / 1e9;
+
+  if (ret == HALT) {
+    fprintf(stderr, "Simulation Stoped ....\n");
+    fprintf(cpu->out, "Instruction HALT Encountered\n");
+  }
+  else if (ret == EMPTY) {
+    fprintf(stderr, "Simulation Stoped ....\n");
+    fprintf(cpu->out, "No More Instructions Encountered\n");
+  }
+  else if (ret == SUCCESS) {
+    fprintf(cpu->out, "Requested %d Instructions Completed\n", num_instructions);
+  }
+  fprintf(cpu->out, "Executed %lld instructions in %.3f ms (%.2f MIPS)\n",
+                    executed, seconds * 1e3, (seconds > 0) ? executed / seconds / 1e6 : 0.0);
+  fprintf(cpu->out, "Block cache :: hits %lld (chained %lld), misses %lld, blocks %d, flushes %lld, interpreted %lld\n",
+                    stats.hits, stats.chained, stats.misses, stats.blocks, stats.flushes, stats.interpreted);
+  return ret;
+}
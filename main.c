@@ -11,28 +11,304 @@
 
 #include "cpu.h"
 
+/* Options after <num_cycle>, a bit each so every func can say which ones it takes */
+enum {
+  OPT_CHECKPOINT = 1 << 0,
+  OPT_RESTORE    = 1 << 1,
+  OPT_TRACE      = 1 << 2,
+  OPT_TIMELINE   = 1 << 3,
+  OPT_THREADS    = 1 << 4,
+  OPT_CORES      = 1 << 5,
+  OPT_QUANTUM    = 1 << 6,
+  OPT_CONFIG     = 1 << 7,
+  OPT_GRID       = 1 << 8,
+  OPT_RANDOM     = 1 << 9,
+  OPT_REPEAT     = 1 << 10,
+  OPT_LIMIT      = 1 << 11,
+  NUM_OPTIONS    = 12
+};
 
+static const char* option_names[NUM_OPTIONS] = {
+  "checkpoint", "restore", "trace", "timeline", "threads", "cores", "quantum", "config", "grid", "random", "repeat", "limit"
+};
+
+static int get_func_options(const char* func) {
+  // Options func uses, any other one given is an error instead of being ignored
+  if ((strcmp(func, "simulate") == 0) || (strcmp(func, "display") == 0) || (strcmp(func, "run") == 0)) {
+    return OPT_CHECKPOINT | OPT_RESTORE | OPT_TRACE | OPT_TIMELINE | OPT_CONFIG;
+  }
+  if (strcmp(func, "sample") == 0) {
+    return OPT_CONFIG;
+  }
+  if (strcmp(func, "batch") == 0) {
+    return OPT_THREADS;
+  }
+  if (strcmp(func, "multicore") == 0) {
+    return OPT_CORES | OPT_QUANTUM;
+  }
+  if (strcmp(func, "sweep") == 0) {
+    return OPT_GRID | OPT_RANDOM | OPT_LIMIT | OPT_THREADS;
+  }
+  if (strcmp(func, "bench") == 0) {
+    return OPT_REPEAT | OPT_CONFIG;
+  }
+  return 0; // functional, jit, assemble, translate
+}
 
 int main(int argc, char const* argv[])
 {
   int num_cycle = 0;
-  char func[10];
+  const char* func = NULL;
+  int checkpoint_cycle = 0;
+  const char* checkpoint_file = NULL;
+  const char* restore_file = NULL;
+  const char* trace_file = NULL;
+  const char* timeline_file = NULL;
+  int num_threads = 0;
+  int num_cores = 0;
+  int quantum = 1000;
+  const char* config = NULL;
+  const char* grid = NULL;
+  int random_points = 0;
+  int repeat = 3;
+  int max_cycles = 100000000;
+  // options after <num_cycle>, get_func_options tells which funcs take each of them
+  int options_valid = 1;
+  int options = 0;
+  for (int i = 4; i < argc; ++i) {
+    if ((strcmp(argv[i], "-checkpoint") == 0) && (i + 2 < argc)) {
+      checkpoint_cycle = atoi(argv[i + 1]);
+      checkpoint_file = argv[i + 2];
+      options |= OPT_CHECKPOINT;
+      i += 2;
+    }
+    else if ((strcmp(argv[i], "-restore") == 0) && (i + 1 < argc)) {
+      restore_file = argv[i + 1];
+      options |= OPT_RESTORE;
+      i += 1;
+    }
+    else if ((strcmp(argv[i], "-trace") == 0) && (i + 1 < argc)) {
+      trace_file = argv[i + 1];
+      options |= OPT_TRACE;
+      i += 1;
+    }
+    else if ((strcmp(argv[i], "-timeline") == 0) && (i + 1 < argc)) {
+      timeline_file = argv[i + 1];
+      options |= OPT_TIMELINE;
+      i += 1;
+    }
+    else if ((strcmp(argv[i], "-threads") == 0) && (i + 1 < argc)) {
+      num_threads = atoi(argv[i + 1]);
+      options |= OPT_THREADS;
+      i += 1;
+    }
+    else if ((strcmp(argv[i], "-cores") == 0) && (i + 1 < argc)) {
+      num_cores = atoi(argv[i + 1]);
+      options |= OPT_CORES;
+      i += 1;
+    }
+    else if ((strcmp(argv[i], "-quantum") == 0) && (i + 1 < argc)) {
+      quantum = atoi(argv[i + 1]);
+      options |= OPT_QUANTUM;
+      i += 1;
+    }
+    else if ((strcmp(argv[i], "-config") == 0) && (i + 1 < argc)) {
+      config = argv[i + 1];
+      options |= OPT_CONFIG;
+      i += 1;
+    }
+    else if ((strcmp(argv[i], "-grid") == 0) && (i + 1 < argc)) {
+      grid = argv[i + 1];
+      options |= OPT_GRID;
+      i += 1;
+    }
+    else if ((strcmp(argv[i], "-random") == 0) && (i + 1 < argc)) {
+      random_points = atoi(argv[i + 1]);
+      options |= OPT_RANDOM;
+      i += 1;
+    }
+    else if ((strcmp(argv[i], "-repeat") == 0) && (i + 1 < argc)) {
+      repeat = atoi(argv[i + 1]);
+      options |= OPT_REPEAT;
+      i += 1;
+    }
+    else if ((strcmp(argv[i], "-limit") == 0) && (i + 1 < argc)) {
+      max_cycles = atoi(argv[i + 1]);
+      options |= OPT_LIMIT;
+      i += 1;
+    }
+    else {
+      options_valid = 0;
+    }
+  }
   // argc = count of arguments, executable being 1st argument in argv[0]
-  if (argc != 4) {
+  if ((argc < 4) || !options_valid) {
     // stderr = Error message on stderr (using fprintf)
-    fprintf(stderr, "APEX_Help : Usage %s <input_file> <func(eg: simulate Or display)> <num_cycle>\n", argv[0]);
+    fprintf(stderr, "APEX_Help : Usage %s <input_file> <func(eg: simulate Or display Or run Or functional Or jit)> <num_cycle>\n", argv[0]);
+    fprintf(stderr, "APEX_Help : Usage %s <input_file> assemble <image_file(eg: input.apexo)>\n", argv[0]);
+    fprintf(stderr, "APEX_Help : Usage %s <input_file> sample <fast_forward:warmup:detail(eg: 1000000:1000:10000)> [-config <name=value,...>]\n", argv[0]);
+    fprintf(stderr, "APEX_Help : Usage %s <input_file> translate <c_file(eg: input_apex.c)>\n", argv[0]);
+    fprintf(stderr, "APEX_Help : Usage %s <manifest_file> batch <results_file> [-threads <n>]\n", argv[0]);
+    fprintf(stderr, "APEX_Help : Usage %s <input_file,input_file,...> multicore <num_cycle> [-cores <n>] [-quantum <cycles>]\n", argv[0]);
+    fprintf(stderr, "APEX_Help : Usage %s <input_file,input_file,...> sweep <csv_file> -grid <name=v1,v2;name=lo:hi> [-random <points>] [-limit <cycles>] [-threads <n>]\n", argv[0]);
+    fprintf(stderr, "APEX_Help : Usage %s <input_file,input_file,...> bench <csv_file> [-repeat <n>] [-config <name=value,...>]\n", argv[0]);
+    fprintf(stderr, "APEX_Help : Options after <num_cycle> -checkpoint <cycle> <checkpoint_file> -restore <checkpoint_file> -trace <trace_file> -timeline <timeline_file(eg: input.kanata Or input.json)> -config <name=value,...>\n");
     exit(1);
   }
   else {
-    strcpy(func, argv[2]);
+    func = argv[2];
     num_cycle = atoi(argv[3]);
   }
-  if ((strcmp(func, "display") == 0)||(strcmp(func, "simulate")==0)) {
+  int unused = options & ~get_func_options(func);
+  for (int i = 0; i < NUM_OPTIONS; ++i) {
+    if (unused & (1 << i)) {
+      fprintf(stderr, "APEX_Error : Option -%s does not apply to %s\n", option_names[i], func);
+      exit(1);
+    }
+  }
+  if (strcmp(func, "assemble") == 0) {
+    // parse input file once and write decoded code memory as a program image
+    int code_memory_size = 0;
+    APEX_Instruction* code_memory = create_code_memory(argv[1], &code_memory_size);
+    if (!code_memory) {
+      fprintf(stderr, "APEX_Error : Unable to parse %s\n", argv[1]);
+      exit(1);
+    }
+    if (write_program_image(argv[3], code_memory, code_memory_size, NULL, 0) != SUCCESS) {
+      fprintf(stderr, "APEX_Error : Unable to write program image %s\n", argv[3]);
+      free(code_memory);
+      exit(1);
+    }
+    printf("(apex) >> Assembled %d instructions into %s\n", code_memory_size, argv[3]);
+    free(code_memory);
+  }
+  else if (strcmp(func, "translate") == 0) {
+    // parse input file once and write a C file specialized for the program
+    int code_memory_size = 0;
+    APEX_Instruction* code_memory = create_code_memory(argv[1], &code_memory_size);
+    if (!code_memory) {
+      fprintf(stderr, "APEX_Error : Unable to parse %s\n", argv[1]);
+      exit(1);
+    }
+    if (write_program_c(argv[3], argv[1], code_memory, code_memory_size) != SUCCESS) {
+      fprintf(stderr, "APEX_Error : Unable to write C file %s\n", argv[3]);
+      free(code_memory);
+      exit(1);
+    }
+    printf("(apex) >> Translated %d instructions into %s\n", code_memory_size, argv[3]);
+    free(code_memory);
+  }
+  else if (strcmp(func, "batch") == 0) {
+    // every line of manifest is <input_file> <func> <num_cycle>, no prompt at the end
+    if (APEX_cpu_run_batch(argv[1], argv[3], num_threads) != SUCCESS) {
+      exit(1);
+    }
+  }
+  else if (strcmp(func, "multicore") == 0) {
+    // one program per core, programs are used in turn when there are more cores than programs
+    char* list = strdup(argv[1]);
+    const char* programs[64];
+    int num_programs = 0;
+    for (char* name = strtok(list, ","); name && (num_programs < 64); name = strtok(NULL, ",")) {
+      programs[num_programs++] = name;
+    }
+    if (num_cores <= 0) {
+      num_cores = num_programs;
+    }
+    for (int i = num_programs; (num_programs > 0) && (i < num_cores) && (i < 64); ++i) {
+      programs[i] = programs[i % num_programs];
+    }
+    int ret = (num_programs > 0) ? APEX_cpu_run_multicore(programs, num_cores, quantum, num_cycle) : ERROR;
+    free(list);
+    if (ret != SUCCESS) {
+      exit(1);
+    }
+  }
+  else if (strcmp(func, "sweep") == 0) {
+    // every workload runs on every configuration of the grid, or on random points of it
+    if (!grid) {
+      fprintf(stderr, "APEX_Error : sweep needs -grid <name=v1,v2;name=lo:hi>\n");
+      exit(1);
+    }
+    if (max_cycles <= 0) {
+      fprintf(stderr, "APEX_Error : sweep needs -limit <cycles> above 0\n");
+      exit(1);
+    }
+    char* list = strdup(argv[1]);
+    const char* workloads[64];
+    int num_workloads = 0;
+    for (char* name = strtok(list, ","); name && (num_workloads < 64); name = strtok(NULL, ",")) {
+      workloads[num_workloads++] = name;
+    }
+    int ret = (num_workloads > 0) ? APEX_cpu_run_sweep(workloads, num_workloads, grid, random_points, max_cycles, num_threads, argv[3]) : ERROR;
+    free(list);
+    if (ret != SUCCESS) {
+      exit(1);
+    }
+  }
+  else if (strcmp(func, "bench") == 0) {
+    // every workload runs under each execution mode, fastest of repeat runs is kept
+    char* list = strdup(argv[1]);
+    const char* workloads[64];
+    int num_workloads = 0;
+    for (char* name = strtok(list, ","); name && (num_workloads < 64); name = strtok(NULL, ",")) {
+      workloads[num_workloads++] = name;
+    }
+    int ret = (num_workloads > 0) ? APEX_cpu_run_bench(workloads, num_workloads, config, repeat, argv[3]) : ERROR;
+    free(list);
+    if (ret != SUCCESS) {
+      exit(1);
+    }
+  }
+  else if (strcmp(func, "sample") == 0) {
+    // schedule is given in place of num_cycle
+    APEX_Sample_Schedule schedule;
+    if ((sscanf(argv[3], "%lld:%d:%d", &schedule.fast_forward, &schedule.warmup, &schedule.detail) != 3) ||
+        (schedule.fast_forward < 0) || (schedule.warmup < 0) || (schedule.detail <= 0)) {
+      fprintf(stderr, "APEX_Error : Invalid sampling schedule %s, expected fast_forward:warmup:detail\n", argv[3]);
+      exit(1);
+    }
+    APEX_CPU* cpu = APEX_cpu_init(argv[1]);
+    if (!cpu) {
+      fprintf(stderr, "APEX_Error : Unable to initialize CPU\n");
+      exit(1);
+    }
+    if (config && (APEX_config_parse(&cpu->config, config) != SUCCESS)) {
+      APEX_cpu_stop(cpu);
+      exit(1);
+    }
+    int ret = APEX_cpu_run_sampled(cpu, &schedule);
+    printf("Simulation Return Code %d\n",ret);
+    print_cpu_content(cpu);
+    APEX_cpu_stop(cpu);
+  }
+  else if ((strcmp(func, "display") == 0)||(strcmp(func, "simulate")==0)||(strcmp(func, "functional")==0)||(strcmp(func, "jit")==0)||(strcmp(func, "run")==0)) {
     APEX_CPU* cpu = APEX_cpu_init(argv[1]);
     if (!cpu) {
       fprintf(stderr, "APEX_Error : Unable to initialize CPU\n");
       exit(1);
     }
+    if (config && (APEX_config_parse(&cpu->config, config) != SUCCESS)) {
+      APEX_cpu_stop(cpu);
+      exit(1);
+    }
+    if (restore_file && (load_checkpoint(cpu, restore_file) != SUCCESS)) {
+      fprintf(stderr, "APEX_Error : Unable to restore checkpoint %s\n", restore_file);
+      APEX_cpu_stop(cpu);
+      exit(1);
+    }
+    if (checkpoint_file) {
+      cpu->checkpoint_cycle = checkpoint_cycle;
+      cpu->checkpoint_file = checkpoint_file;
+    }
+    if (trace_file && (APEX_trace_open(cpu, trace_file) != SUCCESS)) {
+      APEX_cpu_stop(cpu);
+      exit(1);
+    }
+    if (timeline_file && (APEX_timeline_open(cpu, timeline_file) != SUCCESS)) {
+      APEX_cpu_stop(cpu);
+      exit(1);
+    }
     int ret = 0;
     if (strcmp(func, "display") == 0) {
       // show everything
@@ -48,6 +324,50 @@ int main(int argc, char const* argv[])
       printf("Press Any Key to Exit Simulation\n");
       getchar();
     }
+    else if (strcmp(func, "run") == 0) {
+      // pipeline without per cycle prints, show only final state
+      cpu->quiet = 1;
+      ret = APEX_cpu_run(cpu, num_cycle);
+      if (ret == SUCCESS) {
+        printf("(apex) >> Simulation Complete");
+      }
+      else {
+        printf("Simulation Return Code %d\n",ret);
+      }
+      printf("Cycles %d, Instructions %d, Stalled Cycles Skipped %d\n",
+             cpu->clock, cpu->counters.ins_retired, cpu->counters.cycles_skipped);
+      if (!cpu->config.engine && (cpu->config.width > 1)) {
+        printf("Superscalar :: Width %d, IPC %.2f\n", cpu->config.width,
+               cpu->clock ? (double)cpu->counters.ins_retired / cpu->clock : 0.0);
+      }
+      print_branch_stats(cpu);
+      print_cache_stats(cpu);
+      print_unit_stats(cpu);
+      print_ooo_stats(cpu);
+      print_cpu_content(cpu);
+      APEX_cpu_stop(cpu);
+      printf("Press Any Key to Exit Simulation\n");
+      getchar();
+    }
+    else if ((strcmp(func, "functional") == 0)||(strcmp(func, "jit") == 0)) {
+      // only architectural results, here num_cycle is number of instructions
+      if (strcmp(func, "jit") == 0) {
+        ret = APEX_cpu_run_jit(cpu, num_cycle);
+      }
+      else {
+        ret = APEX_cpu_run_functional(cpu, num_cycle);
+      }
+      if (ret == SUCCESS) {
+        printf("(apex) >> Simulation Complete");
+      }
+      else {
+        printf("Simulation Return Code %d\n",ret);
+      }
+      print_cpu_content(cpu);
+      APEX_cpu_stop(cpu);
+      printf("Press Any Key to Exit Simulation\n");
+      getchar();
+    }
     else {
       // show only stages
       ret = APEX_cpu_run(cpu, num_cycle);
@@ -65,7 +385,7 @@ int main(int argc, char const* argv[])
   }
   else {
     fprintf(stderr, "Invalid parameters passed !!!\n");
-    fprintf(stderr, "APEX_Help : Usage %s <input_file> <func(eg: simulate Or display)> <num_cycle>\n", argv[0]);
+    fprintf(stderr, "APEX_Help : Usage %s <input_file> <func(eg: simulate Or display Or run Or functional Or jit)> <num_cycle>\n", argv[0]);
   }
 
   return 0;
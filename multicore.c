@@ -0,0 +1,234 @@
+/*
+ *  multicore.c
+ *  Contains N core APEX system, every core is a full 7 stage pipeline running
+ *  on its own host thread and all cores share one data memory.
+ *
+ *  Cores run in lock step quanta of simulated cycles. A store is seen by
+ *  later loads of its own core at once and by other cores from the next
+ *  quantum, at the end of every quantum stores of all cores are merged into
+ *  shared memory in core order (higher core wins a location written by many).
+ *  Within a quantum cores only touch their own copy, so results do not depend
+ *  on host thread scheduling. Quantum 1 makes every store visible next cycle.
+ *
+ *  Author :
+ *  Sagar Vishwakarma (svishwa2@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "cpu.h"
+
+#define MAX_CORES 64
+
+/* Shared memory contention, a location is contended in a quantum if more than one core touched it and one wrote it */
+typedef struct Multicore_Contention {
+  long long contended;      // contended location quanta
+  long long write_write;    // of those, written by more than one core
+  long long shared_loads;   // loads of contended locations
+} Multicore_Contention;
+
+typedef struct Multicore_System {
+  APEX_CPU* cores[MAX_CORES];
+  unsigned char access[MAX_CORES][DATA_MEMORY_SIZE];
+  int ret[MAX_CORES];
+  int num_cores;
+  int quantum;
+  int num_cycle;
+  int end_cycle;            // last cycle of current quantum
+  int done;
+  int quanta;
+  int shared_memory[DATA_MEMORY_SIZE];
+  Multicore_Contention contention;
+  pthread_barrier_t barrier;
+  pthread_mutex_t gate_lock;  // threads start simulating once all of them exist
+  pthread_cond_t gate;
+  int gate_open;
+} Multicore_System;
+
+typedef struct Multicore_Thread {
+  Multicore_System* system;
+  int id;
+} Multicore_Thread;
+
+static int core_running(const Multicore_System* system, int id) {
+  return (system->ret[id] != HALT) && (system->ret[id] != EMPTY);
+}
+
+static void end_quantum(Multicore_System* system) {
+  // Merges stores of the quantum into shared memory, counts contention and hands shared memory back to every core
+  for (int i = 0; i < DATA_MEMORY_SIZE; ++i) {
+    int touched = 0;
+    int writers = 0;
+    int readers = 0;
+    for (int c = 0; c < system->num_cores; ++c) {
+      unsigned char access = system->access[c][i];
+      if (access) {
+        touched++;
+        if (access & MEMORY_WRITTEN) {
+          system->shared_memory[i] = system->cores[c]->data_memory[i];
+          writers++;
+        }
+        if (access & MEMORY_READ) {
+          readers++;
+        }
+      }
+    }
+    if ((touched > 1) && writers) {
+      system->contention.contended++;
+      system->contention.write_write += (writers > 1);
+      system->contention.shared_loads += readers;
+    }
+  }
+  for (int c = 0; c < system->num_cores; ++c) {
+    memcpy(system->cores[c]->data_memory, system->shared_memory, sizeof(system->shared_memory));
+    memset(system->access[c], 0, sizeof(system->access[c]));
+  }
+  system->quanta++;
+
+  int running = 0;
+  for (int c = 0; c < system->num_cores; ++c) {
+    running += core_running(system, c);
+  }
+  if (!running || ((system->num_cycle > 0) && (system->end_cycle >= system->num_cycle))) {
+    system->done = 1;
+  }
+  else {
+    system->end_cycle += system->quantum;
+    if ((system->num_cycle > 0) && (system->end_cycle > system->num_cycle)) {
+      system->end_cycle = system->num_cycle;
+    }
+  }
+}
+
+static void* core_thread(void* arg) {
+  Multicore_Thread* thread = arg;
+  Multicore_System* system = thread->system;
+  APEX_CPU* cpu = system->cores[thread->id];
+  pthread_mutex_lock(&system->gate_lock);
+  while (!system->gate_open) {
+    pthread_cond_wait(&system->gate, &system->gate_lock);
+  }
+  pthread_mutex_unlock(&system->gate_lock);
+  while (!system->done) {
+    if (core_running(system, thread->id)) {
+      system->ret[thread->id] = APEX_cpu_run_until(cpu, system->end_cycle);
+    }
+    // one thread merges while others wait, then all see done and end_cycle of next quantum
+    if (pthread_barrier_wait(&system->barrier) == PTHREAD_BARRIER_SERIAL_THREAD) {
+      end_quantum(system);
+    }
+    pthread_barrier_wait(&system->barrier);
+  }
+  return NULL;
+}
+
+int APEX_cpu_run_multicore(const char* const* programs, int num_cores, int quantum, int num_cycle) {
+  // Core i runs programs[i], simulates till all cores end or num_cycle, 0 runs till every core ends
+  if ((num_cores < 1) || (num_cores > MAX_CORES) || (quantum < 1)) {
+    fprintf(stderr, "APEX_Error : Multi-core needs 1 to %d cores and a quantum of at least one cycle\n", MAX_CORES);
+    return ERROR;
+  }
+  Multicore_System* system = calloc(1, sizeof(*system));
+  if (!system) {
+    return ERROR;
+  }
+  system->num_cores = num_cores;
+  system->quantum = quantum;
+  system->num_cycle = num_cycle;
+  system->end_cycle = ((num_cycle > 0) && (num_cycle < quantum)) ? num_cycle : quantum;
+  int ret = SUCCESS;
+  for (int c = 0; c < num_cores; ++c) {
+    system->cores[c] = APEX_cpu_init(programs[c]);
+    if (!system->cores[c]) {
+      fprintf(stderr, "APEX_Error : Unable to initialize core %d with %s\n", c, programs[c]);
+      ret = ERROR;
+      break;
+    }
+    system->cores[c]->quiet = 1;
+    system->cores[c]->memory_access = system->access[c];
+    // initial data of program images is merged in core order, same as stores
+    for (int i = 0; i < DATA_MEMORY_SIZE; ++i) {
+      if (system->cores[c]->data_memory[i]) {
+        system->shared_memory[i] = system->cores[c]->data_memory[i];
+      }
+    }
+  }
+
+  if (ret == SUCCESS) {
+    struct timespec start, stop;
+    Multicore_Thread threads[MAX_CORES];
+    pthread_t handles[MAX_CORES];
+    for (int c = 0; c < num_cores; ++c) {
+      memcpy(system->cores[c]->data_memory, system->shared_memory, sizeof(system->shared_memory));
+      threads[c].system = system;
+      threads[c].id = c;
+    }
+    pthread_barrier_init(&system->barrier, NULL, num_cores);
+    pthread_mutex_init(&system->gate_lock, NULL);
+    pthread_cond_init(&system->gate, NULL);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int started = 1;
+    for (int c = 1; c < num_cores; ++c) {
+      if (pthread_create(&handles[c], NULL, core_thread, &threads[c]) != 0) {
+        break;
+      }
+      started++;
+    }
+    pthread_mutex_lock(&system->gate_lock);
+    if (started < num_cores) {
+      fprintf(stderr, "APEX_Error : Unable to start a host thread for every core\n");
+      system->done = 1; // started threads leave without waiting on the barrier
+      ret = ERROR;
+    }
+    system->gate_open = 1;
+    pthread_cond_broadcast(&system->gate);
+    pthread_mutex_unlock(&system->gate_lock);
+    if (ret == SUCCESS) {
+      core_thread(&threads[0]); // core 0 runs on calling thread
+    }
+    for (int c = 1; c < started; ++c) {
+      pthread_join(handles[c], NULL);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+    pthread_cond_destroy(&system->gate);
+    pthread_mutex_destroy(&system->gate_lock);
+    pthread_barrier_destroy(&system->barrier);
+    double seconds = (stop.tv_sec - start.tv_sec) + (stop.tv_nsec - start.tv_nsec) / 1e9;
+
+    if (ret == SUCCESS) {
+      long long loads = 0;
+      long long stores = 0;
+      int cycles = 0;
+      for (int c = 0; c < num_cores; ++c) {
+        const APEX_CPU* cpu = system->cores[c];
+        printf("Core %d :: %s, %s, Cycles %d, Instructions %d, CPI %.3f, Loads %d, Stores %d\n",
+               c, programs[c], (system->ret[c] == HALT) ? "HALT" : (system->ret[c] == EMPTY) ? "No More Instructions" : "Running",
+               cpu->clock, cpu->counters.ins_retired, cpu->counters.ins_retired ? (double)cpu->clock / cpu->counters.ins_retired : 0.0,
+               cpu->counters.loads, cpu->counters.stores);
+        loads += cpu->counters.loads;
+        stores += cpu->counters.stores;
+        cycles = (cpu->clock > cycles) ? cpu->clock : cycles;
+      }
+      printf("Multi-core :: %d cores, %d cycles, quantum %d cycles, %d quanta, %.3f ms\n",
+             num_cores, cycles, quantum, system->quanta, seconds * 1e3);
+      printf("Shared Memory :: Loads %lld, Stores %lld, Contended Locations %lld (Written by many cores %lld), Loads of Contended Locations %lld\n",
+             loads, stores, system->contention.contended, system->contention.write_write, system->contention.shared_loads);
+      for (int c = 0; c < num_cores; ++c) {
+        printf("============ CORE %d ============\n", c);
+        print_cpu_content(system->cores[c]);
+      }
+    }
+  }
+  for (int c = 0; c < num_cores; ++c) {
+    if (system->cores[c]) {
+      system->cores[c]->memory_access = NULL;
+      APEX_cpu_stop(system->cores[c]);
+    }
+  }
+  free(system);
+  return ret;
+}
@@ -0,0 +1,686 @@
+/*
+ *  ooo.c
+ *  Contains the out-of-order engine, an alternative to the 7 stage pipeline
+ *  over the same code memory and architectural state. Instructions are renamed
+ *  onto a physical register file, wait in an issue queue till their operands
+ *  are ready, loads and stores keep program order in a load/store queue and a
+ *  reorder buffer commits them to registers, flags and memory in order
+ *
+ *  Author :
+ *  Sagar Vishwakarma (svishwa2@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#include "cpu.h"
+
+/* State of a reorder buffer entry */
+enum {
+  OOO_WAITING,  // in issue queue till operands are ready
+  OOO_ISSUED,   // executing, result is written at done_cycle
+  OOO_DONE      // result written, waits to commit
+};
+
+/* Errors found while executing, reported once the instruction commits so wrong path ones stay silent */
+enum {
+  FAULT_NONE,
+  FAULT_REGISTER,
+  FAULT_READ,
+  FAULT_WRITE,
+  FAULT_DIVIDE,
+  FAULT_BRANCH
+};
+
+static int is_memory(int opcode) {
+  return (opcode == OP_LOAD) || (opcode == OP_LDR) || (opcode == OP_STORE) || (opcode == OP_STR);
+}
+
+static int is_store(int opcode) {
+  return (opcode == OP_STORE) || (opcode == OP_STR);
+}
+
+static int writes_zero_flag(int opcode) {
+  return (opcode == OP_ADD) || (opcode == OP_ADDL) || (opcode == OP_SUB) || (opcode == OP_SUBL) ||
+         (opcode == OP_MUL) || (opcode == OP_DIV);
+}
+
+static int writes_rd(const APEX_Instruction* ins) {
+  switch (ins->format) {
+    case FMT_RD_RS1_IMM:
+    case FMT_RD_RS1_RS2:
+      return !is_store(ins->opcode);
+    case FMT_RD_IMM:
+    case FMT_RD_RS1:
+      return 1;
+    default:
+      return 0;
+  }
+}
+
+static const APEX_Instruction* get_entry_instruction(const APEX_CPU* cpu, const APEX_ROB_Entry* entry) {
+  // entries past the end of code memory are never decoded
+  return (entry->opcode == OP_EMPTY) ? NULL : &cpu->code_memory[get_code_index(entry->pc)];
+}
+
+static int get_rob_slot(const APEX_CPU* cpu, int age) {
+  // ROB index of the entry age places after the oldest one
+  return (cpu->ooo.rob_head + age) % cpu->config.rob_size;
+}
+
+static int get_rob_age(const APEX_CPU* cpu, int slot) {
+  return (slot - cpu->ooo.rob_head + cpu->config.rob_size) % cpu->config.rob_size;
+}
+
+static void start_engine(APEX_CPU* cpu) {
+  // Every register and the zero flag map to a ready physical register holding its committed value
+  APEX_OoO* ooo = &cpu->ooo;
+  for (int i = 0; i < REGISTER_FILE_SIZE; ++i) {
+    ooo->rat[i] = i;
+    ooo->prf_value[i] = cpu->regs[i];
+    ooo->prf_ready[i] = 1;
+  }
+  ooo->rat[OOO_ZF_REG] = OOO_ZF_REG;
+  ooo->prf_value[OOO_ZF_REG] = cpu->flags[ZF];
+  ooo->prf_ready[OOO_ZF_REG] = 1;
+  ooo->free_count = 0;
+  for (int i = cpu->config.prf_size - 1; i > OOO_ZF_REG; --i) {
+    ooo->free_list[ooo->free_count++] = i;
+  }
+  ooo->rob_head = ooo->rob_count = ooo->iq_count = ooo->lsq_count = 0;
+  ooo->fetch_stopped = ooo->fetch_wait = 0;
+  cpu->icache_pending = 0;
+  ooo->started = 1;
+}
+
+static int rename_dest(APEX_OoO* ooo, int reg, int* prev) {
+  // Gives reg a new physical register, the one it replaces is freed when the instruction commits
+  int phys = ooo->free_list[--ooo->free_count];
+  ooo->prf_ready[phys] = 0;
+  *prev = ooo->rat[reg];
+  ooo->rat[reg] = phys;
+  return phys;
+}
+
+static void free_register(APEX_OoO* ooo, int phys) {
+  ooo->free_list[ooo->free_count++] = phys;
+}
+
+/*
+ * ########################################## Dispatch ##########################################
+ */
+static int dispatch_one(APEX_CPU* cpu) {
+  // Fetches, decodes and renames instruction at pc into the ROB, returns 0 if it has to wait
+  APEX_OoO* ooo = &cpu->ooo;
+  const APEX_Config* config = &cpu->config;
+  int index = get_code_index(cpu->pc);
+  const APEX_Instruction* ins = ((index >= 0) && (index < cpu->code_memory_size)) ? &cpu->code_memory[index] : NULL;
+  int opcode = ins ? ins->opcode : OP_EMPTY;
+  int queued = ins && has_valid_regs(ins) && (opcode != OP_HALT) && (opcode != OP_NOP);
+  int registers = queued ? (writes_rd(ins) + writes_zero_flag(opcode)) : 0;
+
+  if (ooo->rob_count == config->rob_size) {
+    ooo->stall_rob++;
+    return 0;
+  }
+  if (queued && (ooo->iq_count == config->iq_size)) {
+    ooo->stall_iq++;
+    return 0;
+  }
+  if (queued && is_memory(opcode) && (ooo->lsq_count == config->lsq_size)) {
+    ooo->stall_lsq++;
+    return 0;
+  }
+  if (ooo->free_count < registers) {
+    ooo->stall_regs++;
+    return 0;
+  }
+  if (ins && config->l1i_size && (cpu->icache_pending != cpu->pc)) {
+    int cycles = access_instruction_cache(cpu, cpu->pc);
+    if (cycles > 0) {
+      cpu->icache_pending = cpu->pc; // line is taken without another lookup once it arrives
+      ooo->fetch_wait = cycles - 1; // this cycle is the first one lost
+      cpu->counters.stall_icache++;
+      return 0;
+    }
+  }
+  cpu->icache_pending = 0;
+
+  int slot = get_rob_slot(cpu, ooo->rob_count++);
+  APEX_ROB_Entry* entry = &ooo->rob[slot];
+  memset(entry, 0, sizeof(*entry));
+  entry->pc = cpu->pc;
+  entry->opcode = opcode;
+  entry->src[0] = entry->src[1] = entry->src[2] = -1;
+  entry->dest = entry->flag_dest = -1;
+  entry->carry = entry->overflow = -1;
+  entry->next_pc = entry->predicted_pc = cpu->pc + 4;
+
+  if (!queued) {
+    // nothing to execute, HALT, end of code and bad registers stop dispatch till they commit
+    entry->state = OOO_DONE;
+    if (ins && !has_valid_regs(ins)) {
+      entry->fault = FAULT_REGISTER;
+    }
+    ooo->fetch_stopped = (opcode != OP_NOP);
+    cpu->pc += 4;
+    return !ooo->fetch_stopped;
+  }
+
+  // sources are renamed before the destination, ADD R1,R1,R2 reads the old R1
+  if ((ins->format == FMT_RD_RS1_IMM) || (ins->format == FMT_RD_RS1_RS2) ||
+      (ins->format == FMT_RD_RS1) || (ins->format == FMT_RS1_IMM)) {
+    entry->src[0] = ooo->rat[ins->rs1];
+  }
+  if (ins->format == FMT_RD_RS1_RS2) {
+    entry->src[1] = ooo->rat[ins->rs2];
+  }
+  if ((opcode == OP_BZ) || (opcode == OP_BNZ)) {
+    entry->src[1] = ooo->rat[OOO_ZF_REG];
+  }
+  if (is_store(opcode)) {
+    entry->src[2] = ooo->rat[ins->rd];
+  }
+  if (writes_rd(ins)) {
+    entry->dest = rename_dest(ooo, ins->rd, &entry->prev_dest);
+  }
+  if (writes_zero_flag(opcode)) {
+    entry->flag_dest = rename_dest(ooo, OOO_ZF_REG, &entry->prev_flag);
+  }
+  entry->state = OOO_WAITING;
+  ooo->iq[ooo->iq_count++] = slot;
+  if (is_memory(opcode)) {
+    ooo->lsq[ooo->lsq_count++] = slot;
+  }
+
+  // Next pc, predicted taken branches end the group, a JUMP target is known only once it executes
+  int target = 0;
+  if (((opcode == OP_BZ) || (opcode == OP_BNZ)) && predict_branch(cpu, cpu->pc, &target)) {
+    entry->predicted_pc = cpu->pc = target;
+    return 0;
+  }
+  if (opcode == OP_JUMP) {
+    entry->predicted_pc = 0;
+    ooo->fetch_stopped = 1;
+    return 0;
+  }
+  cpu->pc += 4;
+  return 1;
+}
+
+static void dispatch(APEX_CPU* cpu) {
+  // Up to width instructions a cycle enter the ROB in program order
+  APEX_OoO* ooo = &cpu->ooo;
+  if (ooo->fetch_wait > 0) {
+    ooo->fetch_wait--;
+    if (cpu->icache_pending) {
+      cpu->counters.stall_icache++;
+    }
+    else {
+      cpu->counters.stall_branch++;
+    }
+    return;
+  }
+  for (int i = 0; (i < cpu->config.width) && !ooo->fetch_stopped; ++i) {
+    if (!dispatch_one(cpu)) {
+      break;
+    }
+  }
+}
+
+/*
+ * ########################################## Issue ##########################################
+ */
+static int operands_ready(const APEX_OoO* ooo, const APEX_ROB_Entry* entry) {
+  for (int i = 0; i < 3; ++i) {
+    if ((entry->src[i] >= 0) && !ooo->prf_ready[entry->src[i]]) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+static int find_wait_cause(const APEX_CPU* cpu, const APEX_ROB_Entry* entry, int* cause) {
+  // Register of the first operand not computed yet, STALL_FLAGS for the zero flag of BZ, BNZ, 0 if all are ready
+  const APEX_Instruction* ins = get_entry_instruction(cpu, entry);
+  int flags = (entry->opcode == OP_BZ) || (entry->opcode == OP_BNZ);
+  const int regs[3] = {ins->rs1, flags ? STALL_FLAGS : ins->rs2, ins->rd};
+  for (int i = 0; i < 3; ++i) {
+    if ((entry->src[i] >= 0) && !cpu->ooo.prf_ready[entry->src[i]]) {
+      *cause = regs[i];
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static int older_stores_issued(const APEX_CPU* cpu, int slot) {
+  // A load waits till every older store knows its address, loads never pass an unknown store
+  const APEX_OoO* ooo = &cpu->ooo;
+  for (int i = 0; (i < ooo->lsq_count) && (ooo->lsq[i] != slot); ++i) {
+    const APEX_ROB_Entry* older = &ooo->rob[ooo->lsq[i]];
+    if (is_store(older->opcode) && (older->state == OOO_WAITING)) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+static const APEX_ROB_Entry* find_forwarding_store(const APEX_CPU* cpu, int slot, int mem_address) {
+  // Youngest store older than the load writing the same location, NULL to read data memory
+  const APEX_OoO* ooo = &cpu->ooo;
+  const APEX_ROB_Entry* store = NULL;
+  for (int i = 0; (i < ooo->lsq_count) && (ooo->lsq[i] != slot); ++i) {
+    const APEX_ROB_Entry* older = &ooo->rob[ooo->lsq[i]];
+    if (is_store(older->opcode) && (older->mem_address == mem_address)) {
+      store = older;
+    }
+  }
+  return store;
+}
+
+static int execute_load(APEX_CPU* cpu, int slot, APEX_ROB_Entry* entry, int* value) {
+  // Reads from an older store or data memory, returns cycles after the address is computed
+  if (!is_valid_mem(entry->mem_address)) {
+    entry->fault = FAULT_READ;
+    *value = 0; // like the functional model, value 0 is written back
+    return 0;
+  }
+  const APEX_ROB_Entry* store = find_forwarding_store(cpu, slot, entry->mem_address);
+  if (store) {
+    cpu->ooo.forwarded++;
+    *value = store->store_value;
+    return 1;
+  }
+  *value = cpu->data_memory[entry->mem_address];
+  if (cpu->config.l1d_size) {
+    return access_data_cache(cpu, entry->mem_address, 0);
+  }
+  return cpu->config.mem_latency;
+}
+
+static void execute(APEX_CPU* cpu, int slot) {
+  // Computes result of the entry now, dependents see it once done_cycle is reached
+  APEX_OoO* ooo = &cpu->ooo;
+  APEX_ROB_Entry* entry = &ooo->rob[slot];
+  const APEX_Instruction* ins = get_entry_instruction(cpu, entry);
+  int rs1_value = (entry->src[0] >= 0) ? ooo->prf_value[entry->src[0]] : 0;
+  int rs2_value = (entry->src[1] >= 0) ? ooo->prf_value[entry->src[1]] : 0;
+  int zero_flag = rs2_value; // BZ, BNZ read the flag in place of rs2
+  int value = 0;
+  int latency = 1;
+
+  switch (ins->opcode) {
+    case OP_STORE:
+    case OP_STR:
+      entry->mem_address = rs1_value + ((ins->opcode == OP_STORE) ? ins->imm : rs2_value);
+      entry->store_value = ooo->prf_value[entry->src[2]];
+      if (!is_valid_mem(entry->mem_address)) {
+        entry->fault = FAULT_WRITE;
+      }
+      break;
+    case OP_LOAD:
+    case OP_LDR:
+      entry->mem_address = rs1_value + ((ins->opcode == OP_LOAD) ? ins->imm : rs2_value);
+      latency += execute_load(cpu, slot, entry, &value);
+      break;
+    case OP_MOVC:
+      value = ins->imm;
+      break;
+    case OP_MOV:
+      value = rs1_value;
+      break;
+    case OP_ADDL:
+      rs2_value = ins->imm;
+      /* fall through */
+    case OP_ADD:
+      // on overflow the pipeline keeps result 0 from the latch
+      if ((rs2_value > 0 && rs1_value > INT_MAX - rs2_value) ||
+          (rs2_value < 0 && rs1_value < INT_MIN - rs2_value)) {
+        entry->overflow = 1;
+        value = 0;
+      }
+      else {
+        entry->overflow = 0;
+        value = rs1_value + rs2_value;
+      }
+      zero_flag = (value == 0);
+      break;
+    case OP_SUBL:
+      rs2_value = ins->imm;
+      /* fall through */
+    case OP_SUB:
+      entry->carry = (rs2_value > rs1_value); // there is a carry if subtrahend is bigger
+      value = rs1_value - rs2_value;
+      zero_flag = (value == 0);
+      break;
+    case OP_MUL:
+      value = rs1_value * rs2_value;
+      zero_flag = (value == 0);
+      break;
+    case OP_DIV:
+      if (rs2_value != 0) {
+        value = rs1_value / rs2_value;
+        zero_flag = (rs1_value % rs2_value != 0); // remainder decides zero flag, same as writeback
+      }
+      else {
+        entry->fault = FAULT_DIVIDE;
+        zero_flag = 0;
+      }
+      break;
+    case OP_AND:
+      value = rs1_value & rs2_value;
+      break;
+    case OP_OR:
+      value = rs1_value | rs2_value;
+      break;
+    case OP_EXOR:
+      value = rs1_value ^ rs2_value;
+      break;
+    case OP_BZ:
+    case OP_BNZ:
+      entry->taken = (zero_flag == (ins->opcode == OP_BZ));
+      if (entry->taken && is_valid_branch(entry->pc, ins->imm)) {
+        entry->next_pc = entry->pc + ins->imm;
+      }
+      else if (entry->taken) {
+        entry->fault = FAULT_BRANCH;
+        entry->taken = 0; // like the pipeline, an invalid target is not taken
+      }
+      break;
+    case OP_JUMP:
+      entry->mem_address = rs1_value + ins->imm;
+      if (is_valid_branch(entry->pc, entry->mem_address)) {
+        entry->next_pc = entry->mem_address;
+      }
+      else {
+        entry->fault = FAULT_BRANCH;
+      }
+      break;
+    default:
+      ;
+  }
+  if (entry->dest >= 0) {
+    ooo->prf_value[entry->dest] = value;
+  }
+  if (entry->flag_dest >= 0) {
+    ooo->prf_value[entry->flag_dest] = zero_flag;
+  }
+  if (get_unit_kind(ins->opcode) != FU_NONE) {
+    latency = start_unit(cpu, ins->opcode);
+  }
+  entry->done_cycle = cpu->clock + latency;
+  entry->state = OOO_ISSUED;
+}
+
+static void issue(APEX_CPU* cpu) {
+  // Oldest instructions with ready operands and a free functional unit leave the issue queue, up to width a cycle
+  APEX_OoO* ooo = &cpu->ooo;
+  int issued = 0;
+  int i = 0;
+  int unit_waits[NUM_FU_KINDS] = {0};
+  while ((i < ooo->iq_count) && (issued < cpu->config.width)) {
+    int slot = ooo->iq[i];
+    const APEX_ROB_Entry* entry = &ooo->rob[slot];
+    int load = is_memory(entry->opcode) && !is_store(entry->opcode);
+    if (!operands_ready(ooo, entry) || (load && !older_stores_issued(cpu, slot))) {
+      i++;
+      continue;
+    }
+    if (!unit_free(cpu, entry->opcode)) {
+      unit_waits[get_unit_kind(entry->opcode)] = 1; // structural hazard, every unit of its kind is busy
+      i++;
+      continue;
+    }
+    execute(cpu, slot);
+    memmove(&ooo->iq[i], &ooo->iq[i + 1], sizeof(int) * (ooo->iq_count - i - 1));
+    ooo->iq_count--;
+    issued++;
+  }
+  int unit_wait = 0;
+  for (int kind = FU_ALU; kind < NUM_FU_KINDS; ++kind) {
+    cpu->units.stalls[kind] += unit_waits[kind];
+    unit_wait |= unit_waits[kind];
+  }
+  if (!issued && unit_wait) {
+    cpu->counters.stall_structural++; // a ready instruction found every unit of its kind busy
+  }
+  else if (!issued && ooo->iq_count) {
+    // every waiting instruction needs a value not computed yet, counted on the oldest one like a Decode/RF stall
+    for (int j = 0; j < ooo->iq_count; ++j) {
+      if (find_wait_cause(cpu, &ooo->rob[ooo->iq[j]], &cpu->counters.stall_cause)) {
+        break;
+      }
+    }
+    count_data_stall(cpu, 1);
+  }
+}
+
+/*
+ * ########################################## Complete ##########################################
+ */
+static void remove_younger(int* queue, int* count, const APEX_CPU* cpu, int age) {
+  // drops ROB indices of entries younger than age from an issue or load/store queue
+  int kept = 0;
+  for (int i = 0; i < *count; ++i) {
+    if (get_rob_age(cpu, queue[i]) <= age) {
+      queue[kept++] = queue[i];
+    }
+  }
+  *count = kept;
+}
+
+static void squash_after(APEX_CPU* cpu, int age) {
+  // Mispredicted branch or jump at age, younger entries are undone youngest first and fetch restarts
+  APEX_OoO* ooo = &cpu->ooo;
+  while (ooo->rob_count > age + 1) {
+    const APEX_ROB_Entry* entry = &ooo->rob[get_rob_slot(cpu, ooo->rob_count - 1)];
+    const APEX_Instruction* ins = get_entry_instruction(cpu, entry);
+    if (entry->flag_dest >= 0) {
+      ooo->rat[OOO_ZF_REG] = entry->prev_flag;
+      free_register(ooo, entry->flag_dest);
+    }
+    if (entry->dest >= 0) {
+      ooo->rat[ins->rd] = entry->prev_dest;
+      free_register(ooo, entry->dest);
+    }
+    ooo->rob_count--;
+    ooo->squashed++;
+    cpu->counters.squashed++;
+  }
+  cpu->counters.flushes++;
+  remove_younger(ooo->iq, &ooo->iq_count, cpu, age);
+  remove_younger(ooo->lsq, &ooo->lsq_count, cpu, age);
+  cpu->pc = ooo->rob[get_rob_slot(cpu, age)].next_pc;
+  ooo->fetch_stopped = 0;
+  ooo->fetch_wait = cpu->config.branch_penalty;
+  cpu->icache_pending = 0;
+}
+
+static void complete(APEX_CPU* cpu) {
+  // Results due this cycle wake up their dependents, a branch or jump that went the other way squashes
+  APEX_OoO* ooo = &cpu->ooo;
+  for (int age = 0; age < ooo->rob_count; ++age) {
+    APEX_ROB_Entry* entry = &ooo->rob[get_rob_slot(cpu, age)];
+    if ((entry->state != OOO_ISSUED) || (entry->done_cycle > cpu->clock)) {
+      continue;
+    }
+    entry->state = OOO_DONE;
+    if (entry->dest >= 0) {
+      ooo->prf_ready[entry->dest] = 1;
+    }
+    if (entry->flag_dest >= 0) {
+      ooo->prf_ready[entry->flag_dest] = 1;
+    }
+    if (entry->next_pc != entry->predicted_pc) {
+      squash_after(cpu, age);
+      break;
+    }
+  }
+}
+
+/*
+ * ########################################## Commit ##########################################
+ */
+static int commit_memory(APEX_CPU* cpu, const APEX_ROB_Entry* entry) {
+  // Stores write data memory only at commit, wrong path stores never reach it
+  if (entry->fault == FAULT_WRITE) {
+    fprintf(stderr, "Segmentation fault for writing memory location :: %d\n", entry->mem_address);
+  }
+  else if (entry->fault == FAULT_READ) {
+    fprintf(stderr, "Segmentation fault for accessing memory location :: %d\n", entry->mem_address);
+  }
+  else if (is_store(entry->opcode)) {
+    cpu->data_memory[entry->mem_address] = entry->store_value;
+    cpu->counters.stores++;
+    if (cpu->config.l1d_size) {
+      access_data_cache(cpu, entry->mem_address, 1); // store buffer, commit does not wait for it
+    }
+    if (cpu->memory_access) {
+      cpu->memory_access[entry->mem_address] |= MEMORY_WRITTEN;
+    }
+  }
+  else {
+    cpu->counters.loads++;
+    if (cpu->memory_access) {
+      cpu->memory_access[entry->mem_address] |= MEMORY_READ;
+    }
+  }
+  cpu->ooo.lsq_count--;
+  memmove(&cpu->ooo.lsq[0], &cpu->ooo.lsq[1], sizeof(int) * cpu->ooo.lsq_count);
+  return SUCCESS;
+}
+
+static int commit_one(APEX_CPU* cpu, APEX_ROB_Entry* entry) {
+  // Oldest instruction updates architectural state, returns HALT, EMPTY or ERROR to end the run
+  APEX_OoO* ooo = &cpu->ooo;
+  const APEX_Instruction* ins = get_entry_instruction(cpu, entry);
+  if (entry->opcode == OP_EMPTY) {
+    return EMPTY;
+  }
+  if (entry->fault == FAULT_REGISTER) {
+    fprintf(stderr, "Segmentation fault for Register location in %s at pc(%d)\n", get_opcode_name(ins->opcode), entry->pc);
+    return ERROR;
+  }
+  if (is_memory(entry->opcode)) {
+    commit_memory(cpu, entry);
+  }
+  else if (entry->fault == FAULT_DIVIDE) {
+    fprintf(stderr, "Division By Zero Returning Value Zero\n");
+  }
+  else if (entry->fault == FAULT_BRANCH) {
+    fprintf(stderr, "Invalid Branch Loction for %s\n", get_opcode_name(ins->opcode));
+    fprintf(stderr, "Instruction %s Relative Address %d\n", get_opcode_name(ins->opcode),
+            entry->pc + ((ins->opcode == OP_JUMP) ? entry->mem_address : ins->imm));
+  }
+  if (entry->dest >= 0) {
+    cpu->regs[ins->rd] = ooo->prf_value[entry->dest];
+    free_register(ooo, entry->prev_dest);
+  }
+  if (entry->flag_dest >= 0) {
+    cpu->flags[ZF] = ooo->prf_value[entry->flag_dest];
+    free_register(ooo, entry->prev_flag);
+  }
+  if (entry->carry >= 0) {
+    cpu->flags[CF] = entry->carry;
+  }
+  if (entry->overflow >= 0) {
+    cpu->flags[OF] = entry->overflow;
+  }
+  if ((entry->opcode == OP_BZ) || (entry->opcode == OP_BNZ)) {
+    cpu->predictor.branches++;
+    if (entry->next_pc != entry->predicted_pc) {
+      cpu->predictor.mispredictions++;
+    }
+    train_predictor(cpu, entry->pc, entry->taken, entry->pc + ins->imm);
+  }
+  cpu->counters.ins_completed++;
+  cpu->counters.ins_retired++;
+  if (entry->opcode == OP_HALT) {
+    cpu->flags[IF] = 1; // Halt as Interrupt
+    return HALT;
+  }
+  return SUCCESS;
+}
+
+static int commit(APEX_CPU* cpu) {
+  // Up to width done instructions leave the ROB in program order
+  APEX_OoO* ooo = &cpu->ooo;
+  for (int i = 0; (i < cpu->config.width) && ooo->rob_count; ++i) {
+    APEX_ROB_Entry* entry = &ooo->rob[ooo->rob_head];
+    if (entry->state != OOO_DONE) {
+      break;
+    }
+    int ret = commit_one(cpu, entry);
+    ooo->rob_head = get_rob_slot(cpu, 1);
+    ooo->rob_count--;
+    if (ret != SUCCESS) {
+      return ret;
+    }
+  }
+  return SUCCESS;
+}
+
+/*
+ * ########################################## Engine Run ##########################################
+ */
+static void print_engine(APEX_CPU* cpu) {
+  // Every ROB entry oldest first, the view display and simulate give of the out-of-order engine
+  static const char* states[] = {"Waiting", "Issued", "Done"};
+  APEX_OoO* ooo = &cpu->ooo;
+  fprintf(cpu->out, "\n--------------------------------\n");
+  fprintf(cpu->out, "Clock Cycle #: %d\n", cpu->clock);
+  fprintf(cpu->out, "%-15s: %-8s: Instruction\n", "Reorder Buffer", "State");
+  fprintf(cpu->out, "--------------------------------\n");
+  for (int age = 0; age < ooo->rob_count; ++age) {
+    int slot = get_rob_slot(cpu, age);
+    const APEX_ROB_Entry* entry = &ooo->rob[slot];
+    const APEX_Instruction* ins = get_entry_instruction(cpu, entry);
+    char name[24]; // room for "ROB[" and any int
+    snprintf(name, sizeof(name), "ROB[%d]", slot);
+    fprintf(cpu->out, "%-15s: %-8s: pc(%d) ", name, states[entry->state], entry->pc);
+    if (ins) {
+      print_instruction(cpu->out, ins);
+    }
+    fprintf(cpu->out, "\n");
+  }
+  fprintf(cpu->out, "%-15s: pc(%d)%s\n", "Fetch", cpu->pc, ooo->fetch_stopped ? " ---> STOPPED" : "");
+}
+
+int APEX_ooo_cycle(APEX_CPU* cpu) {
+  // Simulates one clock cycle of the out-of-order engine, returns HALT, EMPTY or ERROR once they commit.
+  // Stages run oldest first, a result written this cycle lets its dependents issue in the same cycle
+  if (!cpu->ooo.started) {
+    start_engine(cpu);
+  }
+  cpu->clock++;
+  int ret = commit(cpu);
+  if (ret == SUCCESS) {
+    complete(cpu);
+    issue(cpu);
+    dispatch(cpu);
+  }
+  cpu->ooo.rob_occupancy += cpu->ooo.rob_count;
+  cpu->ooo.iq_occupancy += cpu->ooo.iq_count;
+  if (!cpu->quiet) {
+    print_engine(cpu);
+  }
+  return ret;
+}
+
+void print_ooo_stats(APEX_CPU* cpu) {
+  // Instructions per cycle and what held dispatch back, nothing for the in-order pipeline
+  const APEX_OoO* ooo = &cpu->ooo;
+  if (!cpu->config.engine) {
+    return;
+  }
+  fprintf(cpu->out, "Out-of-Order :: IPC %.2f, ROB Occupancy %.2f, Issue Queue Occupancy %.2f, Squashed %d, Loads Forwarded %d\n",
+          cpu->clock ? (double)cpu->counters.ins_retired / cpu->clock : 0.0,
+          cpu->clock ? (double)ooo->rob_occupancy / cpu->clock : 0.0,
+          cpu->clock ? (double)ooo->iq_occupancy / cpu->clock : 0.0,
+          ooo->squashed, ooo->forwarded);
+  fprintf(cpu->out, "Cycles Dispatch waited on ROB %d, Issue Queue %d, Load/Store Queue %d, Physical Registers %d\n",
+          ooo->stall_rob, ooo->stall_iq, ooo->stall_lsq, ooo->stall_regs);
+}
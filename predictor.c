@@ -0,0 +1,74 @@
+/*
+ *  predictor.c
+ *  Contains dynamic branch prediction used by Fetch, a direct mapped branch
+ *  target buffer gives the target and 2-bit counters (bimodal or gshare)
+ *  decide if BZ, BNZ are taken, branches train the predictor in Execute Two
+ *
+ *  Author :
+ *  Sagar Vishwakarma (svishwa2@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpu.h"
+
+static int get_btb_index(const APEX_CPU* cpu, int pc) {
+  return get_code_index(pc) % cpu->config.btb_entries;
+}
+
+static int get_counter_index(const APEX_CPU* cpu, int pc) {
+  // bimodal uses pc only, gshare hashes global history into it
+  unsigned int index = (unsigned int)get_code_index(pc);
+  if (cpu->config.predictor == 2) {
+    index ^= cpu->predictor.history & ((1u << cpu->config.history_bits) - 1);
+  }
+  return index % PREDICTOR_TABLE_SIZE;
+}
+
+int predict_branch(APEX_CPU* cpu, int pc, int* target) {
+  // Returns 1 if branch at pc is predicted taken, target is then taken from the BTB
+  const APEX_Predictor* predictor = &cpu->predictor;
+  int entry = get_btb_index(cpu, pc);
+  if (!cpu->config.predictor || (predictor->btb_pc[entry] != pc)) {
+    return 0; // unknown branches fall through like without a predictor
+  }
+  if (predictor->counters[get_counter_index(cpu, pc)] < 2) {
+    return 0;
+  }
+  *target = predictor->btb_target[entry];
+  return 1;
+}
+
+void train_predictor(APEX_CPU* cpu, int pc, int taken, int target) {
+  // Outcome of branch at pc resolved in Execute Two, taken branches enter the BTB
+  APEX_Predictor* predictor = &cpu->predictor;
+  if (!cpu->config.predictor) {
+    return;
+  }
+  unsigned char* counter = &predictor->counters[get_counter_index(cpu, pc)];
+  if (taken && (*counter < 3)) {
+    (*counter)++;
+  }
+  else if (!taken && (*counter > 0)) {
+    (*counter)--;
+  }
+  if (taken) {
+    int entry = get_btb_index(cpu, pc);
+    predictor->btb_pc[entry] = pc;
+    predictor->btb_target[entry] = target;
+  }
+  predictor->history = (predictor->history << 1) | (taken != 0);
+}
+
+void print_branch_stats(APEX_CPU* cpu) {
+  // Accuracy of branch prediction and mispredictions per thousand instructions
+  static const char* names[] = {"None (Not Taken)", "Bimodal", "Gshare"};
+  const APEX_Predictor* predictor = &cpu->predictor;
+  fprintf(cpu->out, "Branches %d, Mispredicted %d, Accuracy %.2f%%, MPKI %.2f, Predictor %s\n",
+          predictor->branches, predictor->mispredictions,
+          predictor->branches ? 100.0 * (predictor->branches - predictor->mispredictions) / predictor->branches : 100.0,
+          cpu->counters.ins_retired ? 1000.0 * predictor->mispredictions / cpu->counters.ins_retired : 0.0,
+          names[cpu->config.predictor]);
+}
@@ -0,0 +1,147 @@
+/*
+ *  program_image.c
+ *  Contains functions to write and load pre-assembled program images (.apexo),
+ *  an image holds decoded code memory so it can be mapped without parsing
+ *
+ *  Author :
+ *  Sagar Vishwakarma (svishwa2@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "cpu.h"
+
+/* Bump this whenever APEX_Instruction or the opcode numbering changes */
+#define APEX_IMAGE_VERSION 2
+
+static const char apex_image_magic[8] = {'A', 'P', 'E', 'X', 'O', 'B', 'J', '\0'};
+
+/*
+ * Layout of an image file
+ *   APEX_Image_Header
+ *   APEX_Instruction code_memory[code_memory_size]
+ *   int data_memory[data_memory_size]   (initial values of data memory from address 0)
+ */
+typedef struct APEX_Image_Header {
+  char magic[8];          // Identifies an image file
+  int version;            // APEX_IMAGE_VERSION of the writer
+  int instruction_size;   // sizeof(APEX_Instruction) of the writer
+  int code_memory_size;   // Number of instructions
+  int data_memory_size;   // Number of initialized data memory locations, 0 if none
+} APEX_Image_Header;
+
+int is_program_image(const char* filename) {
+  // Checks magic at start of file, text .asm files never start with it
+  FILE* fp = fopen(filename, "rb");
+  if (!fp) {
+    return 0;
+  }
+  char magic[sizeof(apex_image_magic)];
+  int found = (fread(magic, 1, sizeof(magic), fp) == sizeof(magic)) &&
+              (memcmp(magic, apex_image_magic, sizeof(magic)) == 0);
+  fclose(fp);
+  return found;
+}
+
+int write_program_image(const char* filename, const APEX_Instruction* code_memory, int code_memory_size,
+                        const int* data_memory, int data_memory_size) {
+  // Writes header, decoded code memory and optional initial data memory
+  if (!filename || !code_memory || (code_memory_size <= 0) ||
+      (data_memory_size < 0) || (data_memory_size > DATA_MEMORY_SIZE) || (data_memory_size && !data_memory)) {
+    return ERROR;
+  }
+  for (int i = 0; i < code_memory_size; ++i) {
+    if (!is_valid_instruction(&code_memory[i])) {
+      // load_program_image would refuse it, registers outside the register file are left to text programs
+      fprintf(stderr, "APEX_Error : Instruction at pc(%d) can not be stored in a program image\n", 4000 + 4 * i);
+      return ERROR;
+    }
+  }
+  FILE* fp = fopen(filename, "wb");
+  if (!fp) {
+    return ERROR;
+  }
+  APEX_Image_Header header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, apex_image_magic, sizeof(header.magic));
+  header.version = APEX_IMAGE_VERSION;
+  header.instruction_size = sizeof(APEX_Instruction);
+  header.code_memory_size = code_memory_size;
+  header.data_memory_size = data_memory_size;
+
+  int ret = SUCCESS;
+  if ((fwrite(&header, sizeof(header), 1, fp) != 1) ||
+      (fwrite(code_memory, sizeof(*code_memory), code_memory_size, fp) != (size_t)code_memory_size) ||
+      (fwrite(data_memory, sizeof(*data_memory), data_memory_size, fp) != (size_t)data_memory_size)) {
+    ret = ERROR;
+  }
+  if (fclose(fp) != 0) {
+    ret = ERROR;
+  }
+  return ret;
+}
+
+int load_program_image(APEX_CPU* cpu, const char* filename) {
+  // Maps image read only, code memory points straight into the mapping
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0) {
+    return ERROR;
+  }
+  struct stat st;
+  if ((fstat(fd, &st) != 0) || ((size_t)st.st_size < sizeof(APEX_Image_Header))) {
+    close(fd);
+    return ERROR;
+  }
+  size_t image_size = st.st_size;
+  void* image = mmap(NULL, image_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd); // mapping stays valid after closing the file
+  if (image == MAP_FAILED) {
+    return ERROR;
+  }
+
+  const APEX_Image_Header* header = image;
+  size_t code_bytes = (size_t)header->code_memory_size * sizeof(APEX_Instruction);
+  size_t data_bytes = (size_t)header->data_memory_size * sizeof(int);
+  if ((memcmp(header->magic, apex_image_magic, sizeof(header->magic)) != 0) ||
+      (header->version != APEX_IMAGE_VERSION) ||
+      (header->instruction_size != sizeof(APEX_Instruction)) ||
+      (header->code_memory_size <= 0) ||
+      (header->data_memory_size < 0) || (header->data_memory_size > DATA_MEMORY_SIZE) ||
+      (image_size < sizeof(*header) + code_bytes + data_bytes)) {
+    fprintf(stderr, "APEX_Error : %s is not a valid version %d program image\n", filename, APEX_IMAGE_VERSION);
+    munmap(image, image_size);
+    return ERROR;
+  }
+  // opcode, format and registers index handler tables and the register file, none is trusted as read
+  const APEX_Instruction* code_memory = (const APEX_Instruction*)((const char*)image + sizeof(*header));
+  for (int i = 0; i < header->code_memory_size; ++i) {
+    if (!is_valid_instruction(&code_memory[i])) {
+      fprintf(stderr, "APEX_Error : %s has an invalid instruction at pc(%d)\n", filename, 4000 + 4 * i);
+      munmap(image, image_size);
+      return ERROR;
+    }
+  }
+
+  cpu->code_memory = (APEX_Instruction*)((char*)image + sizeof(*header));
+  cpu->code_memory_size = header->code_memory_size;
+  memcpy(cpu->data_memory, (char*)image + sizeof(*header) + code_bytes, data_bytes);
+  cpu->program_image = image;
+  cpu->program_image_size = image_size;
+  return SUCCESS;
+}
+
+void unload_program_image(APEX_CPU* cpu) {
+  // Unmaps image, code memory is no longer valid after this
+  if (cpu->program_image) {
+    munmap(cpu->program_image, cpu->program_image_size);
+    cpu->program_image = NULL;
+    cpu->program_image_size = 0;
+    cpu->code_memory = NULL;
+  }
+}
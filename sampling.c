@@ -0,0 +1,176 @@
+/*
+ *  sampling.c
+ *  Contains sampled simulation of long APEX programs, the program runs
+ *  functionally and only short windows go through the 7 stage pipeline.
+ *  Each period fast-forwards, warms up the pipeline, then measures a detailed
+ *  window, total cycles are extrapolated from CPI of the windows. Caches,
+ *  branch predictor and functional units keep their state from one window
+ *  to the next, so a window does not start cold.
+ *
+ *  Author :
+ *  Sagar Vishwakarma (svishwa2@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+#include <time.h>
+
+#include "cpu.h"
+
+/* Windows taking more cycles per instruction than this are dropped, the pipeline is stuck */
+#define MAX_WINDOW_CPI 64
+
+/* Student t for two sided 95% confidence, indexed by degrees of freedom */
+static const double t_95[] = {
+  0.0, 12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+  2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+  2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042,
+};
+
+static double t_value(int degrees) {
+  if (degrees < (int)(sizeof(t_95) / sizeof(t_95[0]))) {
+    return t_95[degrees];
+  }
+  return 1.960; // normal approximation
+}
+
+/* State a window changes that the program or the run sees, put back once the window is done */
+typedef struct Sample_State {
+  int pc;
+  int clock;
+  int quiet;
+  int regs[REGISTER_FILE_SIZE];
+  int flags[NUM_FLAG];
+  APEX_Counters counters;
+  int data_memory[DATA_MEMORY_SIZE];
+} Sample_State;
+
+static void save_state(const APEX_CPU* cpu, Sample_State* state) {
+  state->pc = cpu->pc;
+  state->clock = cpu->clock;
+  state->quiet = cpu->quiet;
+  memcpy(state->regs, cpu->regs, sizeof(state->regs));
+  memcpy(state->flags, cpu->flags, sizeof(state->flags));
+  state->counters = cpu->counters;
+  memcpy(state->data_memory, cpu->data_memory, sizeof(state->data_memory));
+}
+
+static void restore_state(APEX_CPU* cpu, const Sample_State* state) {
+  cpu->pc = state->pc;
+  cpu->clock = state->clock;
+  cpu->quiet = state->quiet;
+  memcpy(cpu->regs, state->regs, sizeof(state->regs));
+  memcpy(cpu->flags, state->flags, sizeof(state->flags));
+  cpu->counters = state->counters;
+  memcpy(cpu->data_memory, state->data_memory, sizeof(state->data_memory));
+}
+
+static int program_ended(int ret) {
+  return (ret == HALT) || (ret == EMPTY) || (ret == ERROR);
+}
+
+int APEX_cpu_execute_sampled(APEX_CPU* cpu, const APEX_Sample_Schedule* schedule, APEX_Sample_Result* result) {
+  // Architectural state always comes from functional execution, a window simulates the pipeline
+  // and only the architectural state before it is put back, caches and predictor stay warm
+  memset(result, 0, sizeof(*result));
+  if ((schedule->fast_forward < 0) || (schedule->warmup < 0) || (schedule->detail <= 0)) {
+    return ERROR;
+  }
+  Sample_State* saved = malloc(sizeof(*saved));
+  if (!saved) {
+    return ERROR;
+  }
+  long long window_length = (long long)schedule->warmup + schedule->detail;
+  long long max_cycles = window_length * MAX_WINDOW_CPI;
+  if (max_cycles > INT_MAX) {
+    max_cycles = INT_MAX; // clock of the window is an int
+  }
+  double sum = 0.0;
+  double sum_squares = 0.0;
+  int ret = SUCCESS;
+
+  while (!program_ended(ret)) {
+    long long executed = 0;
+    if (schedule->fast_forward > 0) {
+      cpu->warming = 1; // window starts with caches and predictor as the skipped instructions left them
+      ret = APEX_cpu_execute_functional(cpu, schedule->fast_forward, &executed);
+      cpu->warming = 0;
+      result->instructions += executed;
+      if (program_ended(ret)) {
+        break;
+      }
+    }
+
+    // detailed window from the current state, the program goes on from the saved state
+    int cycles = 0;
+    int measured = 0;
+    save_state(cpu, saved);
+    APEX_cpu_run_window(cpu, schedule->warmup, schedule->detail, (int)max_cycles, &cycles, &measured);
+    restore_state(cpu, saved);
+    if ((measured > 0) && (cycles <= (long long)measured * MAX_WINDOW_CPI)) {
+      double cpi = (double)cycles / measured;
+      sum += cpi;
+      sum_squares += cpi * cpi;
+      result->windows++;
+      result->detailed_instructions += measured;
+    }
+    else {
+      result->dropped_windows++;
+    }
+
+    // same instructions again functionally so state moves on in program order
+    ret = APEX_cpu_execute_functional(cpu, window_length, &executed);
+    result->instructions += executed;
+  }
+  free(saved);
+
+  if (result->windows > 0) {
+    int n = result->windows;
+    result->cpi = sum / n;
+    if (n > 1) {
+      double variance = (sum_squares - n * result->cpi * result->cpi) / (n - 1);
+      result->cpi_error = t_value(n - 1) * sqrt((variance > 0) ? variance : 0.0) / sqrt(n);
+    }
+    result->cycles = result->cpi * result->instructions;
+    result->cycles_error = result->cpi_error * result->instructions;
+  }
+  return ret;
+}
+
+int APEX_cpu_run_sampled(APEX_CPU* cpu, const APEX_Sample_Schedule* schedule) {
+  // Runs the program with sampled simulation and reports extrapolated cycles and CPI
+  struct timespec start, stop;
+  APEX_Sample_Result result;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  int ret = APEX_cpu_execute_sampled(cpu, schedule, &result);
+  clock_gettime(CLOCK_MONOTONIC, &stop);
+  double seconds = (stop.tv_sec - start.tv_sec) + (stop.tv_nsec - start.tv_nsec) / 1e9;
+
+  if (ret == HALT) {
+    fprintf(stderr, "Simulation Stoped ....\n");
+    fprintf(cpu->out, "Instruction HALT Encountered\n");
+  }
+  else if (ret == EMPTY) {
+    fprintf(stderr, "Simulation Stoped ....\n");
+    fprintf(cpu->out, "No More Instructions Encountered\n");
+  }
+  fprintf(cpu->out, "Sampled Simulation :: fast-forward %lld, warm-up %d, detail %d instructions\n",
+                    schedule->fast_forward, schedule->warmup, schedule->detail);
+  fprintf(cpu->out, "Windows %d (%d dropped), %lld instructions, %lld simulated in detail, %.3f ms\n",
+                    result.windows, result.dropped_windows, result.instructions, result.detailed_instructions, seconds * 1e3);
+  if (result.windows > 1) {
+    fprintf(cpu->out, "Estimated CPI %.4f +/- %.4f, Estimated Cycles %.0f +/- %.0f (95%% confidence)\n",
+                      result.cpi, result.cpi_error, result.cycles, result.cycles_error);
+  }
+  else if (result.windows == 1) {
+    fprintf(cpu->out, "Estimated CPI %.4f, Estimated Cycles %.0f (one window, no confidence interval)\n",
+                      result.cpi, result.cycles);
+  }
+  else {
+    fprintf(cpu->out, "No window was measured, program is shorter than fast-forward or pipeline got stuck\n");
+  }
+  return ret;
+}
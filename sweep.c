@@ -0,0 +1,418 @@
+/*
+ *  sweep.c
+ *  Contains design space sweeps, every point of a parameter grid (or a random
+ *  sample of it) runs every workload in the pipeline, runs are spread over
+ *  host threads and cycles, CPI and stall breakdown go to a CSV file
+ *
+ *  Author :
+ *  Sagar Vishwakarma (svishwa2@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+
+#include "cpu.h"
+
+#define MAX_SWEEP_AXES 16
+#define MAX_SWEEP_VALUES 256
+#define MAX_SWEEP_POINTS (1 << 20)
+
+/* One parameter of the grid and the values it takes */
+typedef struct Sweep_Axis {
+  char name[32];
+  int values[MAX_SWEEP_VALUES];
+  int num_values;
+} Sweep_Axis;
+
+/* Result of one workload on one configuration */
+typedef struct Sweep_Run {
+  int ret;
+  int cycles;
+  int instructions;
+  int stall_data;
+  int stall_branch;
+  int stall_structural;
+  int mispredictions;
+  int stall_memory;
+  int l1d_misses;
+  int stall_icache;
+  int l1i_misses;
+} Sweep_Run;
+
+/* Configuration and its cycles summed over all workloads, Pareto candidates are sorted by them */
+typedef struct Sweep_Total {
+  long long cycles;
+  int config;
+} Sweep_Total;
+
+typedef struct Sweep {
+  APEX_CPU** workloads;     // parsed once, cloned by every run
+  int num_workloads;
+  APEX_Config* configs;
+  int num_configs;
+  Sweep_Run* runs;          // num_configs * num_workloads, config major
+  int max_cycles;           // a run still going at this cycle is stopped and reported as TIMEOUT
+} Sweep;
+
+static int parse_grid(const char* grid, Sweep_Axis* axes) {
+  // "name=v1,v2,...;name=lo:hi" gives an axis per parameter, returns number of axes or -1
+  int num_axes = 0;
+  const char* p = grid;
+  while (*p) {
+    const char* end = p + strcspn(p, ";");
+    const char* equal = memchr(p, '=', end - p);
+    if (!equal || (equal - p >= (int)sizeof(axes[0].name)) || (num_axes == MAX_SWEEP_AXES)) {
+      return -1;
+    }
+    Sweep_Axis* axis = &axes[num_axes++];
+    memcpy(axis->name, p, equal - p);
+    axis->name[equal - p] = '\0';
+    axis->num_values = 0;
+    int value = 0;
+    APEX_Config check;
+    if (APEX_config_get(&check, axis->name, &value) != SUCCESS) {
+      return -1;
+    }
+    const char* v = equal + 1;
+    while (v < end) {
+      char* value_end = NULL;
+      long lo = strtol(v, &value_end, 10);
+      long hi = lo;
+      if (value_end == v) {
+        return -1;
+      }
+      if (*value_end == ':') {
+        v = value_end + 1;
+        hi = strtol(v, &value_end, 10);
+        if ((value_end == v) || (hi < lo)) {
+          return -1;
+        }
+      }
+      for (long x = lo; x <= hi; ++x) {
+        if ((axis->num_values == MAX_SWEEP_VALUES) || (APEX_config_set(&check, axis->name, (int)x) != SUCCESS)) {
+          return -1;
+        }
+        axis->values[axis->num_values++] = (int)x;
+      }
+      if ((value_end != end) && (*value_end != ',')) {
+        return -1;
+      }
+      v = value_end + 1;
+    }
+    if (!axis->num_values) {
+      return -1;
+    }
+    p = *end ? end + 1 : end;
+  }
+  return num_axes;
+}
+
+static void grid_point(const Sweep_Axis* axes, int num_axes, long long index, APEX_Config* config) {
+  // Mixed radix index of the grid, last axis changes fastest
+  APEX_config_default(config);
+  for (int a = num_axes - 1; a >= 0; --a) {
+    APEX_config_set(config, axes[a].name, axes[a].values[index % axes[a].num_values]);
+    index /= axes[a].num_values;
+  }
+}
+
+static int create_configs(const Sweep_Axis* axes, int num_axes, int random_points, APEX_Config** configs) {
+  // Whole grid, or random_points distinct points of it drawn with a fixed seed so sweeps repeat
+  long long grid_size = 1;
+  for (int a = 0; a < num_axes; ++a) {
+    grid_size *= axes[a].num_values;
+    if (grid_size > MAX_SWEEP_POINTS * 1024LL) {
+      grid_size = MAX_SWEEP_POINTS * 1024LL; // only sampled from
+    }
+  }
+  int sampled = (random_points > 0) && (random_points < grid_size);
+  long long num_configs = sampled ? random_points : grid_size;
+  if (num_configs > MAX_SWEEP_POINTS) {
+    fprintf(stderr, "APEX_Error : Sweep has more than %d points, use -random <points>\n", MAX_SWEEP_POINTS);
+    return -1;
+  }
+  // points drawn so far are kept in an open addressing hash set, at most half full
+  size_t set_size = 1;
+  while (sampled && (set_size < 2 * (size_t)num_configs)) {
+    set_size <<= 1;
+  }
+  long long* indices = malloc(sizeof(long long) * num_configs);
+  long long* drawn = sampled ? malloc(sizeof(long long) * set_size) : NULL;
+  *configs = malloc(sizeof(APEX_Config) * num_configs);
+  if (!indices || (sampled && !drawn) || !*configs) {
+    free(indices);
+    free(drawn);
+    free(*configs);
+    return -1;
+  }
+  for (size_t slot = 0; drawn && (slot < set_size); ++slot) {
+    drawn[slot] = -1;
+  }
+  unsigned long long seed = 0x9E3779B97F4A7C15ULL;
+  for (long long i = 0; i < num_configs; ++i) {
+    if (!sampled) {
+      indices[i] = i;
+      continue;
+    }
+    int duplicate = 1;
+    while (duplicate) {
+      seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+      indices[i] = (long long)((seed >> 17) % (unsigned long long)grid_size);
+      size_t slot = (size_t)(((unsigned long long)indices[i] * 0x9E3779B97F4A7C15ULL) >> 20) & (set_size - 1);
+      while ((drawn[slot] >= 0) && (drawn[slot] != indices[i])) {
+        slot = (slot + 1) & (set_size - 1);
+      }
+      duplicate = (drawn[slot] >= 0);
+      drawn[slot] = indices[i];
+    }
+  }
+  for (long long i = 0; i < num_configs; ++i) {
+    grid_point(axes, num_axes, indices[i], &(*configs)[i]);
+  }
+  free(indices);
+  free(drawn);
+  return (int)num_configs;
+}
+
+static void run_point(void* arg, int job) {
+  // One workload on one configuration, pipeline runs quietly till the program ends or max_cycles
+  Sweep* sweep = arg;
+  Sweep_Run* run = &sweep->runs[job];
+  APEX_CPU* cpu = APEX_cpu_clone(sweep->workloads[job % sweep->num_workloads]);
+  run->ret = ERROR;
+  if (!cpu) {
+    return;
+  }
+  cpu->config = sweep->configs[job / sweep->num_workloads];
+  run->ret = APEX_cpu_run_until(cpu, sweep->max_cycles);
+  run->cycles = cpu->clock;
+  run->instructions = cpu->counters.ins_retired;
+  APEX_counter_get(cpu, "stall_data", &run->stall_data);
+  run->stall_branch = cpu->counters.stall_branch;
+  run->stall_structural = cpu->counters.stall_structural;
+  run->mispredictions = cpu->predictor.mispredictions;
+  run->stall_memory = cpu->counters.stall_memory;
+  run->l1d_misses = cpu->l1d.misses;
+  run->stall_icache = cpu->counters.stall_icache;
+  run->l1i_misses = cpu->l1i.misses;
+  APEX_cpu_stop(cpu);
+}
+
+static int config_finished(const Sweep* sweep, int p) {
+  // every workload ran to its end on configuration p, cycles of other runs mean nothing
+  for (int i = 0; i < sweep->num_workloads; ++i) {
+    int ret = sweep->runs[p * sweep->num_workloads + i].ret;
+    if ((ret != HALT) && (ret != EMPTY)) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+static int compare_totals(const void* a, const void* b) {
+  const Sweep_Total* x = a;
+  const Sweep_Total* y = b;
+  if (x->cycles != y->cycles) {
+    return (x->cycles < y->cycles) ? -1 : 1;
+  }
+  return x->config - y->config;
+}
+
+static int dominates(const Sweep* sweep, int q, int p) {
+  // q takes at most as many cycles as p on every workload and fewer on one of them
+  int w = sweep->num_workloads;
+  int better = 0;
+  for (int i = 0; i < w; ++i) {
+    int cp = sweep->runs[p * w + i].cycles;
+    int cq = sweep->runs[q * w + i].cycles;
+    if (cq > cp) {
+      return 0;
+    }
+    better |= (cq < cp);
+  }
+  return better;
+}
+
+static int mark_pareto(const Sweep* sweep, char* pareto) {
+  // A configuration is Pareto optimal if no other one dominates it, only configurations where every run finished count.
+  // A dominating configuration has fewer total cycles, so in order of total cycles each one
+  // only needs checking against the Pareto optimal ones before it
+  Sweep_Total* totals = malloc(sizeof(Sweep_Total) * sweep->num_configs);
+  int* front = malloc(sizeof(int) * sweep->num_configs);
+  if (!totals || !front) {
+    free(totals);
+    free(front);
+    return ERROR;
+  }
+  int num_totals = 0;
+  for (int p = 0; p < sweep->num_configs; ++p) {
+    pareto[p] = 0;
+    if (!config_finished(sweep, p)) {
+      continue;
+    }
+    totals[num_totals].cycles = 0;
+    totals[num_totals].config = p;
+    for (int i = 0; i < sweep->num_workloads; ++i) {
+      totals[num_totals].cycles += sweep->runs[p * sweep->num_workloads + i].cycles;
+    }
+    num_totals++;
+  }
+  qsort(totals, num_totals, sizeof(Sweep_Total), compare_totals);
+  int num_front = 0;
+  for (int t = 0; t < num_totals; ++t) {
+    int p = totals[t].config;
+    int dominated = 0;
+    for (int f = 0; (f < num_front) && !dominated; ++f) {
+      dominated = dominates(sweep, front[f], p);
+    }
+    if (!dominated) {
+      pareto[p] = 1;
+      front[num_front++] = p;
+    }
+  }
+  free(totals);
+  free(front);
+  return SUCCESS;
+}
+
+static int write_csv(const char* filename, const Sweep* sweep, const char* const* names, const char* pareto) {
+  FILE* fp = fopen(filename, "w");
+  if (!fp) {
+    return ERROR;
+  }
+  int num_params = APEX_config_num_params();
+  fprintf(fp, "config");
+  for (int i = 0; i < num_params; ++i) {
+    fprintf(fp, ",%s", APEX_config_param_name(i));
+  }
+  fprintf(fp, ",workload,return,cycles,instructions,cpi,data_stall_cycles,branch_stall_cycles,structural_stall_cycles,memory_stall_cycles,mispredictions,l1d_misses,icache_stall_cycles,l1i_misses,pareto\n");
+  for (int p = 0; p < sweep->num_configs; ++p) {
+    for (int i = 0; i < sweep->num_workloads; ++i) {
+      const Sweep_Run* run = &sweep->runs[p * sweep->num_workloads + i];
+      fprintf(fp, "%d", p);
+      for (int k = 0; k < num_params; ++k) {
+        int value = 0;
+        APEX_config_get(&sweep->configs[p], APEX_config_param_name(k), &value);
+        fprintf(fp, ",%d", value);
+      }
+      fprintf(fp, ",%s,%s,%d,%d,%.4f,%d,%d,%d,%d,%d,%d,%d,%d,%d\n", names[i],
+              (run->ret == HALT) ? "HALT" : (run->ret == EMPTY) ? "EMPTY" : (run->ret == SUCCESS) ? "TIMEOUT" : "ERROR",
+              run->cycles, run->instructions, run->instructions ? (double)run->cycles / run->instructions : 0.0,
+              run->stall_data, run->stall_branch, run->stall_structural, run->stall_memory,
+              run->mispredictions, run->l1d_misses, run->stall_icache, run->l1i_misses, pareto[p]);
+    }
+  }
+  return (fclose(fp) == 0) ? SUCCESS : ERROR;
+}
+
+int APEX_cpu_run_sweep(const char* const* workloads, int num_workloads, const char* grid,
+                       int random_points, int max_cycles, int num_threads, const char* csv_file) {
+  // Runs all workloads on every configuration of grid, writes one CSV row per run
+  Sweep_Axis axes[MAX_SWEEP_AXES];
+  int num_axes = parse_grid(grid, axes);
+  if (num_axes < 0) {
+    fprintf(stderr, "APEX_Error : Invalid sweep grid %s, expected name=v1,v2,...;name=lo:hi\n", grid);
+    return ERROR;
+  }
+  Sweep sweep;
+  memset(&sweep, 0, sizeof(sweep));
+  sweep.max_cycles = max_cycles;
+  sweep.num_configs = create_configs(axes, num_axes, random_points, &sweep.configs);
+  if (sweep.num_configs < 0) {
+    return ERROR;
+  }
+
+  // every workload is parsed once, listing of code memory is not wanted here
+  FILE* null_out = fopen("/dev/null", "w");
+  sweep.workloads = calloc(num_workloads, sizeof(APEX_CPU*));
+  sweep.runs = calloc((size_t)sweep.num_configs * num_workloads, sizeof(Sweep_Run));
+  int ret = (null_out && sweep.workloads && sweep.runs) ? SUCCESS : ERROR;
+  for (int i = 0; (ret == SUCCESS) && (i < num_workloads); ++i) {
+    sweep.workloads[i] = APEX_cpu_create(workloads[i], null_out);
+    if (!sweep.workloads[i]) {
+      fprintf(stderr, "APEX_Error : Unable to initialize CPU with %s\n", workloads[i]);
+      ret = ERROR;
+    }
+    else {
+      sweep.workloads[i]->quiet = 1;
+    }
+  }
+  sweep.num_workloads = num_workloads;
+
+  if (ret == SUCCESS) {
+    struct timespec start, stop;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    APEX_run_parallel(sweep.num_configs * num_workloads, num_threads, run_point, &sweep);
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+    double seconds = (stop.tv_sec - start.tv_sec) + (stop.tv_nsec - start.tv_nsec) / 1e9;
+
+    char* pareto = malloc(sweep.num_configs);
+    int num_pareto = 0;
+    int best = 0;
+    int timed_out = 0;
+    long long best_cycles = LLONG_MAX;
+    if (pareto && (mark_pareto(&sweep, pareto) == SUCCESS)) {
+      for (int p = 0; p < sweep.num_configs; ++p) {
+        for (int i = 0; i < num_workloads; ++i) {
+          timed_out += (sweep.runs[p * num_workloads + i].ret == SUCCESS);
+        }
+        if (!config_finished(&sweep, p)) {
+          continue;
+        }
+        long long cycles = 0;
+        for (int i = 0; i < num_workloads; ++i) {
+          cycles += sweep.runs[p * num_workloads + i].cycles;
+        }
+        if (cycles < best_cycles) {
+          best_cycles = cycles;
+          best = p;
+        }
+        num_pareto += pareto[p];
+      }
+      ret = write_csv(csv_file, &sweep, workloads, pareto);
+    }
+    else {
+      ret = ERROR;
+    }
+    printf("Sweep :: %d configurations x %d workloads, %d runs in %.3f s, %d Pareto optimal\n",
+           sweep.num_configs, num_workloads, sweep.num_configs * num_workloads, seconds, num_pareto);
+    if (timed_out) {
+      printf("Sweep :: %d runs stopped at the limit of %d cycles\n", timed_out, max_cycles);
+    }
+    if (best_cycles == LLONG_MAX) {
+      printf("No configuration finished every workload\n");
+    }
+    else {
+      printf("Fewest total cycles %lld with config %d", best_cycles, best);
+      for (int i = 0; i < APEX_config_num_params(); ++i) {
+        int value = 0;
+        APEX_config_get(&sweep.configs[best], APEX_config_param_name(i), &value);
+        printf("%s%s=%d", i ? "," : " ", APEX_config_param_name(i), value);
+      }
+      printf("\n");
+    }
+    if (ret == SUCCESS) {
+      printf("Results written to %s\n", csv_file);
+    }
+    else {
+      fprintf(stderr, "APEX_Error : Unable to write results %s\n", csv_file);
+    }
+    free(pareto);
+  }
+
+  for (int i = 0; sweep.workloads && (i < num_workloads); ++i) {
+    if (sweep.workloads[i]) {
+      APEX_cpu_stop(sweep.workloads[i]);
+    }
+  }
+  if (null_out) {
+    fclose(null_out);
+  }
+  free(sweep.workloads);
+  free(sweep.runs);
+  free(sweep.configs);
+  return ret;
+}
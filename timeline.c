@@ -0,0 +1,269 @@
+/*
+ *  timeline.c
+ *  Contains pipeline timeline export, every cycle the stage latches are
+ *  compared with the previous cycle and each instruction entering or
+ *  leaving a stage is written out as it happens, as a Konata pipeline log
+ *  or as Chrome trace events (chrome://tracing, Perfetto) for a file
+ *  ending in .json. Only the instructions in the pipeline are kept, so a
+ *  run of any length is exported in constant memory
+ *
+ *  Author :
+ *  Sagar Vishwakarma (svishwa2@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpu.h"
+
+/* Size of output buffer, events are written in large chunks */
+#define TIMELINE_BUFFER_SIZE (1 << 20)
+
+/* Most instructions in the pipeline at once */
+#define TIMELINE_MAX_LIVE (NUM_STAGES * MAX_ISSUE_WIDTH)
+
+static const char* stage_names[NUM_STAGES] = {"F", "DRF", "EX1", "EX2", "MEM1", "MEM2", "WB"};
+
+static const char* thread_names[NUM_STAGES] = {
+  "Fetch", "Decode/RF", "Execute One", "Execute Two", "Memory One", "Memory Two", "Writeback"
+};
+
+/* Instruction in the pipeline and the stage it was in last cycle */
+typedef struct Timeline_Entry {
+  int id;         // fetch number of the instruction
+  int log_id;     // number in the Konata log, in order the instructions first show up
+  int pc;
+  int stage;      // stage it is in
+  int lane;       // lane of the stage
+  int start;      // cycle it entered the stage
+  int stalled;    // cycles of those the stage was stalled or waiting
+  int seen;       // found in a latch this cycle
+  unsigned int spans; // STAGE_BIT of every stage it had a span in
+} Timeline_Entry;
+
+struct APEX_Timeline {
+  FILE* fp;
+  char* buffer;
+  int chrome;       // 1 for Chrome trace events, 0 for Konata
+  int clock;        // cycle of the last Konata cycle record
+  int next_log_id;
+  int retired;      // instructions retired, Konata numbers retirements in order
+  int events;       // Chrome events written, all but the first follow a comma
+  int repeated;     // spans given to an instruction in a stage it already had one in, should stay 0
+  int num_live;
+  Timeline_Entry live[TIMELINE_MAX_LIVE];
+};
+
+static int has_suffix(const char* name, const char* suffix) {
+  size_t length = strlen(name);
+  size_t suffix_length = strlen(suffix);
+  return (length >= suffix_length) && !strcmp(name + length - suffix_length, suffix);
+}
+
+static void start_konata_cycle(APEX_Timeline* timeline, int clock) {
+  // Konata commands belong to the cycle of the last cycle record before them
+  if (clock != timeline->clock) {
+    fprintf(timeline->fp, "C\t%d\n", clock - timeline->clock);
+    timeline->clock = clock;
+  }
+}
+
+static void start_stage(APEX_CPU* cpu, Timeline_Entry* entry) {
+  // Every instruction gets at most one span per stage, instructions only move forward
+  APEX_Timeline* timeline = cpu->timeline;
+  if (entry->spans & STAGE_BIT(entry->stage)) {
+    timeline->repeated++;
+  }
+  entry->spans |= STAGE_BIT(entry->stage);
+  if (!timeline->chrome) {
+    fprintf(timeline->fp, "S\t%d\t0\t%s\n", entry->log_id, stage_names[entry->stage]);
+  }
+}
+
+static void end_stage(APEX_CPU* cpu, Timeline_Entry* entry, int clock, int flushed) {
+  // Stage held the instruction from start up to clock, the time it stalled is shown with it
+  APEX_Timeline* timeline = cpu->timeline;
+  if (timeline->chrome) {
+    fprintf(timeline->fp, "%s{\"name\":\"", timeline->events++ ? ",\n" : "");
+    print_instruction(timeline->fp, &cpu->code_memory[get_code_index(entry->pc)]);
+    fprintf(timeline->fp, "\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%d,\"dur\":%d,\"pid\":0,\"tid\":%d,"
+            "\"args\":{\"id\":%d,\"pc\":%d,\"stalled\":%d,\"flushed\":%d}}",
+            stage_names[entry->stage], entry->start, clock - entry->start,
+            entry->stage * MAX_ISSUE_WIDTH + entry->lane, entry->id, entry->pc, entry->stalled, flushed);
+    return;
+  }
+  if (entry->stalled) {
+    fprintf(timeline->fp, "L\t%d\t1\t%s stalled %d cycles\n", entry->log_id, stage_names[entry->stage],
+            entry->stalled);
+  }
+  fprintf(timeline->fp, "E\t%d\t0\t%s\n", entry->log_id, stage_names[entry->stage]);
+}
+
+static void leave_pipeline(APEX_CPU* cpu, Timeline_Entry* entry, int clock) {
+  // Instruction gone from the latches by clock, retired if it was in writeback and flushed from anywhere else
+  APEX_Timeline* timeline = cpu->timeline;
+  int flushed = (entry->stage != WB);
+  end_stage(cpu, entry, clock, flushed);
+  if (!timeline->chrome) {
+    fprintf(timeline->fp, "R\t%d\t%d\t%d\n", entry->log_id, flushed ? 0 : timeline->retired, flushed);
+  }
+  timeline->retired += !flushed;
+}
+
+static void enter_pipeline(APEX_CPU* cpu, Timeline_Entry* entry) {
+  APEX_Timeline* timeline = cpu->timeline;
+  entry->log_id = timeline->next_log_id++;
+  if (!timeline->chrome) {
+    fprintf(timeline->fp, "I\t%d\t%d\t0\n", entry->log_id, entry->id);
+    fprintf(timeline->fp, "L\t%d\t0\t%d: ", entry->log_id, entry->pc);
+    print_instruction(timeline->fp, &cpu->code_memory[get_code_index(entry->pc)]);
+    fprintf(timeline->fp, "\n");
+  }
+  start_stage(cpu, entry);
+}
+
+static Timeline_Entry* find_entry(APEX_Timeline* timeline, int id) {
+  for (int i = 0; i < timeline->num_live; ++i) {
+    if (timeline->live[i].id == id) {
+      return &timeline->live[i];
+    }
+  }
+  return NULL;
+}
+
+int APEX_timeline_open(APEX_CPU* cpu, const char* filename) {
+  // Starts exporting the pipeline timeline of cpu into filename, only the in-order pipeline has stage latches
+  if (cpu->config.engine) {
+    fprintf(stderr, "APEX_Error : Pipeline timeline follows stage latches of the in-order engine (engine=0)\n");
+    return ERROR;
+  }
+  APEX_Timeline* timeline = calloc(1, sizeof(*timeline));
+  if (!timeline) {
+    return ERROR;
+  }
+  timeline->fp = fopen(filename, "w");
+  timeline->buffer = malloc(TIMELINE_BUFFER_SIZE);
+  if (!timeline->fp || !timeline->buffer) {
+    fprintf(stderr, "APEX_Error : Unable to create timeline file %s\n", filename);
+    if (timeline->fp) {
+      fclose(timeline->fp);
+    }
+    free(timeline->buffer);
+    free(timeline);
+    return ERROR;
+  }
+  setvbuf(timeline->fp, timeline->buffer, _IOFBF, TIMELINE_BUFFER_SIZE);
+  timeline->chrome = has_suffix(filename, ".json");
+  timeline->clock = cpu->clock;
+  if (timeline->chrome) {
+    // one track per lane of every stage in pipeline order, ts and dur are in cycles (shown as microseconds)
+    fprintf(timeline->fp, "{\"traceEvents\":[\n");
+    for (int stage = F; stage < NUM_STAGES; ++stage) {
+      for (int lane = 0; lane < cpu->config.width; ++lane) {
+        int tid = stage * MAX_ISSUE_WIDTH + lane;
+        fprintf(timeline->fp, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%d,\"args\":{\"name\":\"%s",
+                timeline->events++ ? ",\n" : "", tid, thread_names[stage]);
+        if (cpu->config.width > 1) {
+          fprintf(timeline->fp, " %d", lane);
+        }
+        fprintf(timeline->fp, "\"}},\n");
+        fprintf(timeline->fp, "{\"name\":\"thread_sort_index\",\"ph\":\"M\",\"pid\":0,\"tid\":%d,\"args\":{\"sort_index\":%d}}",
+                tid, tid);
+      }
+    }
+  }
+  else {
+    fprintf(timeline->fp, "Kanata\t0004\nC=\t%d\n", cpu->clock);
+  }
+  cpu->timeline = timeline;
+  return SUCCESS;
+}
+
+void timeline_cycle(APEX_CPU* cpu) {
+  // Compares latches of this cycle with the last one, called once all stages ran
+  APEX_Timeline* timeline = cpu->timeline;
+  if (!timeline->chrome) {
+    start_konata_cycle(timeline, cpu->clock);
+  }
+  for (int i = 0; i < timeline->num_live; ++i) {
+    timeline->live[i].seen = 0;
+  }
+  // from writeback back to fetch, a stalled fetch latch still holds the instruction that went on to decode
+  for (int stage = WB; stage >= F; --stage) {
+    if (cpu->bubble & STAGE_BIT(stage)) {
+      continue;
+    }
+    int stalled = ((cpu->stalled | cpu->waiting) & STAGE_BIT(stage)) != 0;
+    for (int lane = 0; lane < cpu->group_size[stage]; ++lane) {
+      const CPU_Stage* latch = &cpu->stage[lane][stage];
+      if (get_lane_instruction(cpu, stage, lane)->opcode == OP_EMPTY) {
+        continue;
+      }
+      Timeline_Entry* entry = find_entry(timeline, latch->id);
+      if (entry && entry->seen) {
+        continue; // already found in a later stage this cycle
+      }
+      if (!entry) {
+        if (timeline->num_live == TIMELINE_MAX_LIVE) {
+          continue;
+        }
+        entry = &timeline->live[timeline->num_live++];
+        entry->id = latch->id;
+        entry->pc = latch->pc;
+        entry->stage = stage;
+        entry->start = cpu->clock;
+        entry->stalled = 0;
+        entry->spans = 0;
+        enter_pipeline(cpu, entry);
+      }
+      else if (entry->stage != stage) {
+        end_stage(cpu, entry, cpu->clock, 0);
+        entry->stage = stage;
+        entry->start = cpu->clock;
+        entry->stalled = 0;
+        start_stage(cpu, entry);
+      }
+      entry->lane = lane;
+      entry->stalled += stalled;
+      entry->seen = 1;
+    }
+  }
+  // instructions gone from the latches are done, entries left are kept packed
+  int kept = 0;
+  for (int i = 0; i < timeline->num_live; ++i) {
+    if (timeline->live[i].seen) {
+      timeline->live[kept++] = timeline->live[i];
+    }
+    else {
+      leave_pipeline(cpu, &timeline->live[i], cpu->clock);
+    }
+  }
+  timeline->num_live = kept;
+}
+
+void APEX_timeline_close(APEX_CPU* cpu) {
+  // Ends instructions still in the pipeline and closes the timeline file, writeback ran for the ones there
+  APEX_Timeline* timeline = cpu->timeline;
+  if (!timeline) {
+    return;
+  }
+  if (!timeline->chrome) {
+    start_konata_cycle(timeline, cpu->clock + 1);
+  }
+  for (int i = 0; i < timeline->num_live; ++i) {
+    leave_pipeline(cpu, &timeline->live[i], cpu->clock + 1);
+  }
+  if (timeline->chrome) {
+    fprintf(timeline->fp, "\n]}\n");
+  }
+  if (fclose(timeline->fp) != 0) {
+    fprintf(stderr, "APEX_Error : Unable to write pipeline timeline\n");
+  }
+  if (timeline->repeated) {
+    fprintf(stderr, "APEX_Error : Pipeline timeline has %d repeated stage spans\n", timeline->repeated);
+  }
+  free(timeline->buffer);
+  free(timeline);
+  cpu->timeline = NULL;
+}
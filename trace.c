@@ -0,0 +1,559 @@
+/*
+ *  trace.c
+ *  Contains binary pipeline trace, every cycle records the latch of each
+ *  stage (pc of every lane with its status bits) as it is printed, along
+ *  with register writes, stalls and flushes. Records are delta encoded
+ *  against the previous cycle and written in compressed blocks, the
+ *  decoder prints them back as the per cycle view of func simulate
+ *
+ *  Author :
+ *  Sagar Vishwakarma (svishwa2@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpu.h"
+
+/* Bump this whenever a record or the block layout changes */
+#define APEX_TRACE_VERSION 1
+
+/* Bytes of records collected before a block is compressed and written */
+#define TRACE_BLOCK_SIZE (64 << 10)
+
+/* Most bytes a single record takes, a varint is at most 5 bytes */
+#define TRACE_MAX_RECORD (16 + 5 * MAX_ISSUE_WIDTH)
+
+/* Match finder of the block compressor, matches reach back at most 64KB */
+#define TRACE_HASH_BITS 12
+#define TRACE_MIN_MATCH 4
+#define TRACE_MAX_OFFSET 65535
+
+static const char apex_trace_magic[8] = {'A', 'P', 'E', 'X', 'T', 'R', 'C', '\0'};
+
+/* Kind of record in high nibble of its first byte, stage index in low nibble */
+enum {
+  TRACE_CYCLE = 1,    // clock advanced by varint
+  TRACE_STAGE,        // status, group size and zigzag pc delta of every lane
+  TRACE_STAGE_SAME,   // stage latch and status same as its previous record
+  TRACE_REG_WRITE,    // register byte and zigzag delta from its previous value
+  TRACE_STALL,        // Decode/RF stall cause byte
+  TRACE_FLUSH,        // zigzag target pc and varint squashed instructions
+};
+
+/* Status bits of a stage record */
+#define TRACE_EXECUTED 0x01
+#define TRACE_EMPTY    0x02
+#define TRACE_STALLED  0x04
+#define TRACE_BUSY     0x08
+#define TRACE_BUBBLE   0x10
+
+/* Stall cause bytes other than a register */
+#define TRACE_CAUSE_FLAGS      0xFF
+#define TRACE_CAUSE_STRUCTURAL 0xFE
+
+/*
+ * Layout of a trace file
+ *   APEX_Trace_Header
+ *   APEX_Instruction code_memory[code_memory_size]
+ *   blocks of int raw_size, int packed_size, packed_size bytes (stored as is when equal to raw_size)
+ */
+typedef struct APEX_Trace_Header {
+  char magic[8];          // Identifies a trace file
+  int version;            // APEX_TRACE_VERSION of the writer
+  int instruction_size;   // sizeof(APEX_Instruction) of the writer
+  int code_memory_size;   // Number of instructions
+} APEX_Trace_Header;
+
+/* Values records are delta encoded against, kept alike by writer and decoder */
+typedef struct Trace_Context {
+  int clock;
+  int pc[NUM_STAGES][MAX_ISSUE_WIDTH];
+  int group_size[NUM_STAGES];
+  int status[NUM_STAGES];
+  int regs[REGISTER_FILE_SIZE];
+} Trace_Context;
+
+struct APEX_Trace {
+  FILE* fp;
+  Trace_Context context;
+  unsigned char block[TRACE_BLOCK_SIZE];
+  int used;               // bytes of block filled
+  unsigned char packed[TRACE_BLOCK_SIZE + TRACE_BLOCK_SIZE / 255 + 16];
+  int failed;             // set once a write fails, rest of the trace is dropped
+};
+
+static void reset_context(Trace_Context* context) {
+  memset(context, 0, sizeof(*context));
+  for (int i = 0; i < NUM_STAGES; ++i) {
+    context->status[i] = -1; // first record of every stage is written in full
+  }
+}
+
+/*
+ * ########################################## Block Compression ##########################################
+ */
+static unsigned int read32(const unsigned char* p) {
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+static int put_length(unsigned char* out, int o, int length) {
+  // Rest of a length over 15, in bytes of 255 and a last smaller byte
+  while (length >= 255) {
+    out[o++] = 255;
+    length -= 255;
+  }
+  out[o++] = (unsigned char)length;
+  return o;
+}
+
+static int put_sequence(unsigned char* out, int o, const unsigned char* literals, int num_literals, int offset, int length) {
+  // Literals followed by a match of length at offset back, length 0 ends the block
+  int match = length ? length - TRACE_MIN_MATCH : 0;
+  out[o++] = (unsigned char)(((num_literals < 15) ? num_literals : 15) << 4 | ((match < 15) ? match : 15));
+  if (num_literals >= 15) {
+    o = put_length(out, o, num_literals - 15);
+  }
+  memcpy(out + o, literals, num_literals);
+  o += num_literals;
+  if (length) {
+    out[o++] = offset & 0xFF;
+    out[o++] = offset >> 8;
+    if (match >= 15) {
+      o = put_length(out, o, match - 15);
+    }
+  }
+  return o;
+}
+
+static int pack_block(const unsigned char* in, int size, unsigned char* out) {
+  // LZ77 with a hash of the next 4 bytes finding the last place they were seen, returns packed size
+  int table[1 << TRACE_HASH_BITS];
+  memset(table, -1, sizeof(table));
+  int o = 0;
+  int anchor = 0;
+  int i = 0;
+  while (i + TRACE_MIN_MATCH <= size) {
+    unsigned int sequence = read32(in + i);
+    int hash = (sequence * 2654435761u) >> (32 - TRACE_HASH_BITS);
+    int ref = table[hash];
+    table[hash] = i;
+    if ((ref >= 0) && (i - ref <= TRACE_MAX_OFFSET) && (read32(in + ref) == sequence)) {
+      int length = TRACE_MIN_MATCH;
+      while ((i + length < size) && (in[ref + length] == in[i + length])) {
+        length++;
+      }
+      o = put_sequence(out, o, in + anchor, i - anchor, i - ref, length);
+      i += length;
+      anchor = i;
+    }
+    else {
+      i++;
+    }
+  }
+  return put_sequence(out, o, in + anchor, size - anchor, 0, 0);
+}
+
+static int get_length(const unsigned char* in, int size, int* i, int* length) {
+  // Adds rest of a length over 15 to length, 0 if block ends inside it
+  int byte = 255;
+  while (byte == 255) {
+    if (*i >= size) {
+      return 0;
+    }
+    byte = in[(*i)++];
+    *length += byte;
+  }
+  return 1;
+}
+
+static int unpack_block(const unsigned char* in, int size, unsigned char* out, int raw_size) {
+  // Returns SUCCESS once exactly raw_size bytes came out, ERROR for a damaged block
+  int i = 0;
+  int o = 0;
+  while (i < size) {
+    int token = in[i++];
+    int num_literals = token >> 4;
+    int length = (token & 15) + TRACE_MIN_MATCH;
+    if (((num_literals == 15) && !get_length(in, size, &i, &num_literals)) ||
+        (num_literals > size - i) || (num_literals > raw_size - o)) {
+      return ERROR;
+    }
+    memcpy(out + o, in + i, num_literals);
+    i += num_literals;
+    o += num_literals;
+    if (o == raw_size) {
+      return (i == size) ? SUCCESS : ERROR;
+    }
+    if (i + 2 > size) {
+      return ERROR;
+    }
+    int offset = in[i] | (in[i + 1] << 8);
+    i += 2;
+    if (((length == 15 + TRACE_MIN_MATCH) && !get_length(in, size, &i, &length)) ||
+        (offset == 0) || (offset > o) || (length > raw_size - o)) {
+      return ERROR;
+    }
+    for (int j = 0; j < length; ++j, ++o) {
+      out[o] = out[o - offset]; // match may overlap the bytes it writes
+    }
+  }
+  return ERROR;
+}
+
+/*
+ * ########################################## Trace Writer ##########################################
+ */
+static void write_block(APEX_Trace* trace) {
+  // Compressed block, kept as is when it does not get smaller
+  if (!trace->used || trace->failed) {
+    trace->used = 0;
+    return;
+  }
+  int raw_size = trace->used;
+  int packed_size = pack_block(trace->block, raw_size, trace->packed);
+  const unsigned char* data = trace->packed;
+  if (packed_size >= raw_size) {
+    packed_size = raw_size;
+    data = trace->block;
+  }
+  if ((fwrite(&raw_size, sizeof(int), 1, trace->fp) != 1) || (fwrite(&packed_size, sizeof(int), 1, trace->fp) != 1) ||
+      (fwrite(data, 1, packed_size, trace->fp) != (size_t)packed_size)) {
+    fprintf(stderr, "APEX_Error : Unable to write pipeline trace, rest of the run is not traced\n");
+    trace->failed = 1;
+  }
+  trace->used = 0;
+}
+
+static unsigned char* reserve(APEX_Trace* trace) {
+  // Room for one record, records never span two blocks
+  if (trace->used + TRACE_MAX_RECORD > TRACE_BLOCK_SIZE) {
+    write_block(trace);
+  }
+  return trace->block + trace->used;
+}
+
+static int put_varint(unsigned char* out, unsigned int value) {
+  // 7 bits per byte, high bit set on all but the last byte
+  int o = 0;
+  while (value >= 0x80) {
+    out[o++] = (unsigned char)(value | 0x80);
+    value >>= 7;
+  }
+  out[o++] = (unsigned char)value;
+  return o;
+}
+
+static int put_signed(unsigned char* out, int value) {
+  // zigzag keeps small negative deltas short
+  return put_varint(out, ((unsigned int)value << 1) ^ (unsigned int)(value >> 31));
+}
+
+int APEX_trace_open(APEX_CPU* cpu, const char* filename) {
+  // Starts tracing cycles of cpu into filename, only the in-order pipeline has stage latches to trace
+  if (cpu->config.engine) {
+    fprintf(stderr, "APEX_Error : Pipeline trace records stage latches of the in-order engine (engine=0)\n");
+    return ERROR;
+  }
+  APEX_Trace* trace = calloc(1, sizeof(*trace));
+  if (!trace) {
+    return ERROR;
+  }
+  trace->fp = fopen(filename, "wb");
+  if (!trace->fp) {
+    fprintf(stderr, "APEX_Error : Unable to create trace file %s\n", filename);
+    free(trace);
+    return ERROR;
+  }
+  APEX_Trace_Header header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, apex_trace_magic, sizeof(header.magic));
+  header.version = APEX_TRACE_VERSION;
+  header.instruction_size = sizeof(APEX_Instruction);
+  header.code_memory_size = cpu->code_memory_size;
+  if ((fwrite(&header, sizeof(header), 1, trace->fp) != 1) ||
+      (fwrite(cpu->code_memory, sizeof(APEX_Instruction), cpu->code_memory_size, trace->fp) != (size_t)cpu->code_memory_size)) {
+    fprintf(stderr, "APEX_Error : Unable to write trace file %s\n", filename);
+    fclose(trace->fp);
+    free(trace);
+    return ERROR;
+  }
+  reset_context(&trace->context); // decoder starts from the same zero context, also for a restored run
+  cpu->trace = trace;
+  return SUCCESS;
+}
+
+void APEX_trace_close(APEX_CPU* cpu) {
+  // Writes the last block and closes the trace file
+  APEX_Trace* trace = cpu->trace;
+  if (!trace) {
+    return;
+  }
+  write_block(trace);
+  if (fclose(trace->fp) != 0) {
+    fprintf(stderr, "APEX_Error : Unable to write pipeline trace\n");
+  }
+  free(trace);
+  cpu->trace = NULL;
+}
+
+void trace_cycle(APEX_CPU* cpu) {
+  APEX_Trace* trace = cpu->trace;
+  unsigned char* out = reserve(trace);
+  out[0] = TRACE_CYCLE << 4;
+  trace->used += 1 + put_varint(out + 1, cpu->clock - trace->context.clock);
+  trace->context.clock = cpu->clock;
+}
+
+void trace_stage(APEX_CPU* cpu, int stage_index) {
+  // Latch of stage with the status it is printed with, a latch same as last cycle takes one byte
+  APEX_Trace* trace = cpu->trace;
+  Trace_Context* context = &trace->context;
+  unsigned int bit = STAGE_BIT(stage_index);
+  int status = (((cpu->executed & bit) ? TRACE_EXECUTED : 0) | ((cpu->empty & bit) ? TRACE_EMPTY : 0) |
+                ((cpu->stalled & bit) ? TRACE_STALLED : 0) | (((cpu->busy | cpu->waiting) & bit) ? TRACE_BUSY : 0) |
+                ((cpu->bubble & bit) ? TRACE_BUBBLE : 0));
+  int size = get_group_size(cpu, stage_index);
+  int same = (status == context->status[stage_index]) && (size == context->group_size[stage_index]);
+  for (int lane = 0; (lane < size) && same; ++lane) {
+    same = (cpu->stage[lane][stage_index].pc == context->pc[stage_index][lane]);
+  }
+  unsigned char* out = reserve(trace);
+  int o = 0;
+  if (same) {
+    out[o++] = TRACE_STAGE_SAME << 4 | stage_index;
+  }
+  else {
+    out[o++] = TRACE_STAGE << 4 | stage_index;
+    out[o++] = (unsigned char)status;
+    out[o++] = (unsigned char)size;
+    for (int lane = 0; lane < size; ++lane) {
+      int pc = cpu->stage[lane][stage_index].pc;
+      o += put_signed(out + o, pc - context->pc[stage_index][lane]);
+      context->pc[stage_index][lane] = pc;
+    }
+    context->status[stage_index] = status;
+    context->group_size[stage_index] = size;
+  }
+  trace->used += o;
+}
+
+void trace_register_write(APEX_CPU* cpu, int reg_number, int value) {
+  APEX_Trace* trace = cpu->trace;
+  unsigned char* out = reserve(trace);
+  out[0] = TRACE_REG_WRITE << 4;
+  out[1] = (unsigned char)reg_number;
+  trace->used += 2 + put_signed(out + 2, (int)((unsigned int)value - (unsigned int)trace->context.regs[reg_number]));
+  trace->context.regs[reg_number] = value;
+}
+
+void trace_stall(APEX_CPU* cpu, int cause) {
+  // Decode/RF waited this cycle on register cause, STALL_FLAGS or STALL_STRUCTURAL
+  APEX_Trace* trace = cpu->trace;
+  unsigned char* out = reserve(trace);
+  out[0] = TRACE_STALL << 4;
+  out[1] = (cause == STALL_FLAGS) ? TRACE_CAUSE_FLAGS : (cause == STALL_STRUCTURAL) ? TRACE_CAUSE_STRUCTURAL : (unsigned char)cause;
+  trace->used += 2;
+}
+
+void trace_flush(APEX_CPU* cpu, int target, int squashed) {
+  APEX_Trace* trace = cpu->trace;
+  unsigned char* out = reserve(trace);
+  int o = 0;
+  out[o++] = TRACE_FLUSH << 4;
+  o += put_signed(out + o, target - 4000);
+  o += put_varint(out + o, squashed);
+  trace->used += o;
+}
+
+/*
+ * ########################################## Trace Decoder ##########################################
+ */
+static int get_varint(const unsigned char* in, int size, int* i, unsigned int* value) {
+  *value = 0;
+  for (int shift = 0; (*i < size) && (shift < 35); shift += 7) {
+    unsigned char byte = in[(*i)++];
+    *value |= (unsigned int)(byte & 0x7F) << shift;
+    if (!(byte & 0x80)) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static int get_signed(const unsigned char* in, int size, int* i, int* value) {
+  unsigned int zigzag = 0;
+  if (!get_varint(in, size, i, &zigzag)) {
+    return 0;
+  }
+  *value = (int)((zigzag >> 1) ^ (0u - (zigzag & 1)));
+  return 1;
+}
+
+static void print_trace_stage(FILE* out, const Trace_Context* context, const APEX_Instruction* code_memory,
+                              int code_memory_size, int stage_index) {
+  // Same lines print_stage_content gives for the stage
+  static const char* names[NUM_STAGES] = {
+    "Fetch", "Decode/RF", "Execute One", "Execute Two", "Memory One", "Memory Two", "Writeback"
+  };
+  static const APEX_Instruction bubble = {.opcode = OP_NOP, .format = FMT_NONE};
+  static const APEX_Instruction empty = {.opcode = OP_EMPTY, .format = FMT_NONE};
+  int status = context->status[stage_index];
+  for (int lane = 0; lane < context->group_size[stage_index]; ++lane) {
+    int pc = context->pc[stage_index][lane];
+    int index = get_code_index(pc);
+    const APEX_Instruction* ins = (status & TRACE_BUBBLE) ? &bubble :
+                                  ((index < 0) || (index >= code_memory_size)) ? &empty : &code_memory[index];
+    fprintf(out, "%-15s: %d: pc(%d) ", lane ? "" : names[stage_index], status & TRACE_EXECUTED, pc);
+    print_instruction(out, ins);
+    if (status & TRACE_EMPTY) {
+      fprintf(out, " ---> EMPTY ");
+    }
+    else if (status & TRACE_STALLED) {
+      fprintf(out, " ---> STALLED ");
+    }
+    else if (status & TRACE_BUSY) {
+      fprintf(out, " ---> BUSY ");
+    }
+    fprintf(out, "\n");
+  }
+}
+
+static int decode_block(FILE* out, Trace_Context* context, const unsigned char* in, int size,
+                        const APEX_Instruction* code_memory, int code_memory_size, int show_events) {
+  // Prints records of one block, returns ERROR on a damaged record
+  int i = 0;
+  while (i < size) {
+    int kind = in[i] >> 4;
+    int stage_index = in[i] & 15;
+    int reg_number = 0;
+    unsigned int delta = 0;
+    int value = 0;
+    i++;
+    switch (kind) {
+      case TRACE_CYCLE:
+        if (!get_varint(in, size, &i, &delta)) {
+          return ERROR;
+        }
+        context->clock += delta;
+        fprintf(out, "\n--------------------------------\n");
+        fprintf(out, "Clock Cycle #: %d\n", context->clock);
+        fprintf(out, "%-15s: Executed: Instruction\n", "Stage");
+        fprintf(out, "--------------------------------\n");
+        break;
+      case TRACE_STAGE:
+        if ((stage_index >= NUM_STAGES) || (i + 2 > size) || (in[i + 1] < 1) || (in[i + 1] > MAX_ISSUE_WIDTH)) {
+          return ERROR;
+        }
+        context->status[stage_index] = in[i++];
+        context->group_size[stage_index] = in[i++];
+        for (int lane = 0; lane < context->group_size[stage_index]; ++lane) {
+          if (!get_signed(in, size, &i, &value)) {
+            return ERROR;
+          }
+          context->pc[stage_index][lane] += value;
+        }
+        print_trace_stage(out, context, code_memory, code_memory_size, stage_index);
+        break;
+      case TRACE_STAGE_SAME:
+        if ((stage_index >= NUM_STAGES) || (context->status[stage_index] < 0)) {
+          return ERROR;
+        }
+        print_trace_stage(out, context, code_memory, code_memory_size, stage_index);
+        break;
+      case TRACE_REG_WRITE:
+        if ((i >= size) || (in[i] >= REGISTER_FILE_SIZE)) {
+          return ERROR;
+        }
+        reg_number = in[i++];
+        if (!get_signed(in, size, &i, &value)) {
+          return ERROR;
+        }
+        context->regs[reg_number] = (int)((unsigned int)context->regs[reg_number] + (unsigned int)value);
+        if (show_events) {
+          fprintf(out, "%-15s: R%d = %d\n", "Event", reg_number, context->regs[reg_number]);
+        }
+        break;
+      case TRACE_STALL:
+        if (i >= size) {
+          return ERROR;
+        }
+        value = in[i++];
+        if (show_events && (value == TRACE_CAUSE_FLAGS)) {
+          fprintf(out, "%-15s: Decode/RF stalled on flags\n", "Event");
+        }
+        else if (show_events && (value == TRACE_CAUSE_STRUCTURAL)) {
+          fprintf(out, "%-15s: Decode/RF stalled on a busy functional unit\n", "Event");
+        }
+        else if (show_events) {
+          fprintf(out, "%-15s: Decode/RF stalled on R%d\n", "Event", value);
+        }
+        break;
+      case TRACE_FLUSH:
+        if (!get_signed(in, size, &i, &value) || !get_varint(in, size, &i, &delta)) {
+          return ERROR;
+        }
+        if (show_events) {
+          fprintf(out, "%-15s: Flush, fetch from pc(%d), %u instructions squashed\n", "Event", value + 4000, delta);
+        }
+        break;
+      default:
+        return ERROR;
+    }
+  }
+  return SUCCESS;
+}
+
+int APEX_trace_decode(const char* filename, FILE* out, int show_events) {
+  // Prints the per cycle stage view of a trace, with register writes, stalls and flushes if show_events
+  FILE* fp = fopen(filename, "rb");
+  if (!fp) {
+    fprintf(stderr, "APEX_Error : Unable to open trace file %s\n", filename);
+    return ERROR;
+  }
+  APEX_Trace_Header header;
+  if ((fread(&header, sizeof(header), 1, fp) != 1) || memcmp(header.magic, apex_trace_magic, sizeof(header.magic)) ||
+      (header.version != APEX_TRACE_VERSION) || (header.instruction_size != (int)sizeof(APEX_Instruction)) ||
+      (header.code_memory_size < 0)) {
+    fprintf(stderr, "APEX_Error : %s is not a valid version %d trace\n", filename, APEX_TRACE_VERSION);
+    fclose(fp);
+    return ERROR;
+  }
+  APEX_Instruction* code_memory = malloc(sizeof(APEX_Instruction) * (header.code_memory_size + 1));
+  unsigned char* packed = malloc(TRACE_BLOCK_SIZE);
+  unsigned char* block = malloc(TRACE_BLOCK_SIZE);
+  Trace_Context context;
+  reset_context(&context);
+  int ret = (code_memory && packed && block) ? SUCCESS : ERROR;
+  if ((ret == SUCCESS) &&
+      (fread(code_memory, sizeof(APEX_Instruction), header.code_memory_size, fp) != (size_t)header.code_memory_size)) {
+    ret = ERROR;
+  }
+  int sizes[2];
+  while ((ret == SUCCESS) && (fread(sizes, sizeof(int), 2, fp) == 2)) {
+    int raw_size = sizes[0];
+    int packed_size = sizes[1];
+    if ((raw_size <= 0) || (raw_size > TRACE_BLOCK_SIZE) || (packed_size <= 0) || (packed_size > raw_size) ||
+        (fread(packed, 1, packed_size, fp) != (size_t)packed_size)) {
+      ret = ERROR;
+    }
+    else if (packed_size == raw_size) {
+      ret = decode_block(out, &context, packed, raw_size, code_memory, header.code_memory_size, show_events);
+    }
+    else if (unpack_block(packed, packed_size, block, raw_size) == SUCCESS) {
+      ret = decode_block(out, &context, block, raw_size, code_memory, header.code_memory_size, show_events);
+    }
+    else {
+      ret = ERROR;
+    }
+  }
+  if (ret != SUCCESS) {
+    fprintf(stderr, "APEX_Error : %s is a damaged trace\n", filename);
+  }
+  free(code_memory);
+  free(packed);
+  free(block);
+  fclose(fp);
+  return ret;
+}
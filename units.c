@@ -0,0 +1,149 @@
+/*
+ *  units.c
+ *  Contains functional units of Execute Two, integer ALUs, multipliers and
+ *  dividers each with their own count and latency, a pipelined unit takes
+ *  a new operation every cycle, an unpipelined one only once its result is
+ *  done, an operation with no free unit waits in Decode/RF (or the issue
+ *  queue of the out-of-order engine)
+ *
+ *  Author :
+ *  Sagar Vishwakarma (svishwa2@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpu.h"
+
+/* Unit each opcode computes its result on, memory, branches and HALT need none */
+static const int unit_kinds[NUM_OPCODES] = {
+  [OP_MOVC] = FU_ALU,
+  [OP_MOV]  = FU_ALU,
+  [OP_ADD]  = FU_ALU,
+  [OP_ADDL] = FU_ALU,
+  [OP_SUB]  = FU_ALU,
+  [OP_SUBL] = FU_ALU,
+  [OP_AND]  = FU_ALU,
+  [OP_OR]   = FU_ALU,
+  [OP_EXOR] = FU_ALU,
+  [OP_MUL]  = FU_MUL,
+  [OP_DIV]  = FU_DIV,
+};
+
+static void get_unit_config(const APEX_Config* config, int kind, int* count, int* latency, int* pipelined) {
+  // ALUs are always pipelined
+  switch (kind) {
+    case FU_ALU:
+      *count = config->alu_units;
+      *latency = config->alu_latency;
+      *pipelined = 1;
+      break;
+    case FU_MUL:
+      *count = config->mul_units;
+      *latency = config->mul_latency;
+      *pipelined = config->mul_pipelined;
+      break;
+    case FU_DIV:
+      *count = config->div_units;
+      *latency = config->div_latency;
+      *pipelined = config->div_pipelined;
+      break;
+    default:
+      *count = 1;
+      *latency = 1;
+      *pipelined = 1;
+  }
+}
+
+static int find_unit(const APEX_CPU* cpu, const int* free_cycle, int kind, int cycle) {
+  // Unit of kind able to start an operation in cycle, -1 if all of them are busy
+  int count, latency, pipelined;
+  get_unit_config(&cpu->config, kind, &count, &latency, &pipelined);
+  for (int i = 0; i < count; ++i) {
+    if (free_cycle[i] <= cycle) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+static int occupy_unit(const APEX_CPU* cpu, int* free_cycle, int unit, int kind, int cycle) {
+  // Starts an operation on unit in cycle, returns cycles the unit can not take another one
+  int count, latency, pipelined;
+  get_unit_config(&cpu->config, kind, &count, &latency, &pipelined);
+  int occupied = pipelined ? 1 : latency;
+  free_cycle[unit] = cycle + occupied;
+  return occupied;
+}
+
+int get_unit_kind(int opcode) {
+  return unit_kinds[opcode];
+}
+
+int unit_available(APEX_CPU* cpu, int lane) {
+  // Returns 1 if a unit is free for the instruction in lane of Decode/RF once it reaches Execute Two,
+  // instructions in Execute One and older lanes of its group take their units first
+  int kind = unit_kinds[get_lane_instruction(cpu, DRF, lane)->opcode];
+  if (kind == FU_NONE) {
+    return 1;
+  }
+  int free_cycle[MAX_FUNCTIONAL_UNITS];
+  memcpy(free_cycle, cpu->units.free_cycle[kind], sizeof(free_cycle));
+  for (int i = 0; i < get_group_size(cpu, EX_ONE); ++i) {
+    int unit = find_unit(cpu, free_cycle, kind, cpu->clock + 1);
+    if ((unit_kinds[get_lane_instruction(cpu, EX_ONE, i)->opcode] == kind) && (unit >= 0)) {
+      occupy_unit(cpu, free_cycle, unit, kind, cpu->clock + 1);
+    }
+  }
+  for (int i = 0; i < lane; ++i) {
+    int unit = find_unit(cpu, free_cycle, kind, cpu->clock + 2);
+    if ((unit_kinds[get_lane_instruction(cpu, DRF, i)->opcode] == kind) && (unit >= 0)) {
+      occupy_unit(cpu, free_cycle, unit, kind, cpu->clock + 2);
+    }
+  }
+  return find_unit(cpu, free_cycle, kind, cpu->clock + 2) >= 0;
+}
+
+int unit_free(APEX_CPU* cpu, int opcode) {
+  // Returns 1 if an operation of opcode can start this cycle
+  int kind = unit_kinds[opcode];
+  return (kind == FU_NONE) || (find_unit(cpu, cpu->units.free_cycle[kind], kind, cpu->clock) >= 0);
+}
+
+int start_unit(APEX_CPU* cpu, int opcode) {
+  // Starts opcode on a unit this cycle, returns cycles till its result is done (1 is done this cycle).
+  // Without a free unit it starts on the one free first, Decode/RF makes sure that does not happen
+  int kind = unit_kinds[opcode];
+  if (kind == FU_NONE) {
+    return 1;
+  }
+  int count, latency, pipelined;
+  get_unit_config(&cpu->config, kind, &count, &latency, &pipelined);
+  int* free_cycle = cpu->units.free_cycle[kind];
+  int unit = 0;
+  for (int i = 1; i < count; ++i) {
+    if (free_cycle[i] < free_cycle[unit]) {
+      unit = i;
+    }
+  }
+  int start = (free_cycle[unit] > cpu->clock) ? free_cycle[unit] : cpu->clock;
+  cpu->units.operations[kind]++;
+  cpu->units.busy_cycles[kind] += occupy_unit(cpu, free_cycle, unit, kind, start);
+  return start - cpu->clock + latency;
+}
+
+void print_unit_stats(APEX_CPU* cpu) {
+  // Operations and share of cycles each kind of unit could not take another one, and cycles
+  // instructions waited for a free unit, shows whether more units of a kind would help
+  static const char* names[NUM_FU_KINDS] = {"", "ALU", "MUL", "DIV"};
+  const APEX_Units* units = &cpu->units;
+  for (int kind = FU_ALU; kind < NUM_FU_KINDS; ++kind) {
+    int count, latency, pipelined;
+    get_unit_config(&cpu->config, kind, &count, &latency, &pipelined);
+    fprintf(cpu->out, "%s :: Units %d, Latency %d, %s, Operations %d, Utilization %.2f%%, Cycles Waited %d\n",
+            names[kind], count, latency, pipelined ? "Pipelined" : "Not Pipelined", units->operations[kind],
+            cpu->clock ? 100.0 * units->busy_cycles[kind] / ((double)cpu->clock * count) : 0.0,
+            units->stalls[kind]);
+  }
+}